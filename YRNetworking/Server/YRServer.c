@@ -0,0 +1,774 @@
+//
+// YRServer.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// recvmmsg/sendmmsg
+#define _GNU_SOURCE
+
+#include "YRServer.h"
+#include "YRInternal.h"
+#include "YRAddressTable.h"
+#include "YRSubmissionRing.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+#pragma mark - Declarations
+
+#define kYRServerDefaultMaxDatagramSize ((YRPayloadLengthType)(~0))
+// Amount of datagrams moved per recvmmsg/sendmmsg call.
+#define kYRServerBatchSize 32
+// Storage for outgoing datagrams queued during receive pass.
+#define kYRServerSendBufferSize (1 << 18)
+// Scratch memory for packets deserialized from one receive batch, on top of datagrams themselves.
+#define kYRServerReceiveScratchSize (kYRServerBatchSize * 1024)
+// Bounds amount of datagrams read per wakeup so other fds (and stop requests) are not starved.
+#define kYRServerMaxDatagramsPerWakeup 256
+#define kYRServerMaxEvents 8
+#define kYRServerInitialPeersCapacity 64
+// Payloads other threads may hand to one peer before server's thread drains them.
+#define kYRServerPeerSubmissionsCapacity 64
+
+enum YRServerPeerFlags {
+    kYRServerPeerFlagIsRemoved = 1 << 0,
+};
+
+typedef uint8_t YRServerPeerFlags;
+
+typedef struct YRServerPeer {
+    YRServerRef server;
+    YRSessionRef session;
+    // Position in server's peers array.
+    uint32_t index;
+    YRServerPeerFlags flags;
+    // Payloads submitted from other threads, still owned by submitters (see YRServerPeerSubmit).
+    YRSubmissionRingRef submissions;
+    socklen_t addressLength;
+    struct sockaddr_storage address;
+} YRServerPeer;
+
+typedef struct YRServer {
+    YRServerConfiguration configuration;
+    YRServerCallbacks callbacks;
+    void *userInfo;
+
+    int socket;
+    int epoll;
+    int wakeup;
+
+    // Accessed from other threads via __atomic builtins.
+    bool isStopRequested;
+    bool isAcceptingNewConnections;
+
+    bool hasRemovedPeers;
+    // Set while datagrams are processed, sends are queued and flushed at once afterwards.
+    bool isBatchingSends;
+
+    YRServerPeerRef *peers;
+    uint32_t peersCount;
+    uint32_t peersCapacity;
+    YRAddressTableRef peersByAddress;
+    // Drives timers of every peer's session, advanced on each loop iteration.
+    YRTimerWheelRef timerWheel;
+
+    struct mmsghdr receiveMessages[kYRServerBatchSize];
+    struct iovec receiveVectors[kYRServerBatchSize];
+    struct sockaddr_storage receiveAddresses[kYRServerBatchSize];
+    // Holds kYRServerBatchSize buffers of maxDatagramSize each for current batch, the rest is scratch memory.
+    // Reset before every receive batch, see YRServerGetReceiveArena.
+    YRArenaRef receiveArena;
+
+    struct mmsghdr sendMessages[kYRServerBatchSize];
+    struct iovec sendVectors[kYRServerBatchSize];
+    struct sockaddr_storage sendAddresses[kYRServerBatchSize];
+    uint32_t sendMessagesCount;
+    size_t sendBufferUsed;
+    uint8_t sendBuffer[kYRServerSendBufferSize];
+} YRServer;
+
+#pragma mark - Prototypes
+
+static void YRServerSetCallbacks(YRServerRef server, YRServerCallbacks callbacks);
+static void YRServerCloseDescriptors(YRServerRef server);
+static int YRServerReadDatagrams(YRServerRef server);
+static void YRServerPrepareReceiveBuffers(YRServerRef server);
+static void YRServerFlushSends(YRServerRef server);
+static void YRServerReapRemovedPeers(YRServerRef server);
+static void YRServerAdvanceTimers(YRServerRef server);
+static void YRServerProcessSubmissions(YRServerRef server);
+static void YRServerCompleteSubmissions(YRServerRef server, YRServerPeerRef peer, bool isSent);
+static void YRServerWakeUp(YRServerRef server);
+static uint64_t YRServerGetTime(void);
+
+static YRServerPeerRef YRServerCreatePeer(YRServerRef server, const struct sockaddr_storage *address, socklen_t length);
+static void YRServerDestroyPeer(YRServerRef server, YRServerPeerRef peer);
+
+static void YRServerProtocolSend(YRSessionProtocolRef protocol, const void *payload, YRPayloadLengthType length);
+
+#pragma mark - Lifecycle
+
+YRServerRef YRServerCreate(YRServerConfiguration configuration, YRServerCallbacks callbacks) {
+    YRServerRef server = calloc(1, sizeof(YRServer));
+
+    if (!server) {
+        return NULL;
+    }
+
+    server->peersByAddress = YRAddressTableCreate(configuration.maxPeers > 0 ? configuration.maxPeers : kYRServerInitialPeersCapacity);
+
+    if (configuration.maxDatagramSize == 0) {
+        configuration.maxDatagramSize = kYRServerDefaultMaxDatagramSize;
+    }
+
+    // Arena rounds every allocation up to 8 bytes.
+    size_t receiveBuffersSize = (size_t)kYRServerBatchSize * (((size_t)configuration.maxDatagramSize + 7) & ~(size_t)7);
+
+    server->receiveArena = YRArenaCreate(receiveBuffersSize + kYRServerReceiveScratchSize);
+    server->timerWheel = YRTimerWheelCreate(0, YRServerGetTime());
+
+    if (!server->peersByAddress || !server->receiveArena || !server->timerWheel) {
+        YRAddressTableDestroy(server->peersByAddress);
+        YRTimerWheelDestroy(server->timerWheel);
+        YRArenaDestroy(server->receiveArena);
+        free(server);
+        return NULL;
+    }
+
+    for (int i = 0; i < kYRServerBatchSize; i++) {
+        server->receiveVectors[i].iov_len = configuration.maxDatagramSize;
+        server->receiveMessages[i].msg_hdr.msg_iov = &server->receiveVectors[i];
+        server->receiveMessages[i].msg_hdr.msg_iovlen = 1;
+        server->receiveMessages[i].msg_hdr.msg_name = &server->receiveAddresses[i];
+
+        server->sendMessages[i].msg_hdr.msg_iov = &server->sendVectors[i];
+        server->sendMessages[i].msg_hdr.msg_iovlen = 1;
+        server->sendMessages[i].msg_hdr.msg_name = &server->sendAddresses[i];
+    }
+
+    server->configuration = configuration;
+    server->socket = -1;
+    server->epoll = -1;
+    server->wakeup = -1;
+    server->isAcceptingNewConnections = true;
+
+    YRServerSetCallbacks(server, callbacks);
+
+    return server;
+}
+
+void YRServerDestroy(YRServerRef server) {
+    if (!server) {
+        return;
+    }
+
+    while (server->peersCount > 0) {
+        YRServerDestroyPeer(server, server->peers[server->peersCount - 1]);
+    }
+
+    YRServerCloseDescriptors(server);
+    YRServerSetCallbacks(server, (YRServerCallbacks){NULL, NULL, NULL, NULL});
+
+    YRAddressTableDestroy(server->peersByAddress);
+    YRTimerWheelDestroy(server->timerWheel);
+    YRArenaDestroy(server->receiveArena);
+    free(server->peers);
+    free(server);
+}
+
+void YRServerSetUserInfo(YRServerRef server, void *userInfo) {
+    server->userInfo = userInfo;
+}
+
+void *YRServerGetUserInfo(YRServerRef server) {
+    return server->userInfo;
+}
+
+#pragma mark - Running
+
+bool YRServerStart(YRServerRef server) {
+    if (server->socket >= 0) {
+        return true;
+    }
+
+    int family = server->configuration.ipv6 ? AF_INET6 : AF_INET;
+
+    server->socket = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    server->epoll = epoll_create1(EPOLL_CLOEXEC);
+    server->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (server->socket < 0 || server->epoll < 0 || server->wakeup < 0) {
+        YRServerCloseDescriptors(server);
+        return false;
+    }
+
+    if (server->configuration.reusePort) {
+        int reusePort = 1;
+
+        if (setsockopt(server->socket, SOL_SOCKET, SO_REUSEPORT, &reusePort, sizeof(reusePort)) != 0) {
+            YRServerCloseDescriptors(server);
+            return false;
+        }
+    }
+
+    struct sockaddr_storage address = {0};
+    socklen_t addressLength = 0;
+
+    if (server->configuration.ipv6) {
+        struct sockaddr_in6 *address6 = (struct sockaddr_in6 *)&address;
+        int isV6Only = 0;
+
+        // Accept IPv4 peers as v4-mapped addresses.
+        setsockopt(server->socket, IPPROTO_IPV6, IPV6_V6ONLY, &isV6Only, sizeof(isV6Only));
+
+        address6->sin6_family = AF_INET6;
+        address6->sin6_port = htons(server->configuration.port);
+        address6->sin6_addr = in6addr_any;
+        addressLength = sizeof(struct sockaddr_in6);
+    } else {
+        struct sockaddr_in *address4 = (struct sockaddr_in *)&address;
+
+        address4->sin_family = AF_INET;
+        address4->sin_port = htons(server->configuration.port);
+        address4->sin_addr.s_addr = htonl(INADDR_ANY);
+        addressLength = sizeof(struct sockaddr_in);
+    }
+
+    if (bind(server->socket, (struct sockaddr *)&address, addressLength) != 0) {
+        YRServerCloseDescriptors(server);
+        return false;
+    }
+
+    struct epoll_event socketEvent = {.events = EPOLLIN, .data.fd = server->socket};
+    struct epoll_event wakeupEvent = {.events = EPOLLIN, .data.fd = server->wakeup};
+
+    if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->socket, &socketEvent) != 0 ||
+        epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->wakeup, &wakeupEvent) != 0) {
+        YRServerCloseDescriptors(server);
+        return false;
+    }
+
+    return true;
+}
+
+int YRServerRunOnce(YRServerRef server, int timeout) {
+    if (server->epoll < 0) {
+        return -1;
+    }
+
+    int timersTimeout = YRTimerWheelGetTimeout(server->timerWheel, YRServerGetTime());
+
+    // Wake up in time for the nearest session timer.
+    if (timersTimeout >= 0 && (timeout < 0 || timersTimeout < timeout)) {
+        timeout = timersTimeout;
+    }
+
+    struct epoll_event events[kYRServerMaxEvents];
+    int eventsCount = epoll_wait(server->epoll, events, kYRServerMaxEvents, timeout);
+
+    if (eventsCount < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    int datagramsProcessed = 0;
+
+    for (int i = 0; i < eventsCount; i++) {
+        if (events[i].data.fd == server->socket) {
+            datagramsProcessed += YRServerReadDatagrams(server);
+        } else if (events[i].data.fd == server->wakeup) {
+            uint64_t counter = 0;
+
+            // Only drains counter, stop flag is checked by YRServerRun.
+            while (read(server->wakeup, &counter, sizeof(counter)) < 0 && errno == EINTR);
+        }
+    }
+
+    // Whatever was submitted since the last iteration, wakeup or not.
+    server->isBatchingSends = true;
+
+    YRServerProcessSubmissions(server);
+    YRServerFlushSends(server);
+
+    server->isBatchingSends = false;
+
+    YRServerAdvanceTimers(server);
+    YRServerReapRemovedPeers(server);
+
+    return datagramsProcessed;
+}
+
+bool YRServerRun(YRServerRef server) {
+    if (server->epoll < 0) {
+        return false;
+    }
+
+    __atomic_store_n(&server->isStopRequested, false, __ATOMIC_RELEASE);
+
+    while (!__atomic_load_n(&server->isStopRequested, __ATOMIC_ACQUIRE)) {
+        if (YRServerRunOnce(server, -1) < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void YRServerStop(YRServerRef server) {
+    __atomic_store_n(&server->isStopRequested, true, __ATOMIC_RELEASE);
+
+    YRServerWakeUp(server);
+}
+
+YRTimerWheelRef YRServerGetTimerWheel(YRServerRef server) {
+    return server->timerWheel;
+}
+
+YRArenaRef YRServerGetReceiveArena(YRServerRef server) {
+    return server->receiveArena;
+}
+
+uint16_t YRServerGetPort(YRServerRef server) {
+    struct sockaddr_storage address = {0};
+    socklen_t addressLength = sizeof(address);
+
+    if (server->socket < 0 || getsockname(server->socket, (struct sockaddr *)&address, &addressLength) != 0) {
+        return 0;
+    }
+
+    if (address.ss_family == AF_INET6) {
+        return ntohs(((struct sockaddr_in6 *)&address)->sin6_port);
+    } else {
+        return ntohs(((struct sockaddr_in *)&address)->sin_port);
+    }
+}
+
+#pragma mark - Peers
+
+void YRServerContinueAcceptingNewConnections(YRServerRef server) {
+    __atomic_store_n(&server->isAcceptingNewConnections, true, __ATOMIC_RELAXED);
+}
+
+void YRServerStopAcceptingNewConnections(YRServerRef server) {
+    __atomic_store_n(&server->isAcceptingNewConnections, false, __ATOMIC_RELAXED);
+}
+
+bool YRServerIsAcceptingNewConnections(YRServerRef server) {
+    return __atomic_load_n(&server->isAcceptingNewConnections, __ATOMIC_RELAXED);
+}
+
+uint32_t YRServerGetPeersCount(YRServerRef server) {
+    return server->peersCount;
+}
+
+void YRServerRemovePeer(YRServerRef server, YRServerPeerRef peer) {
+    if (peer && peer->server == server) {
+        peer->flags |= kYRServerPeerFlagIsRemoved;
+        server->hasRemovedPeers = true;
+    }
+}
+
+YRServerRef YRServerPeerGetServer(YRServerPeerRef peer) {
+    return peer->server;
+}
+
+YRSessionRef YRServerPeerGetSession(YRServerPeerRef peer) {
+    return peer->session;
+}
+
+const struct sockaddr *YRServerPeerGetAddress(YRServerPeerRef peer, socklen_t *outLength) {
+    if (outLength) {
+        *outLength = peer->addressLength;
+    }
+
+    return (const struct sockaddr *)&peer->address;
+}
+
+YRServerPeerRef YRServerPeerFromProtocol(YRSessionProtocolRef protocol) {
+    return YRSessionProtocolGetClientContext(protocol);
+}
+
+bool YRServerPeerSubmit(YRServerPeerRef peer, void *payload, YRPayloadLengthType length) {
+    YRServerRef server = peer->server;
+    bool shouldWakeUp = false;
+
+    // Server couldn't receive such datagram either, so payload is not expected to fit into peer's one.
+    if (length == 0 || length > server->configuration.maxDatagramSize) {
+        return false;
+    }
+
+    if (!YRSubmissionRingPush(peer->submissions, payload, length, &shouldWakeUp)) {
+        return false;
+    }
+
+    if (shouldWakeUp) {
+        YRServerWakeUp(server);
+    }
+
+    return true;
+}
+
+#pragma mark - Private
+
+void YRServerSetCallbacks(YRServerRef server, YRServerCallbacks callbacks) {
+    YR_COPY_FP(callbacks.protocolFactory);
+    YR_COPY_FP(callbacks.peerAddedCallback);
+    YR_COPY_FP(callbacks.peerRemovedCallback);
+    YR_COPY_FP(callbacks.submissionCompletedCallback);
+
+    YR_RELEASE_FP(server->callbacks.protocolFactory);
+    YR_RELEASE_FP(server->callbacks.peerAddedCallback);
+    YR_RELEASE_FP(server->callbacks.peerRemovedCallback);
+    YR_RELEASE_FP(server->callbacks.submissionCompletedCallback);
+
+    server->callbacks = callbacks;
+}
+
+void YRServerCloseDescriptors(YRServerRef server) {
+    if (server->socket >= 0) {
+        close(server->socket);
+        server->socket = -1;
+    }
+
+    if (server->epoll >= 0) {
+        close(server->epoll);
+        server->epoll = -1;
+    }
+
+    if (server->wakeup >= 0) {
+        close(server->wakeup);
+        server->wakeup = -1;
+    }
+}
+
+int YRServerReadDatagrams(YRServerRef server) {
+    int datagramsProcessed = 0;
+
+    server->isBatchingSends = true;
+
+    while (datagramsProcessed < kYRServerMaxDatagramsPerWakeup) {
+        YRServerPrepareReceiveBuffers(server);
+
+        for (int i = 0; i < kYRServerBatchSize; i++) {
+            server->receiveMessages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        }
+
+        int received = recvmmsg(server->socket, server->receiveMessages, kYRServerBatchSize, 0, NULL);
+
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            // EAGAIN: socket is drained. Anything else is reported by the next epoll_wait.
+            break;
+        }
+
+        for (int i = 0; i < received; i++) {
+            struct mmsghdr *message = &server->receiveMessages[i];
+            struct sockaddr_storage *address = &server->receiveAddresses[i];
+
+            datagramsProcessed++;
+
+            if (message->msg_len == 0 || (message->msg_hdr.msg_flags & MSG_TRUNC)) {
+                continue;
+            }
+
+            YRServerPeerRef peer = YRAddressTableGet(server->peersByAddress, (const struct sockaddr *)address);
+
+            if (!peer) {
+                if (!__atomic_load_n(&server->isAcceptingNewConnections, __ATOMIC_RELAXED) ||
+                    (server->configuration.maxPeers > 0 && server->peersCount >= server->configuration.maxPeers)) {
+                    // Drop datagrams from unknown peers.
+                    continue;
+                }
+
+                peer = YRServerCreatePeer(server, address, message->msg_hdr.msg_namelen);
+
+                if (!peer) {
+                    continue;
+                }
+            }
+
+            YRSessionReceive(peer->session, server->receiveVectors[i].iov_base, (YRPayloadLengthType)message->msg_len);
+        }
+
+        // Sessions have just processed ACKs of this batch, submitted payloads join its replies.
+        YRServerProcessSubmissions(server);
+
+        // Flush after every batch so replies aren't delayed by reading the rest of the socket.
+        YRServerFlushSends(server);
+
+        if (received < kYRServerBatchSize) {
+            break;
+        }
+    }
+
+    server->isBatchingSends = false;
+
+    return datagramsProcessed;
+}
+
+void YRServerPrepareReceiveBuffers(YRServerRef server) {
+    YRArenaReset(server->receiveArena);
+
+    // Arena is sized for them, so allocation can't fail.
+    for (int i = 0; i < kYRServerBatchSize; i++) {
+        server->receiveVectors[i].iov_base = YRArenaAllocate(server->receiveArena, server->receiveVectors[i].iov_len);
+    }
+}
+
+void YRServerFlushSends(YRServerRef server) {
+    uint32_t sent = 0;
+
+    while (sent < server->sendMessagesCount) {
+        int result = sendmmsg(server->socket, &server->sendMessages[sent], server->sendMessagesCount - sent, 0);
+
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            // Drop the rest (e.g. EAGAIN when socket buffer is full): session retransmits unacknowledged segments.
+            break;
+        }
+
+        sent += result;
+    }
+
+    server->sendMessagesCount = 0;
+    server->sendBufferUsed = 0;
+}
+
+void YRServerAdvanceTimers(YRServerRef server) {
+    if (YRTimerWheelGetTimersCount(server->timerWheel) == 0) {
+        return;
+    }
+
+    // Retransmissions and NUL segments fired together go out in the same sendmmsg batches.
+    server->isBatchingSends = true;
+
+    YRTimerWheelAdvance(server->timerWheel, YRServerGetTime());
+    YRServerFlushSends(server);
+
+    server->isBatchingSends = false;
+}
+
+void YRServerProcessSubmissions(YRServerRef server) {
+    for (uint32_t i = 0; i < server->peersCount; i++) {
+        YRServerPeerRef peer = server->peers[i];
+
+        // Removed peer's payloads are reported as dropped once it's destroyed.
+        if (!(peer->flags & kYRServerPeerFlagIsRemoved)) {
+            YRServerCompleteSubmissions(server, peer, true);
+        }
+    }
+}
+
+void YRServerCompleteSubmissions(YRServerRef server, YRServerPeerRef peer, bool isSent) {
+    void *payload = NULL;
+    uint32_t length = 0;
+
+    while (YRSubmissionRingPeek(peer->submissions, &payload, &length)) {
+        YRSubmissionRingPop(peer->submissions);
+
+        if (isSent) {
+            YRSessionSend(peer->session, payload, (YRPayloadLengthType)length);
+        }
+
+        // Payload goes back to submitter.
+        !server->callbacks.submissionCompletedCallback ?: server->callbacks.submissionCompletedCallback(server, peer, payload, (YRPayloadLengthType)length, isSent);
+    }
+}
+
+void YRServerWakeUp(YRServerRef server) {
+    if (server->wakeup >= 0) {
+        uint64_t increment = 1;
+
+        while (write(server->wakeup, &increment, sizeof(increment)) < 0 && errno == EINTR);
+    }
+}
+
+uint64_t YRServerGetTime(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000;
+}
+
+void YRServerReapRemovedPeers(YRServerRef server) {
+    if (!server->hasRemovedPeers) {
+        return;
+    }
+
+    server->hasRemovedPeers = false;
+
+    // Iterate backwards as destroying peer moves last one into its slot.
+    for (uint32_t i = server->peersCount; i > 0; i--) {
+        YRServerPeerRef peer = server->peers[i - 1];
+
+        if (peer->flags & kYRServerPeerFlagIsRemoved) {
+            YRServerDestroyPeer(server, peer);
+        }
+    }
+}
+
+YRServerPeerRef YRServerCreatePeer(YRServerRef server, const struct sockaddr_storage *address, socklen_t length) {
+    if (server->peersCount == server->peersCapacity) {
+        uint32_t newCapacity = server->peersCapacity > 0 ? server->peersCapacity * 2 : kYRServerInitialPeersCapacity;
+        YRServerPeerRef *newPeers = realloc(server->peers, newCapacity * sizeof(YRServerPeerRef));
+
+        if (!newPeers) {
+            return NULL;
+        }
+
+        server->peers = newPeers;
+        server->peersCapacity = newCapacity;
+    }
+
+    YRServerPeerRef peer = calloc(1, sizeof(YRServerPeer));
+
+    if (!peer) {
+        return NULL;
+    }
+
+    peer->server = server;
+    peer->addressLength = length;
+    memcpy(&peer->address, address, length);
+    // Created here on server's thread, so submitters never allocate.
+    peer->submissions = YRSubmissionRingCreate(kYRServerPeerSubmissionsCapacity);
+
+    if (!peer->submissions || !YRAddressTableSet(server->peersByAddress, (const struct sockaddr *)address, peer)) {
+        YRSubmissionRingDestroy(peer->submissions);
+        free(peer);
+        return NULL;
+    }
+
+    YRSessionProtocolRef protocol = NULL;
+
+    !server->callbacks.protocolFactory ?: server->callbacks.protocolFactory(server, peer, &protocol);
+
+    if (!protocol) {
+        // Peer rejected.
+        YRAddressTableRemove(server->peersByAddress, (const struct sockaddr *)address);
+        YRSubmissionRingDestroy(peer->submissions);
+        free(peer);
+        return NULL;
+    }
+
+    YRSessionProtocolClientCallbacks clientCallbacks = YRSessionProtocolGetClientCallbacks(protocol);
+
+#if __has_extension(blocks)
+    clientCallbacks.sendCallback = ^(YRSessionProtocolRef protocol, const void *payload, YRPayloadLengthType length) {
+        YRServerProtocolSend(protocol, payload, length);
+    };
+#else
+    clientCallbacks.sendCallback = &YRServerProtocolSend;
+#endif
+
+    YRSessionProtocolSetCallbacks(protocol,
+                                  YRSessionProtocolGetLifecycleCallbacks(protocol),
+                                  YRSessionProtocolGetCallbacks(protocol),
+                                  clientCallbacks);
+    YRSessionProtocolSetClientContext(protocol, peer);
+
+    peer->session = YRSessionCreate(protocol);
+
+    if (!peer->session) {
+        YRSessionProtocolDestroy(protocol);
+        YRAddressTableRemove(server->peersByAddress, (const struct sockaddr *)address);
+        YRSubmissionRingDestroy(peer->submissions);
+        free(peer);
+        return NULL;
+    }
+
+    peer->index = server->peersCount;
+    server->peers[server->peersCount++] = peer;
+
+    YRSessionWait(peer->session);
+
+    !server->callbacks.peerAddedCallback ?: server->callbacks.peerAddedCallback(server, peer);
+
+    return peer;
+}
+
+void YRServerDestroyPeer(YRServerRef server, YRServerPeerRef peer) {
+    !server->callbacks.peerRemovedCallback ?: server->callbacks.peerRemovedCallback(server, peer);
+
+    // Swap with last one to keep peers array dense.
+    YRServerPeerRef lastPeer = server->peers[server->peersCount - 1];
+
+    lastPeer->index = peer->index;
+    server->peers[peer->index] = lastPeer;
+    server->peersCount--;
+
+    YRAddressTableRemove(server->peersByAddress, (const struct sockaddr *)&peer->address);
+
+    YRSessionRelease(peer->session);
+
+    // Nobody submits after peer removed callback, what's left is returned unsent.
+    YRServerCompleteSubmissions(server, peer, false);
+    YRSubmissionRingDestroy(peer->submissions);
+
+    free(peer);
+}
+
+void YRServerProtocolSend(YRSessionProtocolRef protocol, const void *payload, YRPayloadLengthType length) {
+    YRServerPeerRef peer = YRSessionProtocolGetClientContext(protocol);
+
+    if (!peer || (peer->flags & kYRServerPeerFlagIsRemoved)) {
+        return;
+    }
+
+    YRServerRef server = peer->server;
+
+    if (!server->isBatchingSends) {
+        // Failures (e.g. EAGAIN when socket buffer is full) are ignored: session retransmits unacknowledged segments.
+        while (sendto(server->socket, payload, length, 0,
+                      (const struct sockaddr *)&peer->address, peer->addressLength) < 0 && errno == EINTR);
+        return;
+    }
+
+    if (server->sendMessagesCount == kYRServerBatchSize || server->sendBufferUsed + length > kYRServerSendBufferSize) {
+        YRServerFlushSends(server);
+    }
+
+    // Payload may live on session's stack, so it's copied.
+    uint32_t index = server->sendMessagesCount++;
+    struct msghdr *header = &server->sendMessages[index].msg_hdr;
+
+    memcpy(server->sendBuffer + server->sendBufferUsed, payload, length);
+    memcpy(&server->sendAddresses[index], &peer->address, peer->addressLength);
+
+    server->sendVectors[index].iov_base = server->sendBuffer + server->sendBufferUsed;
+    server->sendVectors[index].iov_len = length;
+    header->msg_namelen = peer->addressLength;
+
+    server->sendBufferUsed += length;
+}
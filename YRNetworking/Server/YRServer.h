@@ -0,0 +1,167 @@
+//
+// YRServer.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __YRServer__
+#define __YRServer__
+
+#include "YRNetworking.h"
+#include "YRTimerWheel.h"
+#include "YRArena.h"
+
+#include <stdbool.h>
+#include <sys/socket.h>
+
+#pragma mark - Declarations
+
+/**
+ *  Multi-session UDP server engine built on top of epoll (Linux only).
+ *  Server owns non-blocking socket, demultiplexes incoming datagrams by peer address into sessions
+ *  and drives YRSessionReceive/send callouts directly on the thread that runs the loop.
+ *  Datagrams are read in batches (recvmmsg), sends produced while processing them are queued and
+ *  flushed with single sendmmsg per batch.
+ *  Server also owns timer wheel shared by every peer's session, loop wakes up for the nearest timer.
+ */
+typedef struct YRServer *YRServerRef;
+
+/**
+ *  Remote peer known to server. Each peer owns exactly one session.
+ */
+typedef struct YRServerPeer *YRServerPeerRef;
+
+/**
+ *  Called for every new peer. Protocol returned via outProtocol is owned by peer's session afterwards.
+ *  Leaving outProtocol untouched (NULL) rejects the peer.
+ *  Note: Client send callback and client context of returned protocol are overridden by server.
+ */
+YR_DECLARE_FP(YRServerProtocolFactory, YRServerRef server, YRServerPeerRef peer, YRSessionProtocolRef *outProtocol);
+YR_DECLARE_FP(YRServerPeerCallback, YRServerRef server, YRServerPeerRef peer);
+/**
+ *  Hands payload passed to YRServerPeerSubmit back to its submitter on server's thread.
+ *  isSent is false if peer was removed before payload was handed to its session.
+ */
+YR_DECLARE_FP(YRServerSubmissionCompletedCallback, YRServerRef server, YRServerPeerRef peer, void *payload, YRPayloadLengthType length, bool isSent);
+
+typedef struct {
+    YRServerProtocolFactory protocolFactory;
+    YRServerPeerCallback peerAddedCallback;
+    YRServerPeerCallback peerRemovedCallback;
+    YRServerSubmissionCompletedCallback submissionCompletedCallback;
+} YRServerCallbacks;
+
+typedef struct {
+    // Port to bind to, 0 lets system pick one.
+    uint16_t port;
+    // Binds dual-stack IPv6 socket if set, IPv4 otherwise.
+    bool ipv6;
+    // Maximum number of peers, 0 means unlimited.
+    uint32_t maxPeers;
+    // Largest datagram server expects to receive, 0 means 65535. Larger datagrams are dropped.
+    YRPayloadLengthType maxDatagramSize;
+    // Sets SO_REUSEPORT so several servers can share one port (see YRServerGroup).
+    bool reusePort;
+} YRServerConfiguration;
+
+#pragma mark - Lifecycle
+
+YRServerRef YRServerCreate(YRServerConfiguration configuration, YRServerCallbacks callbacks);
+void YRServerDestroy(YRServerRef server);
+
+void YRServerSetUserInfo(YRServerRef server, void *userInfo);
+void *YRServerGetUserInfo(YRServerRef server);
+
+#pragma mark - Running
+
+/**
+ *  Creates and binds socket. Returns false on failure (errno describes the error).
+ */
+bool YRServerStart(YRServerRef server);
+
+/**
+ *  Processes pending events waiting at most timeout milliseconds (-1 to wait indefinitely).
+ *  Returns number of datagrams processed or -1 on error.
+ */
+int YRServerRunOnce(YRServerRef server, int timeout);
+
+/**
+ *  Runs loop on calling thread until YRServerStop is called.
+ */
+bool YRServerRun(YRServerRef server);
+
+/**
+ *  Asks running loop to exit. Safe to call from any thread.
+ */
+void YRServerStop(YRServerRef server);
+
+/**
+ *  Wheel driven by server loop with monotonic time in milliseconds.
+ *  Protocol factory should hand it to protocols it creates, so all their timers are served by this loop.
+ */
+YRTimerWheelRef YRServerGetTimerWheel(YRServerRef server);
+
+/**
+ *  Memory of server's thread that holds datagrams of current receive batch. The rest of it is scratch memory
+ *  for protocols to deserialize received datagrams into (see YRPacketDeserializedLengthForStream)
+ *  instead of allocating per packet. Reset before every receive batch, so nothing allocated from it
+ *  may outlive receive callout.
+ */
+YRArenaRef YRServerGetReceiveArena(YRServerRef server);
+
+uint16_t YRServerGetPort(YRServerRef server);
+
+#pragma mark - Peers
+
+/**
+ *  Toggles whether datagrams from unknown addresses create new peers. Safe to call from any thread.
+ */
+void YRServerContinueAcceptingNewConnections(YRServerRef server);
+void YRServerStopAcceptingNewConnections(YRServerRef server);
+bool YRServerIsAcceptingNewConnections(YRServerRef server);
+
+uint32_t YRServerGetPeersCount(YRServerRef server);
+
+/**
+ *  Removes peer and releases its session. Actual removal is deferred till the end of current loop iteration,
+ *  so it's safe to call this from within session callouts.
+ */
+void YRServerRemovePeer(YRServerRef server, YRServerPeerRef peer);
+
+YRServerRef YRServerPeerGetServer(YRServerPeerRef peer);
+YRSessionRef YRServerPeerGetSession(YRServerPeerRef peer);
+const struct sockaddr *YRServerPeerGetAddress(YRServerPeerRef peer, socklen_t *outLength);
+
+/**
+ *  Returns peer which owns given protocol. Protocol must be the one created for server's peer.
+ */
+YRServerPeerRef YRServerPeerFromProtocol(YRSessionProtocolRef protocol);
+
+/**
+ *  Queues payload to be sent to peer's session by server's thread. Safe to call from any thread till peer removed
+ *  callback is called: takes no locks and doesn't copy, payload is owned by server till submission completed callback.
+ *  Wakes the loop up if it may be idle. Submissions are sent on every loop iteration and after every receive batch.
+ *  Returns false if peer's submission ring is full or payload is empty or larger than maxDatagramSize.
+ */
+bool YRServerPeerSubmit(YRServerPeerRef peer, void *payload, YRPayloadLengthType length);
+
+#endif
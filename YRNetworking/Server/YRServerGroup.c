@@ -0,0 +1,259 @@
+//
+// YRServerGroup.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// pthread_setaffinity_np
+#define _GNU_SOURCE
+
+#include "YRServerGroup.h"
+#include "YRInternal.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#pragma mark - Declarations
+
+typedef struct YRServerGroup {
+    YRServerGroupConfiguration configuration;
+    YRServerCallbacks callbacks;
+    void *userInfo;
+
+    // Read by worker threads via __atomic builtins.
+    bool isStopRequested;
+    bool isRunning;
+
+    YRServerRef *workers;
+    pthread_t *threads;
+} YRServerGroup;
+
+#pragma mark - Prototypes
+
+static bool YRServerGroupCreateWorkers(YRServerGroupRef group);
+static void YRServerGroupDestroyWorkers(YRServerGroupRef group);
+static void *YRServerGroupWorkerMain(void *context);
+
+#pragma mark - Lifecycle
+
+YRServerGroupRef YRServerGroupCreate(YRServerGroupConfiguration configuration, YRServerCallbacks callbacks) {
+    if (configuration.workersCount == 0) {
+        long cpusCount = sysconf(_SC_NPROCESSORS_ONLN);
+
+        configuration.workersCount = cpusCount > 0 ? (uint32_t)cpusCount : 1;
+    }
+
+    YRServerGroupRef group = calloc(1, sizeof(YRServerGroup));
+
+    if (!group) {
+        return NULL;
+    }
+
+    group->workers = calloc(configuration.workersCount, sizeof(YRServerRef));
+    group->threads = calloc(configuration.workersCount, sizeof(pthread_t));
+
+    if (!group->workers || !group->threads) {
+        free(group->workers);
+        free(group->threads);
+        free(group);
+        return NULL;
+    }
+
+    YR_COPY_FP(callbacks.protocolFactory);
+    YR_COPY_FP(callbacks.peerAddedCallback);
+    YR_COPY_FP(callbacks.peerRemovedCallback);
+    YR_COPY_FP(callbacks.submissionCompletedCallback);
+
+    group->configuration = configuration;
+    group->callbacks = callbacks;
+
+    return group;
+}
+
+void YRServerGroupDestroy(YRServerGroupRef group) {
+    if (!group) {
+        return;
+    }
+
+    YRServerGroupStop(group);
+    YRServerGroupDestroyWorkers(group);
+
+    YR_RELEASE_FP(group->callbacks.protocolFactory);
+    YR_RELEASE_FP(group->callbacks.peerAddedCallback);
+    YR_RELEASE_FP(group->callbacks.peerRemovedCallback);
+    YR_RELEASE_FP(group->callbacks.submissionCompletedCallback);
+
+    free(group->workers);
+    free(group->threads);
+    free(group);
+}
+
+void YRServerGroupSetUserInfo(YRServerGroupRef group, void *userInfo) {
+    group->userInfo = userInfo;
+}
+
+void *YRServerGroupGetUserInfo(YRServerGroupRef group) {
+    return group->userInfo;
+}
+
+#pragma mark - Running
+
+bool YRServerGroupStart(YRServerGroupRef group) {
+    if (group->isRunning) {
+        return true;
+    }
+
+    if (!group->workers[0] && !YRServerGroupCreateWorkers(group)) {
+        return false;
+    }
+
+    __atomic_store_n(&group->isStopRequested, false, __ATOMIC_RELEASE);
+
+    long cpusCount = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t threadsCount = 0;
+
+    for (; threadsCount < group->configuration.workersCount; threadsCount++) {
+        if (pthread_create(&group->threads[threadsCount], NULL, YRServerGroupWorkerMain, group->workers[threadsCount]) != 0) {
+            break;
+        }
+
+        if (group->configuration.pinsWorkersToCores && cpusCount > 0) {
+            cpu_set_t cpus;
+
+            CPU_ZERO(&cpus);
+            CPU_SET(threadsCount % cpusCount, &cpus);
+
+            // Best effort: worker still runs if affinity can't be set (e.g. restricted cpuset).
+            pthread_setaffinity_np(group->threads[threadsCount], sizeof(cpus), &cpus);
+        }
+    }
+
+    if (threadsCount < group->configuration.workersCount) {
+        __atomic_store_n(&group->isStopRequested, true, __ATOMIC_RELEASE);
+
+        for (uint32_t i = 0; i < threadsCount; i++) {
+            YRServerStop(group->workers[i]);
+            pthread_join(group->threads[i], NULL);
+        }
+
+        return false;
+    }
+
+    group->isRunning = true;
+
+    return true;
+}
+
+void YRServerGroupStop(YRServerGroupRef group) {
+    if (!group->isRunning) {
+        return;
+    }
+
+    __atomic_store_n(&group->isStopRequested, true, __ATOMIC_RELEASE);
+
+    // Wakes up every worker, each one exits after its current iteration.
+    for (uint32_t i = 0; i < group->configuration.workersCount; i++) {
+        YRServerStop(group->workers[i]);
+    }
+
+    for (uint32_t i = 0; i < group->configuration.workersCount; i++) {
+        pthread_join(group->threads[i], NULL);
+    }
+
+    group->isRunning = false;
+}
+
+uint16_t YRServerGroupGetPort(YRServerGroupRef group) {
+    return group->workers[0] ? YRServerGetPort(group->workers[0]) : 0;
+}
+
+#pragma mark - Workers
+
+uint32_t YRServerGroupGetWorkersCount(YRServerGroupRef group) {
+    return group->configuration.workersCount;
+}
+
+YRServerRef YRServerGroupGetWorker(YRServerGroupRef group, uint32_t index) {
+    return index < group->configuration.workersCount ? group->workers[index] : NULL;
+}
+
+YRServerGroupRef YRServerGroupFromServer(YRServerRef server) {
+    return YRServerGetUserInfo(server);
+}
+
+#pragma mark - Private
+
+bool YRServerGroupCreateWorkers(YRServerGroupRef group) {
+    uint32_t workersCount = group->configuration.workersCount;
+    YRServerConfiguration configuration = group->configuration.serverConfiguration;
+
+    configuration.reusePort = true;
+
+    if (configuration.maxPeers > 0) {
+        configuration.maxPeers = (configuration.maxPeers + workersCount - 1) / workersCount;
+    }
+
+    for (uint32_t i = 0; i < workersCount; i++) {
+        YRServerRef worker = YRServerCreate(configuration, group->callbacks);
+
+        if (!worker) {
+            YRServerGroupDestroyWorkers(group);
+            return false;
+        }
+
+        group->workers[i] = worker;
+
+        YRServerSetUserInfo(worker, group);
+
+        if (!YRServerStart(worker)) {
+            YRServerGroupDestroyWorkers(group);
+            return false;
+        }
+
+        // First worker resolves port if system picked it, the rest join the same one.
+        configuration.port = YRServerGetPort(worker);
+    }
+
+    return true;
+}
+
+void YRServerGroupDestroyWorkers(YRServerGroupRef group) {
+    for (uint32_t i = 0; i < group->configuration.workersCount; i++) {
+        YRServerDestroy(group->workers[i]);
+        group->workers[i] = NULL;
+    }
+}
+
+void *YRServerGroupWorkerMain(void *context) {
+    YRServerRef worker = context;
+    YRServerGroupRef group = YRServerGroupFromServer(worker);
+
+    // YRServerRun isn't used as it resets stop flag on entry and could miss stop requested before thread started.
+    while (!__atomic_load_n(&group->isStopRequested, __ATOMIC_ACQUIRE)) {
+        if (YRServerRunOnce(worker, -1) < 0) {
+            break;
+        }
+    }
+
+    return NULL;
+}
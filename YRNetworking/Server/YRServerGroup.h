@@ -0,0 +1,90 @@
+//
+// YRServerGroup.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __YRServerGroup__
+#define __YRServerGroup__
+
+#include "YRServer.h"
+
+#pragma mark - Declarations
+
+/**
+ *  Sharded server: runs N independent YRServer workers, each on its own thread with its own
+ *  SO_REUSEPORT socket, epoll loop and peers table (Linux only).
+ *  Kernel hashes datagram 4-tuple to pick socket, so every peer always lands on the same worker
+ *  and its session is never touched by more than one thread - no locking is involved.
+ *
+ *  Callbacks are invoked on worker threads. Every worker's user info points to group,
+ *  use YRServerGroupFromServer to get back to it.
+ */
+typedef struct YRServerGroup *YRServerGroupRef;
+
+typedef struct {
+    // Configuration for every worker. Port is shared, maxPeers is split evenly between workers.
+    YRServerConfiguration serverConfiguration;
+    // Amount of worker threads, 0 means one per online CPU.
+    uint32_t workersCount;
+    // Pins worker i to CPU i (modulo online CPUs count).
+    bool pinsWorkersToCores;
+} YRServerGroupConfiguration;
+
+#pragma mark - Lifecycle
+
+YRServerGroupRef YRServerGroupCreate(YRServerGroupConfiguration configuration, YRServerCallbacks callbacks);
+/**
+ *  Stops group if needed and destroys all workers with their peers.
+ */
+void YRServerGroupDestroy(YRServerGroupRef group);
+
+void YRServerGroupSetUserInfo(YRServerGroupRef group, void *userInfo);
+void *YRServerGroupGetUserInfo(YRServerGroupRef group);
+
+#pragma mark - Running
+
+/**
+ *  Binds all workers to the same port and spawns their threads. Returns false on failure.
+ */
+bool YRServerGroupStart(YRServerGroupRef group);
+
+/**
+ *  Stops all workers and waits for their threads to exit. Peers are kept till group is destroyed.
+ */
+void YRServerGroupStop(YRServerGroupRef group);
+
+uint16_t YRServerGroupGetPort(YRServerGroupRef group);
+
+#pragma mark - Workers
+
+uint32_t YRServerGroupGetWorkersCount(YRServerGroupRef group);
+
+/**
+ *  Returns worker at given index, NULL if group is not started yet.
+ *  Besides thread-safe calls, worker should only be accessed from its own callbacks.
+ */
+YRServerRef YRServerGroupGetWorker(YRServerGroupRef group, uint32_t index);
+
+YRServerGroupRef YRServerGroupFromServer(YRServerRef server);
+
+#endif
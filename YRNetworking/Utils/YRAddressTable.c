@@ -0,0 +1,328 @@
+//
+// YRAddressTable.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "YRAddressTable.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+
+#define kYRAddressTableMinimumCapacity 16
+
+#pragma mark - Declarations
+
+/**
+ *  Normalized address: IPv4 is stored as v4-mapped IPv6, so both families share one layout
+ *  and key comparison is three 64-bit compares.
+ */
+typedef struct {
+    union {
+        uint8_t bytes[16];
+        uint64_t words[2];
+    } address;
+    uint32_t scope;
+    uint16_t port;
+    uint16_t reserved;
+} YRAddressTableKey;
+
+typedef struct {
+    YRAddressTableKey key;
+    void *value;
+} YRAddressTableSlot;
+
+typedef struct YRAddressTable {
+    // Hashes are kept apart from slots so probing touches as few cache lines as possible.
+    // Zero hash marks empty slot.
+    uint32_t *hashes;
+    YRAddressTableSlot *slots;
+    uint32_t mask;
+    uint32_t count;
+    uint32_t growThreshold;
+} YRAddressTable;
+
+#pragma mark - Prototypes
+
+static bool YRAddressTableMakeKey(const struct sockaddr *address, YRAddressTableKey *outKey);
+static inline uint32_t YRAddressTableHash(const YRAddressTableKey *key);
+static inline bool YRAddressTableKeyIsEqual(const YRAddressTableKey *lhs, const YRAddressTableKey *rhs);
+static inline uint32_t YRAddressTableProbeDistance(YRAddressTableRef table, uint32_t hash, uint32_t index);
+static bool YRAddressTableLookup(YRAddressTableRef table, const YRAddressTableKey *key, uint32_t hash, uint32_t *outIndex);
+static bool YRAddressTableResize(YRAddressTableRef table, uint32_t capacity);
+static inline uint32_t YRAddressTableCapacityForCount(uint32_t count);
+
+#pragma mark - Lifecycle
+
+YRAddressTableRef YRAddressTableCreate(uint32_t capacityHint) {
+    YRAddressTableRef table = calloc(1, sizeof(YRAddressTable));
+
+    if (!table) {
+        return NULL;
+    }
+
+    if (!YRAddressTableResize(table, YRAddressTableCapacityForCount(capacityHint))) {
+        free(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+void YRAddressTableDestroy(YRAddressTableRef table) {
+    if (table) {
+        free(table->hashes);
+        free(table->slots);
+        free(table);
+    }
+}
+
+#pragma mark - Access
+
+void *YRAddressTableGet(YRAddressTableRef table, const struct sockaddr *address) {
+    YRAddressTableKey key;
+
+    if (!YRAddressTableMakeKey(address, &key)) {
+        return NULL;
+    }
+
+    uint32_t index = 0;
+
+    if (YRAddressTableLookup(table, &key, YRAddressTableHash(&key), &index)) {
+        return table->slots[index].value;
+    }
+
+    return NULL;
+}
+
+bool YRAddressTableSet(YRAddressTableRef table, const struct sockaddr *address, void *value) {
+    YRAddressTableKey key;
+
+    if (!YRAddressTableMakeKey(address, &key)) {
+        return false;
+    }
+
+    uint32_t hash = YRAddressTableHash(&key);
+    uint32_t index = 0;
+
+    if (YRAddressTableLookup(table, &key, hash, &index)) {
+        table->slots[index].value = value;
+        return true;
+    }
+
+    if (table->count >= table->growThreshold) {
+        if (!YRAddressTableResize(table, (table->mask + 1) * 2)) {
+            return false;
+        }
+
+        YRAddressTableLookup(table, &key, hash, &index);
+    }
+
+    // Lookup stopped at first empty slot of the probe sequence.
+    table->hashes[index] = hash;
+    table->slots[index].key = key;
+    table->slots[index].value = value;
+    table->count++;
+
+    return true;
+}
+
+void *YRAddressTableRemove(YRAddressTableRef table, const struct sockaddr *address) {
+    YRAddressTableKey key;
+
+    if (!YRAddressTableMakeKey(address, &key)) {
+        return NULL;
+    }
+
+    uint32_t index = 0;
+
+    if (!YRAddressTableLookup(table, &key, YRAddressTableHash(&key), &index)) {
+        return NULL;
+    }
+
+    void *value = table->slots[index].value;
+
+    // Backward shift (Knuth's algorithm R): walk rest of the cluster and move every entry whose probe sequence
+    // passes through the gap into it, so lookups never have to skip over deleted entries.
+    uint32_t next = (index + 1) & table->mask;
+
+    while (table->hashes[next] != 0) {
+        // Entry can fill the gap only if its home slot is not located between the gap and entry itself.
+        if (YRAddressTableProbeDistance(table, table->hashes[next], next) >= ((next - index) & table->mask)) {
+            table->hashes[index] = table->hashes[next];
+            table->slots[index] = table->slots[next];
+
+            index = next;
+        }
+
+        next = (next + 1) & table->mask;
+    }
+
+    table->hashes[index] = 0;
+    table->slots[index].value = NULL;
+    table->count--;
+
+    return value;
+}
+
+void YRAddressTableRemoveAll(YRAddressTableRef table) {
+    memset(table->hashes, 0, (table->mask + 1) * sizeof(uint32_t));
+    table->count = 0;
+}
+
+uint32_t YRAddressTableGetCount(YRAddressTableRef table) {
+    return table->count;
+}
+
+#pragma mark - Private
+
+bool YRAddressTableMakeKey(const struct sockaddr *address, YRAddressTableKey *outKey) {
+    if (!address) {
+        return false;
+    }
+
+    memset(outKey, 0, sizeof(YRAddressTableKey));
+
+    if (address->sa_family == AF_INET) {
+        const struct sockaddr_in *address4 = (const struct sockaddr_in *)address;
+
+        outKey->address.bytes[10] = 0xFF;
+        outKey->address.bytes[11] = 0xFF;
+        memcpy(&outKey->address.bytes[12], &address4->sin_addr, sizeof(struct in_addr));
+        outKey->port = address4->sin_port;
+
+        return true;
+    }
+
+    if (address->sa_family == AF_INET6) {
+        const struct sockaddr_in6 *address6 = (const struct sockaddr_in6 *)address;
+
+        memcpy(outKey->address.bytes, &address6->sin6_addr, sizeof(struct in6_addr));
+        outKey->scope = address6->sin6_scope_id;
+        outKey->port = address6->sin6_port;
+
+        return true;
+    }
+
+    return false;
+}
+
+uint32_t YRAddressTableHash(const YRAddressTableKey *key) {
+    uint64_t hash = key->address.words[0] * 0x9E3779B97F4A7C15ULL;
+
+    hash ^= key->address.words[1] + 0x632BE59BD9B4E019ULL + (hash << 6) + (hash >> 2);
+    hash ^= ((uint64_t)key->scope << 16 | key->port) + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+
+    // Final avalanche (splitmix64).
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+
+    uint32_t result = (uint32_t)hash;
+
+    // Zero is reserved for empty slots.
+    return result != 0 ? result : 1;
+}
+
+bool YRAddressTableKeyIsEqual(const YRAddressTableKey *lhs, const YRAddressTableKey *rhs) {
+    return lhs->address.words[0] == rhs->address.words[0] &&
+        lhs->address.words[1] == rhs->address.words[1] &&
+        lhs->port == rhs->port &&
+        lhs->scope == rhs->scope;
+}
+
+uint32_t YRAddressTableProbeDistance(YRAddressTableRef table, uint32_t hash, uint32_t index) {
+    return (index - (hash & table->mask)) & table->mask;
+}
+
+bool YRAddressTableLookup(YRAddressTableRef table, const YRAddressTableKey *key, uint32_t hash, uint32_t *outIndex) {
+    uint32_t index = hash & table->mask;
+
+    // Table is never full (see growThreshold), so probing always terminates at an empty slot.
+    while (table->hashes[index] != 0) {
+        if (table->hashes[index] == hash && YRAddressTableKeyIsEqual(&table->slots[index].key, key)) {
+            *outIndex = index;
+            return true;
+        }
+
+        index = (index + 1) & table->mask;
+    }
+
+    *outIndex = index;
+    return false;
+}
+
+bool YRAddressTableResize(YRAddressTableRef table, uint32_t capacity) {
+    uint32_t *hashes = calloc(capacity, sizeof(uint32_t));
+    YRAddressTableSlot *slots = malloc(capacity * sizeof(YRAddressTableSlot));
+
+    if (!hashes || !slots) {
+        free(hashes);
+        free(slots);
+        return false;
+    }
+
+    uint32_t *oldHashes = table->hashes;
+    YRAddressTableSlot *oldSlots = table->slots;
+    uint32_t oldCapacity = oldHashes ? table->mask + 1 : 0;
+
+    table->hashes = hashes;
+    table->slots = slots;
+    table->mask = capacity - 1;
+    // Keep load factor at most 3/4 so probe sequences stay short.
+    table->growThreshold = capacity - capacity / 4;
+
+    for (uint32_t i = 0; i < oldCapacity; i++) {
+        uint32_t hash = oldHashes[i];
+
+        if (hash == 0) {
+            continue;
+        }
+
+        uint32_t index = hash & table->mask;
+
+        while (hashes[index] != 0) {
+            index = (index + 1) & table->mask;
+        }
+
+        hashes[index] = hash;
+        slots[index] = oldSlots[i];
+    }
+
+    free(oldHashes);
+    free(oldSlots);
+
+    return true;
+}
+
+uint32_t YRAddressTableCapacityForCount(uint32_t count) {
+    uint32_t capacity = kYRAddressTableMinimumCapacity;
+
+    while (capacity - capacity / 4 < count && capacity < (1u << 31)) {
+        capacity <<= 1;
+    }
+
+    return capacity;
+}
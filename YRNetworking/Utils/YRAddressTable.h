@@ -0,0 +1,73 @@
+//
+// YRAddressTable.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __YRAddressTable__
+#define __YRAddressTable__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#pragma mark - Declarations
+
+/**
+ *  Hash table that maps peer address (IPv4/IPv6 + port) to opaque value.
+ *  Uses open addressing with linear probing over flat arrays and backward shift deletion,
+ *  so table never accumulates tombstones.
+ *  IPv4 and v4-mapped IPv6 addresses of the same peer are treated as equal.
+ */
+typedef struct YRAddressTable *YRAddressTableRef;
+
+#pragma mark - Lifecycle
+
+/**
+ *  Creates table that can hold capacityHint entries without growing.
+ */
+YRAddressTableRef YRAddressTableCreate(uint32_t capacityHint);
+void YRAddressTableDestroy(YRAddressTableRef table);
+
+#pragma mark - Access
+
+/**
+ *  Returns value for given address or NULL if there is none.
+ */
+void *YRAddressTableGet(YRAddressTableRef table, const struct sockaddr *address);
+
+/**
+ *  Inserts value for given address replacing existing one.
+ *  Returns false if address family is not supported or table failed to grow.
+ */
+bool YRAddressTableSet(YRAddressTableRef table, const struct sockaddr *address, void *value);
+
+/**
+ *  Removes entry for given address. Returns removed value or NULL if there was none.
+ */
+void *YRAddressTableRemove(YRAddressTableRef table, const struct sockaddr *address);
+
+void YRAddressTableRemoveAll(YRAddressTableRef table);
+
+uint32_t YRAddressTableGetCount(YRAddressTableRef table);
+
+#endif
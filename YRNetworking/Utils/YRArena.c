@@ -0,0 +1,88 @@
+//
+// YRArena.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "YRArena.h"
+
+#include <stdlib.h>
+
+#define kYRArenaAlignment 8
+
+#pragma mark - Declarations
+
+typedef struct YRArena {
+    size_t capacity;
+    size_t used;
+    uint8_t memory[] __attribute__ ((__aligned__(kYRArenaAlignment)));
+} YRArena;
+
+#pragma mark - Lifecycle
+
+YRArenaRef YRArenaCreate(size_t capacity) {
+    YRArenaRef arena = malloc(sizeof(YRArena) + capacity);
+
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->capacity = capacity;
+    arena->used = 0;
+
+    return arena;
+}
+
+void YRArenaDestroy(YRArenaRef arena) {
+    free(arena);
+}
+
+#pragma mark - Allocation
+
+void *YRArenaAllocate(YRArenaRef arena, size_t size) {
+    size_t alignedSize = (size + (kYRArenaAlignment - 1)) & ~(size_t)(kYRArenaAlignment - 1);
+
+    if (alignedSize < size || alignedSize > arena->capacity - arena->used) {
+        return NULL;
+    }
+
+    void *memory = arena->memory + arena->used;
+
+    arena->used += alignedSize;
+
+    return memory;
+}
+
+void YRArenaReset(YRArenaRef arena) {
+    arena->used = 0;
+}
+
+#pragma mark - Introspection
+
+size_t YRArenaGetCapacity(YRArenaRef arena) {
+    return arena->capacity;
+}
+
+size_t YRArenaGetUsedSize(YRArenaRef arena) {
+    return arena->used;
+}
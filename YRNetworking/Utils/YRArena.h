@@ -0,0 +1,64 @@
+//
+// YRArena.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef __YRArena__
+#define __YRArena__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma mark - Declarations
+
+/**
+ *  Bump allocator for short-lived memory, e.g. packets deserialized during one receive batch.
+ *  Allocation is a pointer increment, nothing is freed individually: owner resets whole arena
+ *  once everything allocated from it is no longer used. Arena never grows, so it never allocates after creation.
+ */
+typedef struct YRArena *YRArenaRef;
+
+#pragma mark - Lifecycle
+
+YRArenaRef YRArenaCreate(size_t capacity);
+void YRArenaDestroy(YRArenaRef arena);
+
+#pragma mark - Allocation
+
+/**
+ *  Returns 8-byte aligned memory or NULL if arena is exhausted. Memory is not zeroed.
+ */
+void *YRArenaAllocate(YRArenaRef arena, size_t size);
+
+/**
+ *  Releases every allocation at once.
+ */
+void YRArenaReset(YRArenaRef arena);
+
+#pragma mark - Introspection
+
+size_t YRArenaGetCapacity(YRArenaRef arena);
+size_t YRArenaGetUsedSize(YRArenaRef arena);
+
+#endif
@@ -0,0 +1,281 @@
+//
+// YRBufferPool.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "YRBufferPool.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define kYRBufferPoolMinClassShift 6
+#define kYRBufferPoolMaxClassShift 16
+#define kYRBufferPoolClassesCount (kYRBufferPoolMaxClassShift - kYRBufferPoolMinClassShift + 1)
+// Buffers per class kept by each thread. Half of it moves between cache and shared list at once.
+#define kYRBufferPoolCacheCapacity 32
+#define kYRBufferPoolCacheBatch (kYRBufferPoolCacheCapacity / 2)
+// Chunks are huge page sized, they are committed page by page as buffers are carved.
+#define kYRBufferPoolChunkSize (2 * 1024 * 1024)
+
+#pragma mark - Declarations
+
+typedef struct YRBufferPoolFreeBuffer {
+    struct YRBufferPoolFreeBuffer *next;
+} YRBufferPoolFreeBuffer;
+
+typedef struct {
+    pthread_mutex_t lock;
+    YRBufferPoolFreeBuffer *freeList;
+    // Not yet carved part of the latest chunk.
+    uint8_t *chunkCursor;
+    uint8_t *chunkEnd;
+} YRBufferPoolClass;
+
+typedef struct {
+    uint8_t counts[kYRBufferPoolClassesCount];
+    void *buffers[kYRBufferPoolClassesCount][kYRBufferPoolCacheCapacity];
+} YRBufferPoolThreadCache;
+
+static YRBufferPoolClass gYRBufferPoolClasses[kYRBufferPoolClassesCount];
+static pthread_mutex_t gYRBufferPoolReservedLock = PTHREAD_MUTEX_INITIALIZER;
+static size_t gYRBufferPoolReservedSize = 0;
+static pthread_key_t gYRBufferPoolCacheKey;
+static _Thread_local YRBufferPoolThreadCache *tYRBufferPoolCache = NULL;
+
+#pragma mark - Prototypes
+
+static inline int YRBufferPoolClassIndexForSize(size_t size);
+static inline size_t YRBufferPoolClassSize(int classIndex);
+static YRBufferPoolThreadCache *YRBufferPoolGetThreadCache(void);
+static void YRBufferPoolDestroyThreadCache(void *cache);
+static int YRBufferPoolTake(int classIndex, void **outBuffers, int count);
+static void YRBufferPoolPut(int classIndex, void **buffers, int count);
+
+#pragma mark - Initialization
+
+__attribute__((constructor))
+static void YRBufferPoolInitialize(void) {
+    for (int i = 0; i < kYRBufferPoolClassesCount; i++) {
+        pthread_mutex_init(&gYRBufferPoolClasses[i].lock, NULL);
+    }
+
+    // Destructor flushes caches of exiting threads.
+    pthread_key_create(&gYRBufferPoolCacheKey, YRBufferPoolDestroyThreadCache);
+}
+
+#pragma mark - Buffers
+
+void *YRBufferPoolAcquire(size_t size) {
+    int classIndex = YRBufferPoolClassIndexForSize(size);
+
+    if (classIndex < 0) {
+        return NULL;
+    }
+
+    YRBufferPoolThreadCache *cache = YRBufferPoolGetThreadCache();
+
+    if (!cache) {
+        void *buffer = NULL;
+
+        return YRBufferPoolTake(classIndex, &buffer, 1) ? buffer : NULL;
+    }
+
+    if (cache->counts[classIndex] == 0) {
+        cache->counts[classIndex] = YRBufferPoolTake(classIndex, cache->buffers[classIndex], kYRBufferPoolCacheBatch);
+
+        if (cache->counts[classIndex] == 0) {
+            return NULL;
+        }
+    }
+
+    // LIFO keeps recently used (cache hot) buffers in circulation.
+    return cache->buffers[classIndex][--cache->counts[classIndex]];
+}
+
+void YRBufferPoolRelease(void *buffer, size_t size) {
+    int classIndex = YRBufferPoolClassIndexForSize(size);
+
+    if (!buffer || classIndex < 0) {
+        return;
+    }
+
+    YRBufferPoolThreadCache *cache = YRBufferPoolGetThreadCache();
+
+    if (!cache) {
+        YRBufferPoolPut(classIndex, &buffer, 1);
+        return;
+    }
+
+    if (cache->counts[classIndex] == kYRBufferPoolCacheCapacity) {
+        // Give away the older half.
+        YRBufferPoolPut(classIndex, cache->buffers[classIndex], kYRBufferPoolCacheBatch);
+
+        for (int i = 0; i < kYRBufferPoolCacheCapacity - kYRBufferPoolCacheBatch; i++) {
+            cache->buffers[classIndex][i] = cache->buffers[classIndex][i + kYRBufferPoolCacheBatch];
+        }
+
+        cache->counts[classIndex] -= kYRBufferPoolCacheBatch;
+    }
+
+    cache->buffers[classIndex][cache->counts[classIndex]++] = buffer;
+}
+
+size_t YRBufferPoolGetSizeClass(size_t size) {
+    int classIndex = YRBufferPoolClassIndexForSize(size);
+
+    return classIndex < 0 ? 0 : YRBufferPoolClassSize(classIndex);
+}
+
+#pragma mark - Maintenance
+
+void YRBufferPoolFlushThreadCache(void) {
+    YRBufferPoolThreadCache *cache = tYRBufferPoolCache;
+
+    if (!cache) {
+        return;
+    }
+
+    for (int i = 0; i < kYRBufferPoolClassesCount; i++) {
+        YRBufferPoolPut(i, cache->buffers[i], cache->counts[i]);
+        cache->counts[i] = 0;
+    }
+}
+
+size_t YRBufferPoolGetReservedSize(void) {
+    pthread_mutex_lock(&gYRBufferPoolReservedLock);
+
+    size_t reservedSize = gYRBufferPoolReservedSize;
+
+    pthread_mutex_unlock(&gYRBufferPoolReservedLock);
+
+    return reservedSize;
+}
+
+#pragma mark - Private
+
+int YRBufferPoolClassIndexForSize(size_t size) {
+    if (size > kYRBufferPoolMaxBufferSize) {
+        return -1;
+    }
+
+    if (size <= (1 << kYRBufferPoolMinClassShift)) {
+        return 0;
+    }
+
+    // Index of the highest bit of size - 1 gives ceil(log2(size)).
+    int shift = (int)(sizeof(unsigned long long) * 8) - __builtin_clzll((unsigned long long)(size - 1));
+
+    return shift - kYRBufferPoolMinClassShift;
+}
+
+size_t YRBufferPoolClassSize(int classIndex) {
+    return (size_t)1 << (classIndex + kYRBufferPoolMinClassShift);
+}
+
+YRBufferPoolThreadCache *YRBufferPoolGetThreadCache(void) {
+    if (!tYRBufferPoolCache) {
+        tYRBufferPoolCache = calloc(1, sizeof(YRBufferPoolThreadCache));
+
+        if (tYRBufferPoolCache && pthread_setspecific(gYRBufferPoolCacheKey, tYRBufferPoolCache) != 0) {
+            // Cache wouldn't be flushed on thread exit, go to shared lists directly.
+            free(tYRBufferPoolCache);
+            tYRBufferPoolCache = NULL;
+        }
+    }
+
+    return tYRBufferPoolCache;
+}
+
+void YRBufferPoolDestroyThreadCache(void *cache) {
+    tYRBufferPoolCache = cache;
+
+    YRBufferPoolFlushThreadCache();
+
+    tYRBufferPoolCache = NULL;
+
+    free(cache);
+}
+
+int YRBufferPoolTake(int classIndex, void **outBuffers, int count) {
+    YRBufferPoolClass *poolClass = &gYRBufferPoolClasses[classIndex];
+    size_t classSize = YRBufferPoolClassSize(classIndex);
+    int taken = 0;
+
+    pthread_mutex_lock(&poolClass->lock);
+
+    while (taken < count && poolClass->freeList) {
+        outBuffers[taken++] = poolClass->freeList;
+        poolClass->freeList = poolClass->freeList->next;
+    }
+
+    while (taken < count) {
+        if (poolClass->chunkCursor == poolClass->chunkEnd) {
+            void *chunk = mmap(NULL, kYRBufferPoolChunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+
+            if (chunk == MAP_FAILED) {
+                break;
+            }
+
+#ifdef MADV_HUGEPAGE
+            madvise(chunk, kYRBufferPoolChunkSize, MADV_HUGEPAGE);
+#endif
+
+            poolClass->chunkCursor = chunk;
+            poolClass->chunkEnd = poolClass->chunkCursor + kYRBufferPoolChunkSize;
+
+            pthread_mutex_lock(&gYRBufferPoolReservedLock);
+            gYRBufferPoolReservedSize += kYRBufferPoolChunkSize;
+            pthread_mutex_unlock(&gYRBufferPoolReservedLock);
+        }
+
+        outBuffers[taken++] = poolClass->chunkCursor;
+        poolClass->chunkCursor += classSize;
+    }
+
+    pthread_mutex_unlock(&poolClass->lock);
+
+    return taken;
+}
+
+void YRBufferPoolPut(int classIndex, void **buffers, int count) {
+    if (count == 0) {
+        return;
+    }
+
+    YRBufferPoolClass *poolClass = &gYRBufferPoolClasses[classIndex];
+
+    // Link batch outside of lock.
+    for (int i = 0; i < count - 1; i++) {
+        ((YRBufferPoolFreeBuffer *)buffers[i])->next = buffers[i + 1];
+    }
+
+    pthread_mutex_lock(&poolClass->lock);
+
+    ((YRBufferPoolFreeBuffer *)buffers[count - 1])->next = poolClass->freeList;
+    poolClass->freeList = buffers[0];
+
+    pthread_mutex_unlock(&poolClass->lock);
+}
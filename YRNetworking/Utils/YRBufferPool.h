@@ -0,0 +1,74 @@
+//
+// YRBufferPool.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef __YRBufferPool__
+#define __YRBufferPool__
+
+#include <stddef.h>
+
+#pragma mark - Declarations
+
+/**
+ *  Process-wide pool of buffers in power of two size classes from 64 bytes to 64 KB.
+ *  Buffer of size class is aligned to it (up to page size), contents are unspecified.
+ *
+ *  Every thread keeps small cache per size class, so acquiring and releasing buffer normally takes no locks.
+ *  Caches exchange buffers with shared free lists in batches and are flushed to them when thread exits.
+ *  Buffer may be released on any thread, not necessarily on one that acquired it.
+ *
+ *  Memory is reserved from system in lazily committed chunks and is reused, never returned.
+ */
+
+static const size_t kYRBufferPoolMaxBufferSize = 64 * 1024;
+
+#pragma mark - Buffers
+
+/**
+ *  Returns NULL if size exceeds kYRBufferPoolMaxBufferSize or memory is exhausted.
+ */
+void *YRBufferPoolAcquire(size_t size);
+/**
+ *  Size must be the same as passed to YRBufferPoolAcquire.
+ */
+void YRBufferPoolRelease(void *buffer, size_t size);
+
+/**
+ *  Size of buffer actually handed out for given size, 0 if size is too big.
+ */
+size_t YRBufferPoolGetSizeClass(size_t size);
+
+#pragma mark - Maintenance
+
+/**
+ *  Moves buffers cached by calling thread to shared free lists.
+ */
+void YRBufferPoolFlushThreadCache(void);
+/**
+ *  Bytes of address space reserved by pool so far.
+ */
+size_t YRBufferPoolGetReservedSize(void);
+
+#endif
@@ -7,20 +7,26 @@
 //
 
 #include "YRPacketsQueue.h"
+#include "YRBufferPool.h"
 
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/mman.h>
 
-//
+// Buffers are allocated in regions of this count on first access, so large queues don't need
+// one huge allocation and memory is taken only for part of window that is actually used.
+static const uint16_t kYRPacketsQueueRegionLength = 32;
 
-typedef struct YRQueueElement *YRQueueElementRef;
+static const uint16_t kYRPacketsQueueMinAlignment = 8;
+static const uint16_t kYRPacketsQueueMaxAlignment = 4096;
 
-typedef struct YRQueueElement {
-    YRQueueElementRef next;
-    YRQueueElementRef prev;
-    
-    uint8_t bufferBlob[];
-} YRQueueElement;
+// Slab is rounded to huge page size, so the last huge page isn't split.
+static const size_t kYRPacketsQueueHugePageSize = 2 * 1024 * 1024;
+
+// In-use flags are kept in bitmap indexed the same way as buffers (ring index, not segment).
+typedef uint64_t YRPacketsQueueBitmapWord;
+
+static const uint8_t kYRPacketsQueueBitmapWordBits = sizeof(YRPacketsQueueBitmapWord) * 8;
 
 //
 
@@ -31,69 +37,126 @@ enum YRPacketsQueueFlags {
 typedef uint8_t YRPacketsQueueFlags;
 
 typedef struct YRPacketsQueue {
-    YRQueueElementRef headBufferInUse;
-    YRQueueElementRef tailBufferInUse;
+    YRPacketsQueueBitmapWord *buffersInUse;
+    // Slots that hold pooled buffer, NULL unless kYRPacketsQueueOptionPooled. Superset of buffersInUse.
+    YRPacketsQueueBitmapWord *buffersAttached;
+    // Single mapping backing all regions, NULL if regions are allocated separately.
+    uint8_t *slab;
+    size_t slabSize;
+    size_t elementSize;
     
     YRSequenceNumberType base;
-    YRPayloadLengthType bufferSize;
-    uint8_t currentIndex;
-    uint8_t buffersCount;
-    uint8_t buffersInUseCount;
+    uint16_t alignment;
+    uint16_t currentIndex;
+    uint16_t buffersCount;
+    uint16_t buffersInUseCount;
+    uint16_t buffersAttachedCount;
+    uint16_t regionsCount;
+    uint16_t bitmapWordsCount;
     YRPacketsQueueFlags flags;
     
-    YRQueueElementRef elements[];
+    // Buffers or, for pooled queues, tables of pointers to pooled buffers.
+    uint8_t *regions[];
 } YRPacketsQueue;
 
 #pragma mark - Prototypes
 
-static inline size_t YRPacketsQueueElementSizeForBufferSize(YRPayloadLengthType bufferSize);
+static inline uint16_t YRPacketsQueueNormalizedAlignment(uint16_t alignment);
+void YRPacketsQueueMapSlab(YRPacketsQueueRef queue);
 static inline bool YRPacketsQueueHasBufferForSegmentInlined(YRPacketsQueueRef queue, YRSequenceNumberType segment);
-YRQueueElementRef YRPacketsQueueElementForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment);
+static inline uint16_t YRPacketsQueueIndexForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment);
+static inline bool YRPacketsQueueIsIndexInUse(YRPacketsQueueRef queue, uint16_t index);
+static inline YRPacketsQueueBitmapWord YRPacketsQueueBitmapMask(uint16_t from, uint16_t to);
+void YRPacketsQueueClearIndexes(YRPacketsQueueRef queue, uint16_t from, uint16_t to);
+uint16_t YRPacketsQueueCollectIndexes(YRPacketsQueueRef queue, uint16_t from, uint16_t to, YRSequenceNumberType *outSegments, uint16_t count);
+uint16_t YRPacketsQueueCollectRanges(YRPacketsQueueRef queue,
+                                     uint16_t from,
+                                     uint16_t to,
+                                     YRSequenceNumberType *ioRanges,
+                                     uint16_t collected,
+                                     uint16_t count);
+void *YRPacketsQueueBufferForIndex(YRPacketsQueueRef queue, uint16_t index);
+void *YRPacketsQueuePooledBufferForIndex(YRPacketsQueueRef queue, uint16_t index);
+void YRPacketsQueueReleasePooledBufferForIndex(YRPacketsQueueRef queue, uint16_t index);
 
 #pragma mark - Lifecycle
 
-YRPacketsQueueRef YRPacketsQueueCreate(YRPayloadLengthType bufferSize, uint8_t buffersCount) {
-    // TODO: Try several regions in case of large allocations e.g. 1300 * 255
+YRPacketsQueueRef YRPacketsQueueCreate(size_t bufferSize, uint16_t buffersCount) {
+    return YRPacketsQueueCreateWithOptions(bufferSize, buffersCount, kYRPacketsQueueMinAlignment, 0);
+}
+
+YRPacketsQueueRef YRPacketsQueueCreateWithOptions(size_t bufferSize,
+                                                  uint16_t buffersCount,
+                                                  uint16_t buffersAlignment,
+                                                  YRPacketsQueueOptions options) {
     if (buffersCount == 0) {
         buffersCount = 1;
     }
     
-    size_t elementsSize = YRPacketsQueueElementSizeForBufferSize(bufferSize) * buffersCount;
-    YRPacketsQueueRef queue = calloc(1, sizeof(YRPacketsQueue) + elementsSize);
+    uint16_t regionsCount = (buffersCount + kYRPacketsQueueRegionLength - 1) / kYRPacketsQueueRegionLength;
+    uint16_t bitmapWordsCount = (buffersCount + kYRPacketsQueueBitmapWordBits - 1) / kYRPacketsQueueBitmapWordBits;
+    size_t regionsSize = YRMakeMultipleTo(sizeof(uint8_t *) * regionsCount, sizeof(YRPacketsQueueBitmapWord));
+    
+    uint16_t alignment = YRPacketsQueueNormalizedAlignment(buffersAlignment);
+    // Zero-sized buffers still get distinct addresses.
+    size_t elementSize = YRMakeMultipleTo(bufferSize ? bufferSize : 1, alignment);
+    // Pool has no size class for larger buffers, they live in regions.
+    bool isPooled = (options & kYRPacketsQueueOptionPooled) != 0 && elementSize <= kYRBufferPoolMaxBufferSize;
+    size_t bitmapsSize = sizeof(YRPacketsQueueBitmapWord) * bitmapWordsCount * (isPooled ? 2 : 1);
+    
+    YRPacketsQueueRef queue = calloc(1, sizeof(YRPacketsQueue) + regionsSize + bitmapsSize);
+    
+    if (!queue) {
+        return NULL;
+    }
     
-    queue->bufferSize = bufferSize;
+    // Bitmaps live right after regions in the same allocation.
+    queue->buffersInUse = (YRPacketsQueueBitmapWord *)((uint8_t *)queue->regions + regionsSize);
+    queue->buffersAttached = isPooled ? queue->buffersInUse + bitmapWordsCount : NULL;
+    queue->alignment = alignment;
+    queue->elementSize = elementSize;
     queue->buffersCount = buffersCount;
+    queue->regionsCount = regionsCount;
+    queue->bitmapWordsCount = bitmapWordsCount;
+    
+    if (!(options & kYRPacketsQueueOptionPooled) && (options & kYRPacketsQueueOptionHugePages)) {
+        YRPacketsQueueMapSlab(queue);
+    }
     
     return queue;
 }
 
 void YRPacketsQueueDestroy(YRPacketsQueueRef queue) {
     if (queue) {
+        // Return pooled buffers.
+        YRPacketsQueueClearIndexes(queue, 0, queue->buffersCount);
+        
+        if (queue->slab) {
+            munmap(queue->slab, queue->slabSize);
+        } else {
+            for (uint16_t i = 0; i < queue->regionsCount; i++) {
+                free(queue->regions[i]);
+            }
+        }
+        
         free(queue);
     }
 }
 
+#pragma mark - Configuration
+
+size_t YRPacketsQueueGetBufferSize(YRPacketsQueueRef queue) {
+    return queue->elementSize;
+}
+
 #pragma mark - Base Segment
 
 void YRPacketsQueueSetBaseSegment(YRPacketsQueueRef queue, YRSequenceNumberType base) {
     queue->base = base;
     queue->currentIndex = 0;
     
-    YRQueueElementRef currentElement = queue->headBufferInUse;
-    
-    while (currentElement != NULL) {
-        YRQueueElementRef elementToCleanup = currentElement;
-        
-        currentElement = currentElement->next;
-        
-        elementToCleanup->next = NULL;
-        elementToCleanup->prev = NULL;
-    }
-    
     // Clear all in-use buffers.
-    queue->headBufferInUse = NULL;
-    queue->tailBufferInUse = NULL;
-    queue->buffersInUseCount = 0;
+    YRPacketsQueueClearIndexes(queue, 0, queue->buffersCount);
     
     queue->flags |= kYRPacketsQueueFlagIsBaseSet;
 }
@@ -103,18 +166,21 @@ YRSequenceNumberType YRPacketsQueueGetBaseSegment(YRPacketsQueueRef queue) {
 }
 
 void YRPacketsQueueAdvanceBaseSegment(YRPacketsQueueRef queue, YRSequenceNumberType by) {
-    if (by > queue->buffersCount) {
+    if (by >= queue->buffersCount) {
         YRPacketsQueueSetBaseSegment(queue, queue->base + by);
     } else {
-        // Unmark possible buffers in use that fall in range base + by
-        // Worst case scenario 'by == buffersCount == UINT8_MAX'
-        // In this one we probably can check some treshold and request buffers in use and iterate through them.
-        for (YRSequenceNumberType segment = queue->base; segment < (YRSequenceNumberType)(queue->base + by); segment++) {
-            YRPacketsQueueUnmarkBufferInUseForSegment(queue, segment);
+        // Unmark buffers in use that fall in range base + by, a word at a time.
+        uint32_t end = (uint32_t)queue->currentIndex + by;
+        
+        if (end <= queue->buffersCount) {
+            YRPacketsQueueClearIndexes(queue, queue->currentIndex, end);
+        } else {
+            YRPacketsQueueClearIndexes(queue, queue->currentIndex, queue->buffersCount);
+            YRPacketsQueueClearIndexes(queue, 0, end - queue->buffersCount);
         }
         
         queue->base += by;
-        queue->currentIndex += by;
+        queue->currentIndex = end % queue->buffersCount;
     }
 }
 
@@ -125,122 +191,135 @@ bool YRPacketsQueueHasBufferForSegment(YRPacketsQueueRef queue, YRSequenceNumber
 }
 
 bool YRPacketsQueueIsBufferInUseForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment) {
-    YRQueueElementRef element = YRPacketsQueueElementForSegment(queue, segment);
-    
-    if (!element) {
-        // No element for given segment.
+    if (!YRPacketsQueueHasBufferForSegmentInlined(queue, segment)) {
+        // No buffer for given segment.
         return false;
     }
     
-    return element->next != NULL || element->prev != NULL || element == queue->headBufferInUse;
+    return YRPacketsQueueIsIndexInUse(queue, YRPacketsQueueIndexForSegment(queue, segment));
 }
 
 void *YRPacketsQueueBufferForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment) {
-    if (YRPacketsQueueHasBufferForSegmentInlined(queue, segment)) {
-        return YRPacketsQueueElementForSegment(queue, segment)->bufferBlob;
-    } else {
+    if (!YRPacketsQueueHasBufferForSegmentInlined(queue, segment)) {
         return NULL;
     }
+    
+    return YRPacketsQueueBufferForIndex(queue, YRPacketsQueueIndexForSegment(queue, segment));
 }
 
 void YRPacketsQueueMarkBufferInUseForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment) {
-    if (YRPacketsQueueHasBufferForSegmentInlined(queue, segment) &&
-        !YRPacketsQueueIsBufferInUseForSegment(queue, segment)) {
-        queue->buffersInUseCount++;
-        
-        YRQueueElementRef element = YRPacketsQueueElementForSegment(queue, segment);
-        
-        if (queue->headBufferInUse == NULL) {
-            // No elements in use currently.
-            queue->headBufferInUse = element;
-            queue->tailBufferInUse = element;
-        } else {
-            YRQueueElementRef currentTail = queue->tailBufferInUse;
-            
-            currentTail->next = element;
-            
-            element->prev = currentTail;
-            
-            queue->tailBufferInUse = element;
-        }
+    if (!YRPacketsQueueHasBufferForSegmentInlined(queue, segment)) {
+        return;
     }
+    
+    uint16_t index = YRPacketsQueueIndexForSegment(queue, segment);
+    
+    if (YRPacketsQueueIsIndexInUse(queue, index) || !YRPacketsQueueBufferForIndex(queue, index)) {
+        // Already in use or region allocation failed.
+        return;
+    }
+    
+    queue->buffersInUse[index / kYRPacketsQueueBitmapWordBits] |= (YRPacketsQueueBitmapWord)1 << (index % kYRPacketsQueueBitmapWordBits);
+    queue->buffersInUseCount++;
 }
 
 void YRPacketsQueueUnmarkBufferInUseForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment) {
-    if (YRPacketsQueueHasBufferForSegmentInlined(queue, segment) &&
-        YRPacketsQueueIsBufferInUseForSegment(queue, segment)) {
+    if (!YRPacketsQueueHasBufferForSegmentInlined(queue, segment)) {
+        return;
+    }
+    
+    uint16_t index = YRPacketsQueueIndexForSegment(queue, segment);
+    
+    if (YRPacketsQueueIsIndexInUse(queue, index)) {
+        queue->buffersInUse[index / kYRPacketsQueueBitmapWordBits] &= ~((YRPacketsQueueBitmapWord)1 << (index % kYRPacketsQueueBitmapWordBits));
         queue->buffersInUseCount--;
         
-        YRQueueElementRef element = YRPacketsQueueElementForSegment(queue, segment);
-        
-        YRQueueElementRef nextElement = element->next;
-        YRQueueElementRef previousElement = element->prev;
-        
-        element->next = NULL;
-        element->prev = NULL;
-        
-        if (nextElement != NULL) {
-            nextElement->prev = previousElement;
-        }
-        
-        if (previousElement != NULL) {
-            previousElement->next = nextElement;
-        }
-        
-        if (element == queue->tailBufferInUse) {
-            // We're unmarking last element in use.
-            queue->tailBufferInUse = previousElement;
-        }
-        
-        if (element == queue->headBufferInUse) {
-            // We're unmarking first element in use.
-            queue->headBufferInUse = nextElement;
+        if (queue->buffersAttached) {
+            YRPacketsQueueReleasePooledBufferForIndex(queue, index);
         }
     }
 }
 
-uint8_t YRPacketsQueueBuffersInUse(YRPacketsQueueRef queue) {
+uint16_t YRPacketsQueueBuffersInUse(YRPacketsQueueRef queue) {
     return queue->buffersInUseCount;
 }
 
-void YRPacketsQueueGetSegmentNumbersForBuffersInUse(YRPacketsQueueRef queue, YRSequenceNumberType *outSegments, uint8_t *inOutCount) {
+void YRPacketsQueueGetSegmentNumbersForBuffersInUse(YRPacketsQueueRef queue, YRSequenceNumberType *outSegments, uint16_t *inOutCount) {
     if (!inOutCount || !outSegments) {
         return;
     }
     
-    uint8_t buffersInUse = YRPacketsQueueBuffersInUse(queue);
-    uint8_t buffersToProvide = *inOutCount;
+    uint16_t buffersToProvide = *inOutCount;
     
-    if (buffersInUse < buffersToProvide) {
-        buffersToProvide = buffersInUse;
+    if (queue->buffersInUseCount < buffersToProvide) {
+        buffersToProvide = queue->buffersInUseCount;
     }
     
-    YRQueueElementRef queueElement = queue->headBufferInUse;
-    size_t elementSize = YRPacketsQueueElementSizeForBufferSize(queue->bufferSize);
+    // Ring is walked from base, so segments come out in ascending order.
+    uint16_t provided = YRPacketsQueueCollectIndexes(queue, queue->currentIndex, queue->buffersCount, outSegments, buffersToProvide);
     
-    for (uint8_t i = 0; i < buffersToProvide; i++) {
-        assert(queueElement != NULL);
-        
-        uintptr_t elementAddress = (uintptr_t)queueElement;
-        uintptr_t diff = elementAddress - (uintptr_t)queue->elements;
-        
-        assert(diff % elementSize == 0);
-        
-        uint8_t index = diff / elementSize;
-        uint8_t indexDiff = index - queue->currentIndex;
-        
-        outSegments[i] = queue->base + indexDiff;
-        
-        queueElement = queueElement->next;
+    provided += YRPacketsQueueCollectIndexes(queue, 0, queue->currentIndex, outSegments + provided, buffersToProvide - provided);
+    
+    assert(provided == buffersToProvide);
+    
+    *inOutCount = provided;
+}
+
+void YRPacketsQueueGetSegmentRangesForBuffersInUse(YRPacketsQueueRef queue, YRSequenceNumberType *outRanges, uint16_t *inOutCount) {
+    if (!inOutCount || !outRanges) {
+        return;
     }
     
-    *inOutCount = buffersToProvide;
+    uint16_t collected = 0;
+    
+    if (*inOutCount > 0 && queue->buffersInUseCount > 0) {
+        // Range that crosses end of ring is continued by the second pass.
+        collected = YRPacketsQueueCollectRanges(queue, queue->currentIndex, queue->buffersCount, outRanges, 0, *inOutCount);
+        collected = YRPacketsQueueCollectRanges(queue, 0, queue->currentIndex, outRanges, collected, *inOutCount);
+    }
+    
+    *inOutCount = collected;
 }
 
 #pragma mark - Private
 
-size_t YRPacketsQueueElementSizeForBufferSize(YRPayloadLengthType bufferSize) {
-    return YRMakeMultipleTo((sizeof(YRQueueElement) + bufferSize), sizeof(YRQueueElementRef));
+uint16_t YRPacketsQueueNormalizedAlignment(uint16_t alignment) {
+    uint16_t normalized = kYRPacketsQueueMinAlignment;
+    
+    // Round up to power of two within supported range.
+    while (normalized < alignment && normalized < kYRPacketsQueueMaxAlignment) {
+        normalized <<= 1;
+    }
+    
+    return normalized;
+}
+
+void YRPacketsQueueMapSlab(YRPacketsQueueRef queue) {
+    size_t slabSize = YRMakeMultipleTo(queue->elementSize * kYRPacketsQueueRegionLength * queue->regionsCount,
+                                       kYRPacketsQueueHugePageSize);
+    void *slab = MAP_FAILED;
+    
+    // Anonymous pages are zero-filled by kernel on first touch, so untouched part of window costs nothing.
+#ifdef MAP_HUGETLB
+    slab = mmap(NULL, slabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    
+    if (slab == MAP_FAILED) {
+        // No reserved huge pages, ask for transparent ones.
+        slab = mmap(NULL, slabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+        
+        if (slab == MAP_FAILED) {
+            // Regions are allocated separately then.
+            return;
+        }
+        
+#ifdef MADV_HUGEPAGE
+        madvise(slab, slabSize, MADV_HUGEPAGE);
+#endif
+    }
+    
+    queue->slab = slab;
+    queue->slabSize = slabSize;
 }
 
 bool YRPacketsQueueHasBufferForSegmentInlined(YRPacketsQueueRef queue, YRSequenceNumberType segment) {
@@ -250,19 +329,189 @@ bool YRPacketsQueueHasBufferForSegmentInlined(YRPacketsQueueRef queue, YRSequenc
     return offset < queue->buffersCount;
 }
 
-YRQueueElementRef YRPacketsQueueElementForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment) {
+uint16_t YRPacketsQueueIndexForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment) {
     // Overflow is ok
     YRSequenceNumberType offset = segment - queue->base;
     
-    if (offset >= queue->buffersCount) {
-        // Segment is not in range.
-        return NULL;
+    return ((uint32_t)queue->currentIndex + offset) % queue->buffersCount;
+}
+
+bool YRPacketsQueueIsIndexInUse(YRPacketsQueueRef queue, uint16_t index) {
+    return (queue->buffersInUse[index / kYRPacketsQueueBitmapWordBits] >> (index % kYRPacketsQueueBitmapWordBits)) & 1;
+}
+
+YRPacketsQueueBitmapWord YRPacketsQueueBitmapMask(uint16_t from, uint16_t to) {
+    // Bits [from, to) of a single word, to is in range (from, kYRPacketsQueueBitmapWordBits].
+    YRPacketsQueueBitmapWord mask = ~(YRPacketsQueueBitmapWord)0 << from;
+    
+    if (to < kYRPacketsQueueBitmapWordBits) {
+        mask &= ((YRPacketsQueueBitmapWord)1 << to) - 1;
+    }
+    
+    return mask;
+}
+
+void YRPacketsQueueClearIndexes(YRPacketsQueueRef queue, uint16_t from, uint16_t to) {
+    while (from < to && (queue->buffersInUseCount > 0 || queue->buffersAttachedCount > 0)) {
+        uint16_t word = from / kYRPacketsQueueBitmapWordBits;
+        uint16_t wordStart = word * kYRPacketsQueueBitmapWordBits;
+        uint16_t wordEnd = to - wordStart < kYRPacketsQueueBitmapWordBits ? to - wordStart : kYRPacketsQueueBitmapWordBits;
+        YRPacketsQueueBitmapWord mask = YRPacketsQueueBitmapMask(from - wordStart, wordEnd);
+        YRPacketsQueueBitmapWord cleared = queue->buffersInUse[word] & mask;
+        
+        queue->buffersInUse[word] &= ~cleared;
+        queue->buffersInUseCount -= __builtin_popcountll(cleared);
+        
+        if (queue->buffersAttached) {
+            // Buffers that were taken but never marked go back to pool too.
+            YRPacketsQueueBitmapWord attached = queue->buffersAttached[word] & mask;
+            
+            while (attached) {
+                YRPacketsQueueReleasePooledBufferForIndex(queue, wordStart + __builtin_ctzll(attached));
+                
+                attached &= attached - 1;
+            }
+        }
+        
+        from = wordStart + wordEnd;
+    }
+}
+
+uint16_t YRPacketsQueueCollectIndexes(YRPacketsQueueRef queue, uint16_t from, uint16_t to, YRSequenceNumberType *outSegments, uint16_t count) {
+    uint16_t collected = 0;
+    
+    while (from < to && collected < count) {
+        uint16_t word = from / kYRPacketsQueueBitmapWordBits;
+        uint16_t wordStart = word * kYRPacketsQueueBitmapWordBits;
+        uint16_t wordEnd = to - wordStart < kYRPacketsQueueBitmapWordBits ? to - wordStart : kYRPacketsQueueBitmapWordBits;
+        YRPacketsQueueBitmapWord bits = queue->buffersInUse[word] & YRPacketsQueueBitmapMask(from - wordStart, wordEnd);
+        
+        while (bits && collected < count) {
+            uint16_t index = wordStart + __builtin_ctzll(bits);
+            uint16_t indexDiff = ((uint32_t)index + queue->buffersCount - queue->currentIndex) % queue->buffersCount;
+            
+            outSegments[collected++] = queue->base + indexDiff;
+            
+            // Drop lowest set bit.
+            bits &= bits - 1;
+        }
+        
+        from = wordStart + wordEnd;
     }
     
-    uint8_t index = (queue->currentIndex + offset) % queue->buffersCount;
-    size_t elementSize = YRPacketsQueueElementSizeForBufferSize(queue->bufferSize);
+    return collected;
+}
+
+uint16_t YRPacketsQueueCollectRanges(YRPacketsQueueRef queue,
+                                     uint16_t from,
+                                     uint16_t to,
+                                     YRSequenceNumberType *ioRanges,
+                                     uint16_t collected,
+                                     uint16_t count) {
+    while (from < to) {
+        uint16_t word = from / kYRPacketsQueueBitmapWordBits;
+        uint16_t wordStart = word * kYRPacketsQueueBitmapWordBits;
+        uint16_t wordEnd = to - wordStart < kYRPacketsQueueBitmapWordBits ? to - wordStart : kYRPacketsQueueBitmapWordBits;
+        YRPacketsQueueBitmapWord bits = queue->buffersInUse[word] & YRPacketsQueueBitmapMask(from - wordStart, wordEnd);
+        
+        while (bits) {
+            uint8_t start = __builtin_ctzll(bits);
+            YRPacketsQueueBitmapWord run = bits >> start;
+            // Run of set bits ends at the lowest clear bit above it.
+            uint8_t length = ~run ? __builtin_ctzll(~run) : kYRPacketsQueueBitmapWordBits - start;
+            uint16_t index = wordStart + start;
+            uint16_t indexDiff = ((uint32_t)index + queue->buffersCount - queue->currentIndex) % queue->buffersCount;
+            YRSequenceNumberType first = queue->base + indexDiff;
+            YRSequenceNumberType last = first + length - 1;
+            
+            if (collected > 0 && (YRSequenceNumberType)(ioRanges[2 * collected - 1] + 1) == first) {
+                // Run continues previous word (or previous pass).
+                ioRanges[2 * collected - 1] = last;
+            } else if (collected < count) {
+                ioRanges[2 * collected] = first;
+                ioRanges[2 * collected + 1] = last;
+                collected++;
+            } else {
+                return collected;
+            }
+            
+            bits = start + length < kYRPacketsQueueBitmapWordBits ? bits & ~((((YRPacketsQueueBitmapWord)1 << length) - 1) << start) : 0;
+        }
+        
+        from = wordStart + wordEnd;
+    }
+    
+    return collected;
+}
+
+void *YRPacketsQueueBufferForIndex(YRPacketsQueueRef queue, uint16_t index) {
+    if (queue->buffersAttached) {
+        return YRPacketsQueuePooledBufferForIndex(queue, index);
+    }
+    
+    uint16_t regionIndex = index / kYRPacketsQueueRegionLength;
+    size_t elementSize = queue->elementSize;
+    size_t regionSize = elementSize * kYRPacketsQueueRegionLength;
+    uint8_t *region = queue->regions[regionIndex];
+    
+    if (!region) {
+        if (queue->slab) {
+            region = queue->slab + regionIndex * regionSize;
+        } else {
+            void *memory = NULL;
+            
+            // Not zeroed: buffers are always written before they're read.
+            // Element size is multiple of alignment, so every buffer in region is aligned.
+            if (posix_memalign(&memory, queue->alignment, regionSize) != 0) {
+                return NULL;
+            }
+            
+            region = memory;
+        }
+        
+        queue->regions[regionIndex] = region;
+    }
+    
+    return region + (index % kYRPacketsQueueRegionLength) * elementSize;
+}
+
+void *YRPacketsQueuePooledBufferForIndex(YRPacketsQueueRef queue, uint16_t index) {
+    uint16_t regionIndex = index / kYRPacketsQueueRegionLength;
+    void **slots = (void **)queue->regions[regionIndex];
+    
+    if (!slots) {
+        slots = calloc(kYRPacketsQueueRegionLength, sizeof(void *));
+        
+        if (!slots) {
+            return NULL;
+        }
+        
+        queue->regions[regionIndex] = (uint8_t *)slots;
+    }
+    
+    void **slot = &slots[index % kYRPacketsQueueRegionLength];
+    
+    if (!*slot) {
+        *slot = YRBufferPoolAcquire(queue->elementSize);
+        
+        if (!*slot) {
+            return NULL;
+        }
+        
+        queue->buffersAttached[index / kYRPacketsQueueBitmapWordBits] |= (YRPacketsQueueBitmapWord)1 << (index % kYRPacketsQueueBitmapWordBits);
+        queue->buffersAttachedCount++;
+    }
+    
+    return *slot;
+}
+
+void YRPacketsQueueReleasePooledBufferForIndex(YRPacketsQueueRef queue, uint16_t index) {
+    void **slot = &((void **)queue->regions[index / kYRPacketsQueueRegionLength])[index % kYRPacketsQueueRegionLength];
+    
+    YRBufferPoolRelease(*slot, queue->elementSize);
     
-    YRQueueElementRef element = (YRQueueElementRef)((uint8_t *)queue->elements + (index * elementSize));
+    *slot = NULL;
     
-    return element;
+    queue->buffersAttached[index / kYRPacketsQueueBitmapWordBits] &= ~((YRPacketsQueueBitmapWord)1 << (index % kYRPacketsQueueBitmapWordBits));
+    queue->buffersAttachedCount--;
 }
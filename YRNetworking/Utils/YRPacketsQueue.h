@@ -15,16 +15,47 @@
 
 /**
  *  Simple data structure for storing packets data.
+ *  Holds up to UINT16_MAX buffers, their memory is allocated in regions on first use.
+ *  Buffers aren't zeroed.
  */
 typedef struct YRPacketsQueue *YRPacketsQueueRef;
 
+typedef enum {
+    // Backs all buffers with one lazily faulted mapping that asks for huge pages (MAP_HUGETLB, then
+    // transparent huge pages), cuts TLB misses for large windows. Falls back to regular regions silently.
+    kYRPacketsQueueOptionHugePages = 1 << 0,
+    // Slots take buffers from shared YRBufferPool when buffer for segment is requested and give them back
+    // when segment is unmarked or base passes it, so memory follows segments actually stored.
+    // Contents of unmarked buffers are lost. kYRPacketsQueueOptionHugePages is ignored.
+    // Buffers larger than kYRBufferPoolMaxBufferSize are kept in regions as if option wasn't set.
+    kYRPacketsQueueOptionPooled = 1 << 1,
+} YRPacketsQueueOption;
+
+typedef uint8_t YRPacketsQueueOptions;
+
 #pragma mark - Lifecycle
 
-YRPacketsQueueRef YRPacketsQueueCreate(YRPayloadLengthType bufferSize, uint8_t buffersCount);
-// TODO: Investigate this idea.
-//YRPacketsQueueRef YRPacketsQueueCreate(YRPayloadLengthType bufferSize, uint8_t buffersCount, uint8_t buffersAlignment);
+/**
+ *  Buffers are 8 bytes aligned.
+ */
+YRPacketsQueueRef YRPacketsQueueCreate(size_t bufferSize, uint16_t buffersCount);
+/**
+ *  Every buffer starts at multiple of buffersAlignment (e.g. 64 for cache line, 4096 for page).
+ *  Alignment is rounded up to power of two in range 8...4096.
+ */
+YRPacketsQueueRef YRPacketsQueueCreateWithOptions(size_t bufferSize,
+                                                  uint16_t buffersCount,
+                                                  uint16_t buffersAlignment,
+                                                  YRPacketsQueueOptions options);
 void YRPacketsQueueDestroy(YRPacketsQueueRef queue);
 
+#pragma mark - Configuration
+
+/**
+ *  Usable size of every buffer, bufferSize rounded up to alignment.
+ */
+size_t YRPacketsQueueGetBufferSize(YRPacketsQueueRef queue);
+
 #pragma mark - Base Segment
 
 void YRPacketsQueueSetBaseSegment(YRPacketsQueueRef queue, YRSequenceNumberType base);
@@ -37,14 +68,23 @@ bool YRPacketsQueueHasBufferForSegment(YRPacketsQueueRef queue, YRSequenceNumber
 bool YRPacketsQueueIsBufferInUseForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment);
 /**
  *  Returns buffer regardless if it's in use or not.
- *  Returns NULL if given segment is not in range of base + buffersCount (overflow is taken into account).
+ *  Returns NULL if given segment is not in range of base + buffersCount (overflow is taken into account)
+ *  or memory for it couldn't be allocated.
  */
 void *YRPacketsQueueBufferForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment);
 
 void YRPacketsQueueMarkBufferInUseForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment);
 void YRPacketsQueueUnmarkBufferInUseForSegment(YRPacketsQueueRef queue, YRSequenceNumberType segment);
 
-uint8_t YRPacketsQueueBuffersInUse(YRPacketsQueueRef queue);
-void YRPacketsQueueGetSegmentNumbersForBuffersInUse(YRPacketsQueueRef queue, YRSequenceNumberType *outSegments, uint8_t *inOutCount);
+uint16_t YRPacketsQueueBuffersInUse(YRPacketsQueueRef queue);
+/**
+ *  Provides segments in ascending order starting from base.
+ */
+void YRPacketsQueueGetSegmentNumbersForBuffersInUse(YRPacketsQueueRef queue, YRSequenceNumberType *outSegments, uint16_t *inOutCount);
+/**
+ *  Provides runs of consecutive segments in use as [first, last] pairs in ascending order starting from base,
+ *  so outRanges should have room for 2 * inOutCount sequence numbers. Ranges that don't fit are omitted.
+ */
+void YRPacketsQueueGetSegmentRangesForBuffersInUse(YRPacketsQueueRef queue, YRSequenceNumberType *outRanges, uint16_t *inOutCount);
 
 #endif
@@ -0,0 +1,201 @@
+//
+// YRSubmissionRing.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "YRSubmissionRing.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#pragma mark - Declarations
+
+// Slot is free for producer when its sequence equals position being pushed,
+// published for consumer when it equals position + 1 (D. Vyukov's bounded queue).
+typedef struct {
+    uint32_t sequence;
+    uint32_t length;
+    void *element;
+} YRSubmissionRingSlot;
+
+typedef struct YRSubmissionRing {
+    // Producers and consumer hammer different lines.
+    uint32_t tail __attribute__ ((__aligned__(64)));
+    uint32_t head __attribute__ ((__aligned__(64)));
+    uint32_t mask;
+    // Non-zero if every slot owns storage of this size (see YRSubmissionRingCreateWithElementSize).
+    uint32_t elementSize;
+
+    YRSubmissionRingSlot slots[] __attribute__ ((__aligned__(64)));
+} YRSubmissionRing;
+
+#pragma mark - Prototypes
+
+static YRSubmissionRingSlot *YRSubmissionRingClaim(YRSubmissionRingRef ring, uint32_t *outPosition);
+static void YRSubmissionRingPublish(YRSubmissionRingRef ring, YRSubmissionRingSlot *slot, uint32_t position, bool *outWasEmpty);
+
+#pragma mark - Lifecycle
+
+YRSubmissionRingRef YRSubmissionRingCreate(uint32_t capacity) {
+    return YRSubmissionRingCreateWithElementSize(capacity, 0);
+}
+
+YRSubmissionRingRef YRSubmissionRingCreateWithElementSize(uint32_t capacity, uint32_t elementSize) {
+    uint32_t roundedCapacity = 2;
+
+    while (roundedCapacity < capacity && roundedCapacity < (UINT32_MAX >> 2)) {
+        roundedCapacity <<= 1;
+    }
+
+    // Storage follows slots, each element starts at 8 bytes boundary.
+    size_t slotsSize = sizeof(YRSubmissionRing) + sizeof(YRSubmissionRingSlot) * roundedCapacity;
+    size_t alignedElementSize = (elementSize + 7) & ~(size_t)7;
+    YRSubmissionRingRef ring = NULL;
+
+    if (posix_memalign((void **)&ring, 64, slotsSize + alignedElementSize * roundedCapacity) != 0) {
+        return NULL;
+    }
+
+    ring->tail = 0;
+    ring->head = 0;
+    ring->mask = roundedCapacity - 1;
+    ring->elementSize = elementSize;
+
+    uint8_t *storage = (uint8_t *)ring + slotsSize;
+
+    for (uint32_t i = 0; i < roundedCapacity; i++) {
+        ring->slots[i].sequence = i;
+        ring->slots[i].length = 0;
+        ring->slots[i].element = elementSize > 0 ? storage + alignedElementSize * i : NULL;
+    }
+
+    return ring;
+}
+
+void YRSubmissionRingDestroy(YRSubmissionRingRef ring) {
+    free(ring);
+}
+
+#pragma mark - Producers
+
+bool YRSubmissionRingPush(YRSubmissionRingRef ring, void *element, uint32_t length, bool *outWasEmpty) {
+    uint32_t position = 0;
+    YRSubmissionRingSlot *slot = YRSubmissionRingClaim(ring, &position);
+
+    if (!slot) {
+        return false;
+    }
+
+    slot->element = element;
+    slot->length = length;
+
+    YRSubmissionRingPublish(ring, slot, position, outWasEmpty);
+
+    return true;
+}
+
+bool YRSubmissionRingPushCopy(YRSubmissionRingRef ring, const void *bytes, uint32_t length, bool *outWasEmpty) {
+    if (length > ring->elementSize) {
+        return false;
+    }
+
+    uint32_t position = 0;
+    YRSubmissionRingSlot *slot = YRSubmissionRingClaim(ring, &position);
+
+    if (!slot) {
+        return false;
+    }
+
+    // Slot's storage belongs to this producer till it's published.
+    memcpy(slot->element, bytes, length);
+    slot->length = length;
+
+    YRSubmissionRingPublish(ring, slot, position, outWasEmpty);
+
+    return true;
+}
+
+YRSubmissionRingSlot *YRSubmissionRingClaim(YRSubmissionRingRef ring, uint32_t *outPosition) {
+    uint32_t position = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    while (true) {
+        YRSubmissionRingSlot *slot = &ring->slots[position & ring->mask];
+
+        int32_t difference = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - position);
+
+        if (difference == 0) {
+            // Slot is free, claim position.
+            if (__atomic_compare_exchange_n(&ring->tail, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *outPosition = position;
+                return slot;
+            }
+        } else if (difference < 0) {
+            // Consumer hasn't released this slot yet: full.
+            return NULL;
+        } else {
+            // Another producer took this position.
+            position = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void YRSubmissionRingPublish(YRSubmissionRingRef ring, YRSubmissionRingSlot *slot, uint32_t position, bool *outWasEmpty) {
+    // Sequentially consistent publish and head load pair with consumer's ones, so either consumer sees
+    // this element or producer sees that consumer has drained everything before it.
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_SEQ_CST);
+
+    if (outWasEmpty) {
+        *outWasEmpty = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == position;
+    }
+}
+
+#pragma mark - Consumer
+
+bool YRSubmissionRingPeek(YRSubmissionRingRef ring, void **outElement, uint32_t *outLength) {
+    uint32_t position = ring->head;
+    YRSubmissionRingSlot *slot = &ring->slots[position & ring->mask];
+
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_SEQ_CST) != position + 1) {
+        return false;
+    }
+
+    if (outElement) {
+        *outElement = slot->element;
+    }
+
+    if (outLength) {
+        *outLength = slot->length;
+    }
+
+    return true;
+}
+
+void YRSubmissionRingPop(YRSubmissionRingRef ring) {
+    uint32_t position = ring->head;
+    YRSubmissionRingSlot *slot = &ring->slots[position & ring->mask];
+
+    __atomic_store_n(&ring->head, position + 1, __ATOMIC_SEQ_CST);
+    // Slot becomes free for position one lap ahead.
+    __atomic_store_n(&slot->sequence, position + ring->mask + 1, __ATOMIC_RELEASE);
+}
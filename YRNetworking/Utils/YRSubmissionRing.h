@@ -0,0 +1,81 @@
+//
+// YRSubmissionRing.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef __YRSubmissionRing__
+#define __YRSubmissionRing__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma mark - Declarations
+
+/**
+ *  Bounded lock-free multi-producer single-consumer ring of (element, length) pairs.
+ *  Any thread may push, only one thread (the owner) may peek and pop.
+ *  Push costs a compare-and-swap and a couple of atomic loads/stores: no locks, no syscalls.
+ *  Ring doesn't own elements pushed by reference. Ring created with element size owns storage for every slot,
+ *  so payloads are copied in and out without any allocation.
+ */
+typedef struct YRSubmissionRing *YRSubmissionRingRef;
+
+#pragma mark - Lifecycle
+
+/**
+ *  Capacity is rounded up to power of two, at least 2.
+ */
+YRSubmissionRingRef YRSubmissionRingCreate(uint32_t capacity);
+/**
+ *  Preallocates elementSize bytes for every slot, such ring is filled with YRSubmissionRingPushCopy.
+ */
+YRSubmissionRingRef YRSubmissionRingCreateWithElementSize(uint32_t capacity, uint32_t elementSize);
+void YRSubmissionRingDestroy(YRSubmissionRingRef ring);
+
+#pragma mark - Producers
+
+/**
+ *  Returns false if ring is full. outWasEmpty (optional) is set to true if consumer may have found ring empty
+ *  and went idle, so producer should wake it up by whatever means consumer waits with.
+ *  Only for rings created without element size.
+ */
+bool YRSubmissionRingPush(YRSubmissionRingRef ring, void *element, uint32_t length, bool *outWasEmpty);
+/**
+ *  Copies bytes into slot's own storage. Returns false if ring is full or length exceeds its element size.
+ */
+bool YRSubmissionRingPushCopy(YRSubmissionRingRef ring, const void *bytes, uint32_t length, bool *outWasEmpty);
+
+#pragma mark - Consumer
+
+/**
+ *  Returns oldest element without removing it, false if there's nothing published yet.
+ *  Copied element points into slot's storage which stays valid till pop.
+ */
+bool YRSubmissionRingPeek(YRSubmissionRingRef ring, void **outElement, uint32_t *outLength);
+/**
+ *  Removes element returned by the latest successful peek.
+ */
+void YRSubmissionRingPop(YRSubmissionRingRef ring);
+
+#endif
@@ -0,0 +1,352 @@
+//
+// YRTimerWheel.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "YRTimerWheel.h"
+
+#include <stdlib.h>
+
+#define kYRTimerWheelLevels 4
+#define kYRTimerWheelSlotBits 6
+#define kYRTimerWheelSlots (1 << kYRTimerWheelSlotBits)
+#define kYRTimerWheelSlotMask (kYRTimerWheelSlots - 1)
+// Farthest tick timer can be placed at. Timers scheduled further are parked there and re-inserted on expiry.
+#define kYRTimerWheelMaxDelta ((1ULL << (kYRTimerWheelLevels * kYRTimerWheelSlotBits)) - 1)
+
+#pragma mark - Declarations
+
+typedef struct YRTimerWheel {
+    uint64_t startTime;
+    uint64_t time;
+    // Next tick to be processed, every timer that expires before it has already fired.
+    uint64_t currentTick;
+    uint32_t resolution;
+    uint32_t timersCount;
+
+    // Sentinels of circular doubly linked lists, only next/prev are used.
+    YRTimer slots[kYRTimerWheelLevels][kYRTimerWheelSlots];
+} YRTimerWheel;
+
+#pragma mark - Prototypes
+
+static inline void YRTimerListInit(YRTimerRef head);
+static inline bool YRTimerListIsEmpty(YRTimerRef head);
+static inline void YRTimerListAppend(YRTimerRef head, YRTimerRef timer);
+static inline void YRTimerListMove(YRTimerRef from, YRTimerRef to);
+static inline void YRTimerUnlink(YRTimerRef timer);
+
+static void YRTimerWheelInsert(YRTimerWheelRef wheel, YRTimerRef timer);
+static void YRTimerWheelCascade(YRTimerWheelRef wheel, int level, uint32_t index);
+static void YRTimerWheelProcessTick(YRTimerWheelRef wheel);
+static uint64_t YRTimerWheelGetNearestEventTick(YRTimerWheelRef wheel);
+static inline uint64_t YRTimerWheelTickForTime(YRTimerWheelRef wheel, uint64_t time);
+
+#pragma mark - Timers
+
+void YRTimerInit(YRTimerRef timer, YRTimerCallback callback, void *context) {
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expiration = 0;
+    timer->callback = callback;
+    timer->context = context;
+}
+
+bool YRTimerIsScheduled(YRTimerRef timer) {
+    return timer->next != NULL;
+}
+
+#pragma mark - Lifecycle
+
+YRTimerWheelRef YRTimerWheelCreate(uint32_t resolution, uint64_t now) {
+    YRTimerWheelRef wheel = calloc(1, sizeof(YRTimerWheel));
+
+    if (!wheel) {
+        return NULL;
+    }
+
+    wheel->startTime = now;
+    wheel->time = now;
+    wheel->resolution = resolution > 0 ? resolution : 1;
+    wheel->currentTick = 1;
+
+    for (int level = 0; level < kYRTimerWheelLevels; level++) {
+        for (int slot = 0; slot < kYRTimerWheelSlots; slot++) {
+            YRTimerListInit(&wheel->slots[level][slot]);
+        }
+    }
+
+    return wheel;
+}
+
+void YRTimerWheelDestroy(YRTimerWheelRef wheel) {
+    if (!wheel) {
+        return;
+    }
+
+    // Leave timers in consistent (not scheduled) state as they outlive wheel.
+    for (int level = 0; level < kYRTimerWheelLevels; level++) {
+        for (int slot = 0; slot < kYRTimerWheelSlots; slot++) {
+            YRTimerRef head = &wheel->slots[level][slot];
+
+            while (!YRTimerListIsEmpty(head)) {
+                YRTimerUnlink(head->next);
+            }
+        }
+    }
+
+    free(wheel);
+}
+
+#pragma mark - Scheduling
+
+void YRTimerWheelSchedule(YRTimerWheelRef wheel, YRTimerRef timer, uint32_t timeout) {
+    if (YRTimerIsScheduled(timer)) {
+        YRTimerUnlink(timer);
+        wheel->timersCount--;
+    }
+
+    uint64_t ticks = (timeout + wheel->resolution - 1) / wheel->resolution;
+
+    if (ticks == 0) {
+        ticks = 1;
+    }
+
+    // Counted from wheel time rather than currentTick, which lags behind while expired ticks are processed.
+    // Zero timeout lands into the next tick, so callbacks rescheduling themselves never spin.
+    timer->expiration = YRTimerWheelTickForTime(wheel, wheel->time) + ticks;
+
+    YRTimerWheelInsert(wheel, timer);
+    wheel->timersCount++;
+}
+
+void YRTimerWheelCancel(YRTimerWheelRef wheel, YRTimerRef timer) {
+    if (YRTimerIsScheduled(timer)) {
+        YRTimerUnlink(timer);
+        wheel->timersCount--;
+    }
+}
+
+#pragma mark - Processing
+
+void YRTimerWheelAdvance(YRTimerWheelRef wheel, uint64_t now) {
+    if (now < wheel->time) {
+        // Time never goes back.
+        return;
+    }
+
+    wheel->time = now;
+
+    uint64_t targetTick = YRTimerWheelTickForTime(wheel, now);
+
+    while (wheel->currentTick <= targetTick) {
+        if (wheel->timersCount == 0) {
+            // Nothing to cascade or fire, skip idle ticks at once.
+            wheel->currentTick = targetTick + 1;
+            break;
+        }
+
+        if (YRTimerListIsEmpty(&wheel->slots[0][wheel->currentTick & kYRTimerWheelSlotMask])) {
+            // Skip ticks that neither fire nor cascade anything.
+            uint64_t nearestTick = YRTimerWheelGetNearestEventTick(wheel);
+
+            if (nearestTick > targetTick) {
+                wheel->currentTick = targetTick + 1;
+                break;
+            }
+
+            wheel->currentTick = nearestTick;
+        }
+
+        YRTimerWheelProcessTick(wheel);
+    }
+}
+
+int32_t YRTimerWheelGetTimeout(YRTimerWheelRef wheel, uint64_t now) {
+    if (wheel->timersCount == 0) {
+        return -1;
+    }
+
+    uint64_t nearestTime = wheel->startTime + YRTimerWheelGetNearestEventTick(wheel) * wheel->resolution;
+
+    if (nearestTime <= now) {
+        return 0;
+    }
+
+    return nearestTime - now > INT32_MAX ? INT32_MAX : (int32_t)(nearestTime - now);
+}
+
+uint64_t YRTimerWheelGetTime(YRTimerWheelRef wheel) {
+    return wheel->time;
+}
+
+uint32_t YRTimerWheelGetTimersCount(YRTimerWheelRef wheel) {
+    return wheel->timersCount;
+}
+
+#pragma mark - Private
+
+void YRTimerListInit(YRTimerRef head) {
+    head->next = head;
+    head->prev = head;
+}
+
+bool YRTimerListIsEmpty(YRTimerRef head) {
+    return head->next == head;
+}
+
+void YRTimerListAppend(YRTimerRef head, YRTimerRef timer) {
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+void YRTimerListMove(YRTimerRef from, YRTimerRef to) {
+    if (YRTimerListIsEmpty(from)) {
+        YRTimerListInit(to);
+        return;
+    }
+
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+
+    YRTimerListInit(from);
+}
+
+void YRTimerUnlink(YRTimerRef timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+void YRTimerWheelInsert(YRTimerWheelRef wheel, YRTimerRef timer) {
+    uint64_t slotTick = timer->expiration > wheel->currentTick ? timer->expiration : wheel->currentTick;
+    uint64_t delta = slotTick - wheel->currentTick;
+
+    if (delta > kYRTimerWheelMaxDelta) {
+        delta = kYRTimerWheelMaxDelta;
+        slotTick = wheel->currentTick + delta;
+    }
+
+    int level = 0;
+
+    while (level < kYRTimerWheelLevels - 1 && delta >= (1ULL << ((level + 1) * kYRTimerWheelSlotBits))) {
+        level++;
+    }
+
+    uint32_t index = (slotTick >> (level * kYRTimerWheelSlotBits)) & kYRTimerWheelSlotMask;
+
+    YRTimerListAppend(&wheel->slots[level][index], timer);
+}
+
+void YRTimerWheelCascade(YRTimerWheelRef wheel, int level, uint32_t index) {
+    YRTimer list;
+
+    YRTimerListMove(&wheel->slots[level][index], &list);
+
+    while (!YRTimerListIsEmpty(&list)) {
+        YRTimerRef timer = list.next;
+
+        YRTimerUnlink(timer);
+        YRTimerWheelInsert(wheel, timer);
+    }
+}
+
+void YRTimerWheelProcessTick(YRTimerWheelRef wheel) {
+    uint64_t tick = wheel->currentTick;
+
+    // Entering new block of upper level: move its timers down, highest level first.
+    int cascadeLevel = 0;
+
+    while (cascadeLevel < kYRTimerWheelLevels - 1 &&
+           (tick & ((1ULL << ((cascadeLevel + 1) * kYRTimerWheelSlotBits)) - 1)) == 0) {
+        cascadeLevel++;
+    }
+
+    for (int level = cascadeLevel; level > 0; level--) {
+        YRTimerWheelCascade(wheel, level, (tick >> (level * kYRTimerWheelSlotBits)) & kYRTimerWheelSlotMask);
+    }
+
+    YRTimer expired;
+
+    YRTimerListMove(&wheel->slots[0][tick & kYRTimerWheelSlotMask], &expired);
+
+    // Advance before firing, so timers rescheduled from callbacks never land into tick being processed.
+    wheel->currentTick = tick + 1;
+
+    // Timers are popped one by one as callbacks may cancel other expired timers.
+    while (!YRTimerListIsEmpty(&expired)) {
+        YRTimerRef timer = expired.next;
+
+        YRTimerUnlink(timer);
+
+        if (timer->expiration > tick) {
+            // Was parked at the farthest slot, not due yet.
+            YRTimerWheelInsert(wheel, timer);
+            continue;
+        }
+
+        wheel->timersCount--;
+
+        timer->callback(wheel, timer, timer->context);
+    }
+}
+
+uint64_t YRTimerWheelGetNearestEventTick(YRTimerWheelRef wheel) {
+    uint64_t nearestTick = UINT64_MAX;
+
+    // Level 0 holds exact expirations for the next kYRTimerWheelSlots ticks.
+    for (uint64_t i = 0; i < kYRTimerWheelSlots; i++) {
+        if (!YRTimerListIsEmpty(&wheel->slots[0][(wheel->currentTick + i) & kYRTimerWheelSlotMask])) {
+            nearestTick = wheel->currentTick + i;
+            break;
+        }
+    }
+
+    // Upper levels only tell when their slot is cascaded, which is a safe lower bound.
+    for (int level = 1; level < kYRTimerWheelLevels; level++) {
+        int shift = level * kYRTimerWheelSlotBits;
+        uint64_t block = wheel->currentTick >> shift;
+        // Current block is cascaded already unless current tick starts it, then its slot holds the next round.
+        uint64_t first = (wheel->currentTick & ((1ULL << shift) - 1)) ? 1 : 0;
+
+        for (uint64_t i = first; i < first + kYRTimerWheelSlots; i++) {
+            if (!YRTimerListIsEmpty(&wheel->slots[level][(block + i) & kYRTimerWheelSlotMask])) {
+                uint64_t cascadeTick = (block + i) << shift;
+
+                nearestTick = cascadeTick < nearestTick ? cascadeTick : nearestTick;
+                break;
+            }
+        }
+    }
+
+    return nearestTick;
+}
+
+uint64_t YRTimerWheelTickForTime(YRTimerWheelRef wheel, uint64_t time) {
+    return (time - wheel->startTime) / wheel->resolution;
+}
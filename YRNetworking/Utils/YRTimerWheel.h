@@ -0,0 +1,101 @@
+//
+// YRTimerWheel.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __YRTimerWheel__
+#define __YRTimerWheel__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma mark - Declarations
+
+/**
+ *  Hierarchical timer wheel (4 levels of 64 slots) with O(1) schedule, cancel and per-tick processing.
+ *  Wheel doesn't read any clock: its owner advances it with current time in milliseconds,
+ *  so one wheel can drive timers of any number of sessions running on the same thread.
+ *  Timers fire with one tick precision.
+ */
+typedef struct YRTimerWheel *YRTimerWheelRef;
+typedef struct YRTimer *YRTimerRef;
+
+typedef void (*YRTimerCallback) (YRTimerWheelRef wheel, YRTimerRef timer, void *context);
+
+/**
+ *  Timers are intrusive: they are embedded into their owners, so scheduling never allocates.
+ *  Fields are private, use YRTimerInit and wheel functions only.
+ */
+typedef struct YRTimer {
+    YRTimerRef next;
+    YRTimerRef prev;
+    uint64_t expiration;
+    YRTimerCallback callback;
+    void *context;
+} YRTimer;
+
+#pragma mark - Timers
+
+void YRTimerInit(YRTimerRef timer, YRTimerCallback callback, void *context);
+bool YRTimerIsScheduled(YRTimerRef timer);
+
+#pragma mark - Lifecycle
+
+/**
+ *  Creates wheel with given tick length (0 means 1 ms), now is current time in milliseconds.
+ */
+YRTimerWheelRef YRTimerWheelCreate(uint32_t resolution, uint64_t now);
+/**
+ *  Pending timers are detached, not fired.
+ */
+void YRTimerWheelDestroy(YRTimerWheelRef wheel);
+
+#pragma mark - Scheduling
+
+/**
+ *  Schedules timer to fire after timeout milliseconds. Reschedules timer if it's already pending.
+ */
+void YRTimerWheelSchedule(YRTimerWheelRef wheel, YRTimerRef timer, uint32_t timeout);
+void YRTimerWheelCancel(YRTimerWheelRef wheel, YRTimerRef timer);
+
+#pragma mark - Processing
+
+/**
+ *  Fires every timer that expired by now. Callbacks may schedule and cancel any timers.
+ */
+void YRTimerWheelAdvance(YRTimerWheelRef wheel, uint64_t now);
+
+/**
+ *  Returns milliseconds till wheel should be advanced next time, -1 if there are no pending timers.
+ *  Never later than the nearest expiration, but may be earlier when wheel has to cascade far timers.
+ *  Suitable as poll/epoll timeout.
+ */
+int32_t YRTimerWheelGetTimeout(YRTimerWheelRef wheel, uint64_t now);
+
+/**
+ *  Time passed to the latest YRTimerWheelAdvance call (or creation).
+ */
+uint64_t YRTimerWheelGetTime(YRTimerWheelRef wheel);
+uint32_t YRTimerWheelGetTimersCount(YRTimerWheelRef wheel);
+
+#endif
@@ -0,0 +1,216 @@
+//
+// YRCRC32C.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include "YRCRC32C.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define YR_CRC32C_HAS_X86 1
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define YR_CRC32C_HAS_ARMV8 1
+#endif
+
+static const uint32_t kYRCRC32CPolynomial = 0x82F63B78;
+
+#pragma mark - Prototypes
+
+static uint32_t YRCRC32CUpdateSoftware(uint32_t crc, const void *data, size_t length);
+#if YR_CRC32C_HAS_X86
+static uint32_t YRCRC32CUpdateSSE42(uint32_t crc, const void *data, size_t length);
+#endif
+#if YR_CRC32C_HAS_ARMV8
+static uint32_t YRCRC32CUpdateARMv8(uint32_t crc, const void *data, size_t length);
+#endif
+
+static void YRCRC32CBuildTables(void);
+
+#pragma mark - Dispatch
+
+// Slicing-by-8: table k advances crc of a byte followed by k zero bytes.
+static uint32_t gYRCRC32CTables[8][256];
+
+static YRCRC32CKernelType gYRCRC32CSelectedKernelType = kYRCRC32CKernelSoftware;
+static YRCRC32CKernel gYRCRC32CSelectedKernel = YRCRC32CUpdateSoftware;
+
+__attribute__((constructor))
+static void YRCRC32CSelectKernel(void) {
+    YRCRC32CBuildTables();
+
+    for (int type = kYRCRC32CKernelsCount - 1; type >= 0; type--) {
+        YRCRC32CKernel kernel = YRCRC32CGetKernel(type);
+
+        if (kernel) {
+            gYRCRC32CSelectedKernelType = type;
+            gYRCRC32CSelectedKernel = kernel;
+            break;
+        }
+    }
+}
+
+#pragma mark - CRC32C
+
+uint32_t YRCRC32CUpdate(uint32_t crc, const void *data, size_t length) {
+    return gYRCRC32CSelectedKernel(crc, data, length);
+}
+
+#pragma mark - Kernels
+
+YRCRC32CKernel YRCRC32CGetKernel(YRCRC32CKernelType type) {
+    switch (type) {
+        case kYRCRC32CKernelSoftware:
+            return YRCRC32CUpdateSoftware;
+#if YR_CRC32C_HAS_X86
+        case kYRCRC32CKernelSSE42:
+            return __builtin_cpu_supports("sse4.2") ? YRCRC32CUpdateSSE42 : NULL;
+#endif
+#if YR_CRC32C_HAS_ARMV8
+        case kYRCRC32CKernelARMv8:
+            // Compiler targets CPU with CRC extension, so it's always there.
+            return YRCRC32CUpdateARMv8;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+YRCRC32CKernelType YRCRC32CGetSelectedKernelType(void) {
+    return gYRCRC32CSelectedKernelType;
+}
+
+uint32_t YRCRC32CUpdateSoftware(uint32_t crc, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+
+    crc = ~crc;
+
+    for (; length >= sizeof(uint64_t); bytes += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+        // Reflected CRC consumes bytes in little-endian order.
+        uint32_t low = crc ^ ((uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24);
+
+        crc = gYRCRC32CTables[7][low & 0xFF] ^
+              gYRCRC32CTables[6][(low >> 8) & 0xFF] ^
+              gYRCRC32CTables[5][(low >> 16) & 0xFF] ^
+              gYRCRC32CTables[4][low >> 24] ^
+              gYRCRC32CTables[3][bytes[4]] ^
+              gYRCRC32CTables[2][bytes[5]] ^
+              gYRCRC32CTables[1][bytes[6]] ^
+              gYRCRC32CTables[0][bytes[7]];
+    }
+
+    for (; length > 0; bytes++, length--) {
+        crc = gYRCRC32CTables[0][(crc ^ *bytes) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+#if YR_CRC32C_HAS_X86
+
+__attribute__((target("sse4.2")))
+uint32_t YRCRC32CUpdateSSE42(uint32_t crc, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+
+    crc = ~crc;
+
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+
+    for (; length >= sizeof(uint64_t); bytes += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+        uint64_t word;
+
+        memcpy(&word, bytes, sizeof(word));
+
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+
+    crc = (uint32_t)crc64;
+#endif
+
+    for (; length >= sizeof(uint32_t); bytes += sizeof(uint32_t), length -= sizeof(uint32_t)) {
+        uint32_t word;
+
+        memcpy(&word, bytes, sizeof(word));
+
+        crc = _mm_crc32_u32(crc, word);
+    }
+
+    for (; length > 0; bytes++, length--) {
+        crc = _mm_crc32_u8(crc, *bytes);
+    }
+
+    return ~crc;
+}
+
+#endif
+
+#if YR_CRC32C_HAS_ARMV8
+
+uint32_t YRCRC32CUpdateARMv8(uint32_t crc, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+
+    crc = ~crc;
+
+    for (; length >= sizeof(uint64_t); bytes += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+        uint64_t word;
+
+        memcpy(&word, bytes, sizeof(word));
+
+        crc = __crc32cd(crc, word);
+    }
+
+    for (; length > 0; bytes++, length--) {
+        crc = __crc32cb(crc, *bytes);
+    }
+
+    return ~crc;
+}
+
+#endif
+
+#pragma mark - Private
+
+void YRCRC32CBuildTables(void) {
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        uint32_t crc = byte;
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (kYRCRC32CPolynomial & (0 - (crc & 1)));
+        }
+
+        gYRCRC32CTables[0][byte] = crc;
+    }
+
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        for (int table = 1; table < 8; table++) {
+            uint32_t previous = gYRCRC32CTables[table - 1][byte];
+
+            gYRCRC32CTables[table][byte] = gYRCRC32CTables[0][previous & 0xFF] ^ (previous >> 8);
+        }
+    }
+}
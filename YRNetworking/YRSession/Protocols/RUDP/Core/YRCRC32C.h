@@ -0,0 +1,65 @@
+//
+// YRCRC32C.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#ifndef __YRCRC32C__
+#define __YRCRC32C__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma mark - Declarations
+
+/**
+ *  CRC-32C (Castagnoli, reflected polynomial 0x82F63B78). Detects all burst errors up to 32 bits,
+ *  unlike ones' complement sum. Pass 0 as initial crc, result of one call may be passed as crc to the next
+ *  one to continue with subsequent data.
+ */
+typedef uint32_t (*YRCRC32CKernel) (uint32_t crc, const void *data, size_t length);
+
+typedef enum {
+    kYRCRC32CKernelSoftware,
+    kYRCRC32CKernelSSE42,
+    kYRCRC32CKernelARMv8,
+    kYRCRC32CKernelsCount
+} YRCRC32CKernelType;
+
+#pragma mark - CRC32C
+
+/**
+ *  Uses hardware CRC instructions if CPU has them, slicing-by-8 tables otherwise. Kernel is selected once at startup.
+ */
+uint32_t YRCRC32CUpdate(uint32_t crc, const void *data, size_t length);
+
+#pragma mark - Kernels
+
+/**
+ *  Returns NULL if kernel isn't supported by CPU or compiler. Software kernel is always available.
+ */
+YRCRC32CKernel YRCRC32CGetKernel(YRCRC32CKernelType type);
+YRCRC32CKernelType YRCRC32CGetSelectedKernelType(void);
+
+#endif
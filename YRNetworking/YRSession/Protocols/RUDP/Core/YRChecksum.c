@@ -0,0 +1,234 @@
+//
+// YRChecksum.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "YRChecksum.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define YR_CHECKSUM_HAS_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YR_CHECKSUM_HAS_NEON 1
+#endif
+
+// Vector kernels keep 64-bit lanes without folding, every lane takes at most length / 8 words.
+// That can't overflow for lengths below 2^35 bytes, far above any datagram.
+
+#pragma mark - Prototypes
+
+static uint32_t YRChecksumAddScalar(uint32_t sum, const void *data, size_t length);
+#if YR_CHECKSUM_HAS_X86
+static uint32_t YRChecksumAddSSE2(uint32_t sum, const void *data, size_t length);
+static uint32_t YRChecksumAddAVX2(uint32_t sum, const void *data, size_t length);
+#endif
+#if YR_CHECKSUM_HAS_NEON
+static uint32_t YRChecksumAddNEON(uint32_t sum, const void *data, size_t length);
+#endif
+
+static inline uint64_t YRChecksumAdd64(uint64_t sum, uint64_t value);
+static inline uint32_t YRChecksumFold(uint64_t sum);
+static inline uint64_t YRChecksumAddWords(uint64_t sum, const uint8_t *bytes, size_t length);
+
+#pragma mark - Dispatch
+
+static YRChecksumKernelType gYRChecksumSelectedKernelType = kYRChecksumKernelScalar;
+static YRChecksumKernel gYRChecksumSelectedKernel = YRChecksumAddScalar;
+
+__attribute__((constructor))
+static void YRChecksumSelectKernel(void) {
+    for (int type = kYRChecksumKernelsCount - 1; type >= 0; type--) {
+        YRChecksumKernel kernel = YRChecksumGetKernel(type);
+
+        if (kernel) {
+            gYRChecksumSelectedKernelType = type;
+            gYRChecksumSelectedKernel = kernel;
+            break;
+        }
+    }
+}
+
+#pragma mark - Checksum
+
+uint32_t YRChecksumAdd(uint32_t sum, const void *data, size_t length) {
+    return gYRChecksumSelectedKernel(sum, data, length);
+}
+
+uint32_t YRChecksumUpdate(uint32_t checksum, uint32_t oldWord, uint32_t newWord) {
+    // HC' = ~(~HC + ~m + m')
+    uint64_t sum = (uint64_t)(uint32_t)~checksum + (uint32_t)~oldWord + newWord;
+
+    return ~YRChecksumFold(sum);
+}
+
+#pragma mark - Kernels
+
+YRChecksumKernel YRChecksumGetKernel(YRChecksumKernelType type) {
+    switch (type) {
+        case kYRChecksumKernelScalar:
+            return YRChecksumAddScalar;
+#if YR_CHECKSUM_HAS_X86
+        case kYRChecksumKernelSSE2:
+            return __builtin_cpu_supports("sse2") ? YRChecksumAddSSE2 : NULL;
+        case kYRChecksumKernelAVX2:
+            return __builtin_cpu_supports("avx2") ? YRChecksumAddAVX2 : NULL;
+#endif
+#if YR_CHECKSUM_HAS_NEON
+        case kYRChecksumKernelNEON:
+            return YRChecksumAddNEON;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+YRChecksumKernelType YRChecksumGetSelectedKernelType(void) {
+    return gYRChecksumSelectedKernelType;
+}
+
+uint32_t YRChecksumAddScalar(uint32_t sum, const void *data, size_t length) {
+    return YRChecksumFold(YRChecksumAddWords(sum, data, length));
+}
+
+#if YR_CHECKSUM_HAS_X86
+
+__attribute__((target("sse2")))
+uint32_t YRChecksumAddSSE2(uint32_t sum, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i accumulator = _mm_setzero_si128();
+
+    for (; length >= sizeof(__m128i); bytes += sizeof(__m128i), length -= sizeof(__m128i)) {
+        __m128i words = _mm_loadu_si128((const __m128i *)bytes);
+
+        // Widen 32-bit words to 64-bit lanes, carries stay in upper halves.
+        accumulator = _mm_add_epi64(accumulator, _mm_unpacklo_epi32(words, zero));
+        accumulator = _mm_add_epi64(accumulator, _mm_unpackhi_epi32(words, zero));
+    }
+
+    uint64_t lanes[2];
+
+    _mm_storeu_si128((__m128i *)lanes, accumulator);
+
+    uint64_t result = YRChecksumAdd64(YRChecksumAdd64(sum, lanes[0]), lanes[1]);
+
+    return YRChecksumFold(YRChecksumAddWords(result, bytes, length));
+}
+
+__attribute__((target("avx2")))
+uint32_t YRChecksumAddAVX2(uint32_t sum, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i first = _mm256_setzero_si256();
+    __m256i second = _mm256_setzero_si256();
+
+    // Two independent accumulators hide latency of additions.
+    for (; length >= 2 * sizeof(__m256i); bytes += 2 * sizeof(__m256i), length -= 2 * sizeof(__m256i)) {
+        __m256i firstWords = _mm256_loadu_si256((const __m256i *)bytes);
+        __m256i secondWords = _mm256_loadu_si256((const __m256i *)(bytes + sizeof(__m256i)));
+
+        first = _mm256_add_epi64(first, _mm256_unpacklo_epi32(firstWords, zero));
+        first = _mm256_add_epi64(first, _mm256_unpackhi_epi32(firstWords, zero));
+        second = _mm256_add_epi64(second, _mm256_unpacklo_epi32(secondWords, zero));
+        second = _mm256_add_epi64(second, _mm256_unpackhi_epi32(secondWords, zero));
+    }
+
+    uint64_t lanes[8];
+
+    _mm256_storeu_si256((__m256i *)lanes, first);
+    _mm256_storeu_si256((__m256i *)(lanes + 4), second);
+
+    uint64_t result = sum;
+
+    for (int i = 0; i < 8; i++) {
+        result = YRChecksumAdd64(result, lanes[i]);
+    }
+
+    // Less than 64 bytes left.
+    return YRChecksumFold(YRChecksumAddWords(result, bytes, length));
+}
+
+#endif
+
+#if YR_CHECKSUM_HAS_NEON
+
+uint32_t YRChecksumAddNEON(uint32_t sum, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    uint64x2_t first = vdupq_n_u64(0);
+    uint64x2_t second = vdupq_n_u64(0);
+
+    for (; length >= 32; bytes += 32, length -= 32) {
+        // Pairwise add of 32-bit words into 64-bit lanes.
+        first = vpadalq_u32(first, vreinterpretq_u32_u8(vld1q_u8(bytes)));
+        second = vpadalq_u32(second, vreinterpretq_u32_u8(vld1q_u8(bytes + 16)));
+    }
+
+    uint64_t result = sum;
+
+    result = YRChecksumAdd64(result, vgetq_lane_u64(first, 0));
+    result = YRChecksumAdd64(result, vgetq_lane_u64(first, 1));
+    result = YRChecksumAdd64(result, vgetq_lane_u64(second, 0));
+    result = YRChecksumAdd64(result, vgetq_lane_u64(second, 1));
+
+    return YRChecksumFold(YRChecksumAddWords(result, bytes, length));
+}
+
+#endif
+
+#pragma mark - Private
+
+uint64_t YRChecksumAdd64(uint64_t sum, uint64_t value) {
+    sum += value;
+
+    // End-around carry.
+    return sum + (sum < value);
+}
+
+uint32_t YRChecksumFold(uint64_t sum) {
+    sum = (sum & UINT32_MAX) + (sum >> 32);
+    sum = (sum & UINT32_MAX) + (sum >> 32);
+
+    return (uint32_t)sum;
+}
+
+uint64_t YRChecksumAddWords(uint64_t sum, const uint8_t *bytes, size_t length) {
+    // 2^64 is 1 modulo 2^32 - 1, so 64-bit ones' complement sum folds into the same 32-bit one.
+    for (; length >= sizeof(uint64_t); bytes += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+        uint64_t word;
+
+        memcpy(&word, bytes, sizeof(word));
+
+        sum = YRChecksumAdd64(sum, word);
+    }
+
+    // Pad last bytes with zeroes up to whole 32-bit words.
+    uint64_t word = 0;
+
+    memcpy(&word, bytes, length);
+
+    return YRChecksumAdd64(sum, word);
+}
@@ -0,0 +1,72 @@
+//
+// YRChecksum.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef __YRChecksum__
+#define __YRChecksum__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma mark - Declarations
+
+/**
+ *  Adds data to 32-bit ones' complement sum. Data is read as native-endian 32-bit words of any alignment,
+ *  last partial word is zero padded. Sum of several parts equals sum of their concatenation
+ *  as long as every part but the last one is multiple of 4 bytes. Result is not inverted.
+ */
+typedef uint32_t (*YRChecksumKernel) (uint32_t sum, const void *data, size_t length);
+
+typedef enum {
+    kYRChecksumKernelScalar,
+    kYRChecksumKernelSSE2,
+    kYRChecksumKernelAVX2,
+    kYRChecksumKernelNEON,
+    kYRChecksumKernelsCount
+} YRChecksumKernelType;
+
+#pragma mark - Checksum
+
+/**
+ *  Uses the fastest kernel supported by CPU, selected once at startup.
+ *  Every kernel gives bit-identical results.
+ */
+uint32_t YRChecksumAdd(uint32_t sum, const void *data, size_t length);
+
+/**
+ *  Returns inverted checksum after one summed 32-bit word changed from oldWord to newWord (RFC 1624, eqn. 3).
+ *  O(1) regardless of data length.
+ */
+uint32_t YRChecksumUpdate(uint32_t checksum, uint32_t oldWord, uint32_t newWord);
+
+#pragma mark - Kernels
+
+/**
+ *  Returns NULL if kernel isn't supported by CPU or compiler. Scalar kernel is always available.
+ */
+YRChecksumKernel YRChecksumGetKernel(YRChecksumKernelType type);
+YRChecksumKernelType YRChecksumGetSelectedKernelType(void);
+
+#endif
@@ -0,0 +1,205 @@
+//
+// YRCongestionControl.c
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "YRCongestionControl.h"
+
+#include <stddef.h>
+
+// RFC 6928 allows up to 10, stay conservative as peers are often on the same shared link.
+#define kYRCongestionControlInitialWindow 4
+#define kYRCongestionControlMinWindow 2
+// Delay based bounds for segments queued on the path.
+#define kYRCongestionControlDelayAlpha 2
+#define kYRCongestionControlDelayBeta 4
+
+#pragma mark - Prototypes
+
+static void YRCongestionControlSetWindow(YRCongestionControlRef control, uint32_t window);
+static void YRCongestionControlIncrease(YRCongestionControlRef control, uint32_t segmentsCount);
+static void YRCongestionControlReduceOnTimeout(YRCongestionControlRef control);
+static void YRCongestionControlUpdateMinRoundTripTime(YRCongestionControlRef control, int32_t roundTripTime);
+
+static void YRNewRenoOnAck(YRCongestionControlRef control, uint32_t segmentsCount, int32_t roundTripTime);
+static void YRNewRenoOnLoss(YRCongestionControlRef control);
+
+static void YRDelayBasedOnAck(YRCongestionControlRef control, uint32_t segmentsCount, int32_t roundTripTime);
+static void YRDelayBasedOnLoss(YRCongestionControlRef control);
+
+#pragma mark - Algorithms
+
+const YRCongestionControlAlgorithm kYRCongestionControlNewReno = {
+    YRNewRenoOnAck,
+    YRNewRenoOnLoss,
+    YRCongestionControlReduceOnTimeout
+};
+
+const YRCongestionControlAlgorithm kYRCongestionControlDelayBased = {
+    YRDelayBasedOnAck,
+    YRDelayBasedOnLoss,
+    YRCongestionControlReduceOnTimeout
+};
+
+#pragma mark - Lifecycle
+
+void YRCongestionControlInit(YRCongestionControlRef control, const YRCongestionControlAlgorithm *algorithm, uint32_t maxWindow) {
+    control->algorithm = algorithm;
+    control->maxWindow = maxWindow;
+    control->window = maxWindow;
+    control->slowStartThreshold = maxWindow;
+    control->acknowledgedCount = 0;
+    control->minRoundTripTime = -1;
+
+    if (algorithm) {
+        YRCongestionControlSetWindow(control, kYRCongestionControlInitialWindow);
+    }
+}
+
+#pragma mark - Events
+
+void YRCongestionControlOnAck(YRCongestionControlRef control, uint32_t segmentsCount, int32_t roundTripTime) {
+    if (control->algorithm && segmentsCount > 0) {
+        control->algorithm->onAck(control, segmentsCount, roundTripTime);
+    }
+}
+
+void YRCongestionControlOnLoss(YRCongestionControlRef control) {
+    if (control->algorithm) {
+        control->algorithm->onLoss(control);
+    }
+}
+
+void YRCongestionControlOnTimeout(YRCongestionControlRef control) {
+    if (control->algorithm) {
+        control->algorithm->onTimeout(control);
+    }
+}
+
+#pragma mark - State
+
+uint32_t YRCongestionControlGetWindow(YRCongestionControlRef control) {
+    return control->window;
+}
+
+#pragma mark - Private
+
+void YRCongestionControlSetWindow(YRCongestionControlRef control, uint32_t window) {
+    // Window never drops below 1 segment, otherwise session would stall.
+    uint32_t minWindow = control->maxWindow > 0 ? 1 : 0;
+
+    control->window = window < minWindow ? minWindow : (window > control->maxWindow ? control->maxWindow : window);
+}
+
+void YRCongestionControlIncrease(YRCongestionControlRef control, uint32_t segmentsCount) {
+    if (control->window < control->slowStartThreshold) {
+        // Slow start: window doubles every round trip.
+        YRCongestionControlSetWindow(control, control->window + segmentsCount);
+        return;
+    }
+
+    // Congestion avoidance: one segment per window of acknowledged segments.
+    control->acknowledgedCount += segmentsCount;
+
+    if (control->acknowledgedCount >= control->window) {
+        control->acknowledgedCount -= control->window;
+
+        YRCongestionControlSetWindow(control, control->window + 1);
+    }
+}
+
+void YRCongestionControlReduceOnTimeout(YRCongestionControlRef control) {
+    uint32_t threshold = control->window / 2;
+
+    control->slowStartThreshold = threshold > kYRCongestionControlMinWindow ? threshold : kYRCongestionControlMinWindow;
+    control->acknowledgedCount = 0;
+
+    // Whole window is considered lost, restart from slow start.
+    YRCongestionControlSetWindow(control, 1);
+}
+
+void YRCongestionControlUpdateMinRoundTripTime(YRCongestionControlRef control, int32_t roundTripTime) {
+    if (roundTripTime >= 0 && (control->minRoundTripTime < 0 || roundTripTime < control->minRoundTripTime)) {
+        control->minRoundTripTime = roundTripTime;
+    }
+}
+
+#pragma mark - NewReno
+
+void YRNewRenoOnAck(YRCongestionControlRef control, uint32_t segmentsCount, int32_t roundTripTime) {
+    // Window growth is loss driven, RTT only keeps minRoundTripTime up to date for the session.
+    YRCongestionControlUpdateMinRoundTripTime(control, roundTripTime);
+    YRCongestionControlIncrease(control, segmentsCount);
+}
+
+void YRNewRenoOnLoss(YRCongestionControlRef control) {
+    uint32_t threshold = control->window / 2;
+
+    control->slowStartThreshold = threshold > kYRCongestionControlMinWindow ? threshold : kYRCongestionControlMinWindow;
+    control->acknowledgedCount = 0;
+
+    YRCongestionControlSetWindow(control, control->slowStartThreshold);
+}
+
+#pragma mark - Delay Based
+
+void YRDelayBasedOnAck(YRCongestionControlRef control, uint32_t segmentsCount, int32_t roundTripTime) {
+    if (roundTripTime < 0) {
+        // Without sample (retransmitted segment) behave as loss based.
+        YRCongestionControlIncrease(control, segmentsCount);
+        return;
+    }
+
+    YRCongestionControlUpdateMinRoundTripTime(control, roundTripTime);
+
+    // Segments sitting in path queues: window * (RTT - minRTT) / RTT.
+    uint32_t queued = roundTripTime > 0 ?
+        (uint32_t)(((uint64_t)control->window * (uint32_t)(roundTripTime - control->minRoundTripTime)) / (uint32_t)roundTripTime) : 0;
+
+    if (queued < kYRCongestionControlDelayAlpha) {
+        YRCongestionControlIncrease(control, segmentsCount);
+    } else if (queued > kYRCongestionControlDelayBeta) {
+        // Queues are building up: leave slow start and shrink by one segment per window.
+        control->slowStartThreshold = control->window;
+        control->acknowledgedCount += segmentsCount;
+
+        if (control->acknowledgedCount >= control->window) {
+            control->acknowledgedCount = 0;
+
+            YRCongestionControlSetWindow(control, control->window > kYRCongestionControlMinWindow ? control->window - 1 : control->window);
+        }
+    } else if (control->window < control->slowStartThreshold) {
+        // Path is saturated, stay where we are.
+        control->slowStartThreshold = control->window;
+    }
+}
+
+void YRDelayBasedOnLoss(YRCongestionControlRef control) {
+    uint32_t threshold = control->window - control->window / 4;
+
+    control->slowStartThreshold = threshold > kYRCongestionControlMinWindow ? threshold : kYRCongestionControlMinWindow;
+    control->acknowledgedCount = 0;
+
+    YRCongestionControlSetWindow(control, control->slowStartThreshold);
+}
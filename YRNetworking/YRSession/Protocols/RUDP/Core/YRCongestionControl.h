@@ -0,0 +1,98 @@
+//
+// YRCongestionControl.h
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2019 Yuri R.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef __YRCongestionControl__
+#define __YRCongestionControl__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma mark - Declarations
+
+/**
+ *  Congestion window of RUDP session measured in segments.
+ *  Session never has more segments outstanding than both window and peer's advertised window allow.
+ *
+ *  Controller is embedded into session and driven by it: acknowledgements grow window,
+ *  loss detected through EACK (at most once per window of data) and retransmission timeouts shrink it.
+ *  Behaviour is defined by algorithm, custom ones can be plugged in by providing YRCongestionControlAlgorithm.
+ */
+typedef struct YRCongestionControl *YRCongestionControlRef;
+
+typedef struct {
+    /**
+     *  Called for acknowledged segments. Round trip time is in ms, -1 if ACK didn't provide sample.
+     */
+    void (*onAck) (YRCongestionControlRef control, uint32_t segmentsCount, int32_t roundTripTime);
+    void (*onLoss) (YRCongestionControlRef control);
+    void (*onTimeout) (YRCongestionControlRef control);
+} YRCongestionControlAlgorithm;
+
+/**
+ *  Fields are read-only for session and free to use by algorithm.
+ */
+typedef struct YRCongestionControl {
+    const YRCongestionControlAlgorithm *algorithm;
+    uint32_t window;
+    uint32_t slowStartThreshold;
+    uint32_t maxWindow;
+    // Segments acknowledged since window was changed last time.
+    uint32_t acknowledgedCount;
+    // Lowest round trip time observed, ms.
+    int32_t minRoundTripTime;
+    // Custom algorithms keep their state here.
+    void *context;
+} YRCongestionControl;
+
+/**
+ *  Loss based AIMD: slow start, additive increase by one segment per window, halves window on loss.
+ */
+extern const YRCongestionControlAlgorithm kYRCongestionControlNewReno;
+
+/**
+ *  Vegas-like: keeps 2..4 segments queued on the path judging by RTT growth over its minimum,
+ *  so window stops growing before buffers overflow. Backs off by a quarter on loss.
+ */
+extern const YRCongestionControlAlgorithm kYRCongestionControlDelayBased;
+
+#pragma mark - Lifecycle
+
+/**
+ *  NULL algorithm disables congestion control: window is always maxWindow.
+ */
+void YRCongestionControlInit(YRCongestionControlRef control, const YRCongestionControlAlgorithm *algorithm, uint32_t maxWindow);
+
+#pragma mark - Events
+
+void YRCongestionControlOnAck(YRCongestionControlRef control, uint32_t segmentsCount, int32_t roundTripTime);
+void YRCongestionControlOnLoss(YRCongestionControlRef control);
+void YRCongestionControlOnTimeout(YRCongestionControlRef control);
+
+#pragma mark - State
+
+uint32_t YRCongestionControlGetWindow(YRCongestionControlRef control);
+
+#endif
@@ -7,6 +7,8 @@
 //
 
 #include "YRPacket.h"
+#include "YRChecksum.h"
+#include "YRCRC32C.h"
 #include <stdlib.h>
 #include <string.h> // For memcpy
 
@@ -138,6 +140,9 @@ typedef struct YRPacket {
 static const uint8_t kYRAlignmentWithPayloadInBytes = 8;
 static const uint8_t kYRAlignmentWithoutPayloadInBytes = 4;
 
+// Checksum follows description, header length, seq# and ack# on wire.
+static const uint8_t kYRPacketSerializedChecksumOffset = 6;
+
 #pragma mark - Prototypes
 
 static inline YRPayloadLengthType YRPacketGenericLength(void);
@@ -151,10 +156,21 @@ static inline YRPacketRef YRPacketConstruct(void *whereAt,
                                             YRHeaderLengthType headerLength,
                                             void (^packetSpecificConstructor) (YRPacketRef packet, YRPacketHeaderRef header));
 
+static inline YRPacketRef YRPacketConstructWithPayload(YRSequenceNumberType seqNumber,
+                                                       YRSequenceNumberType ackNumber,
+                                                       const void *payload,
+                                                       YRPayloadLengthType payloadLength,
+                                                       bool copyPayload,
+                                                       bool checksumPayload,
+                                                       void *packetBuffer);
 void YRPacketFinalize(YRPacketRef packet);
 static inline YRChecksumType YRPacketCalculateChecksum(YRPacketRef packet);
+static inline bool YRPacketValidate(YRPacketRef packet, bool verifyChecksum);
+static inline YRChecksumType YRPacketSerializedCalculateCRC32C(const void *bytes, YRPayloadLengthType length);
 void *YRPacketGetPayloadPointer(YRPacketRef packet);
 void *YRPacketGetPayloadStart(YRPacketRef packet);
+static inline size_t YRPacketDeserializedLengthForHeaderLength(YRHeaderLengthType headerLength);
+static inline YRPayloadLengthType YRPacketPayloadSpaceForLength(YRPayloadLengthType payloadLength);
 
 #pragma mark - Data Structure Sizes
 
@@ -200,26 +216,44 @@ YRPayloadLengthType YRPacketEACKLengthWithPayload(YRSequenceNumberType *ioSequen
     YRHeaderLengthType headerLength = YRPacketHeaderEACKLength(ioSequencesCount);
 
     if (payloadLength > 0) {
-        return YRMakeMultipleTo(kYRPacketStructureLength + headerLength, kYRAlignmentWithPayloadInBytes) + payloadLength;
+        return YRMakeMultipleTo(kYRPacketStructureLength + headerLength, kYRAlignmentWithPayloadInBytes) + YRPacketPayloadSpaceForLength(payloadLength);
     } else {
         return YRMakeMultipleTo(kYRPacketStructureLength + headerLength, kYRAlignmentWithoutPayloadInBytes);
     }
 }
 
+YRPayloadLengthType YRPacketEACKRangesLength(YRSequenceNumberType *ioRangesCount) {
+    YRHeaderLengthType headerLength = YRPacketHeaderEACKRangesLength(ioRangesCount);
+    
+    return YRMakeMultipleTo(kYRPacketStructureLength + headerLength, kYRAlignmentWithoutPayloadInBytes);
+}
+
 YRPayloadLengthType YRPacketLengthForPayload(YRPayloadLengthType payloadLength) {
     if (payloadLength > 0) {
-        return YRMakeMultipleTo(YRPacketWithPayloadLength(), kYRAlignmentWithPayloadInBytes) + payloadLength;
+        return YRMakeMultipleTo(YRPacketWithPayloadLength(), kYRAlignmentWithPayloadInBytes) + YRPacketPayloadSpaceForLength(payloadLength);
     } else {
         return YRPacketWithPayloadAlignedLength();
     }
 }
 
+YRPayloadLengthType YRPacketPayloadSpaceForLength(YRPayloadLengthType payloadLength) {
+    // Referenced payload (see copyPayload) keeps pointer in place of payload bytes.
+    return payloadLength > sizeof(uintptr_t) ? payloadLength : sizeof(uintptr_t);
+}
+
 size_t YRPacketDataStructureLengthForPacketSize(YRPayloadLengthType packetSize) {
     size_t maximumBytesThatPacketCanTake = packetSize + kYRPacketStructureLength + (kYRAlignmentWithoutPayloadInBytes - 1);
     
     return YRMakeMultipleTo(maximumBytesThatPacketCanTake, kYRAlignmentWithPayloadInBytes);
 }
 
+YRPayloadLengthType YRPacketMaximumLength() {
+    // Inverse of YRPacketDataStructureLengthForPacketSize for the largest aligned length.
+    size_t maximumDataStructureLength = UINT16_MAX & ~(size_t)(kYRAlignmentWithPayloadInBytes - 1);
+    
+    return maximumDataStructureLength - kYRPacketStructureLength - (kYRAlignmentWithoutPayloadInBytes - 1);
+}
+
 #pragma mark - Factory Methods
 
 YRPacketRef YRPacketCreateSYN(YRConnectionConfiguration configuration,
@@ -274,6 +308,25 @@ YRPacketRef YRPacketCreateEACK(YRSequenceNumberType seqNumber,
     return YRPacketCreateEACKWithPayload(seqNumber, ackNumber, sequences, ioSequencesCount, NULL, 0, false, packetBuffer);
 }
 
+YRPacketRef YRPacketCreateEACKRanges(YRSequenceNumberType seqNumber,
+                                     YRSequenceNumberType ackNumber,
+                                     YRSequenceNumberType *ranges,
+                                     YRSequenceNumberType *ioRangesCount,
+                                     void *packetBuffer) {
+    YRSequenceNumberType rangesCount = ioRangesCount ? *ioRangesCount : 0;
+    
+    YRPacketHeaderEACKRangesLength(&rangesCount);
+    
+    // Count is even and fits, so it's taken as is.
+    YRSequenceNumberType sequencesCount = rangesCount * 2;
+    
+    if (ioRangesCount) {
+        *ioRangesCount = rangesCount;
+    }
+    
+    return YRPacketCreateEACK(seqNumber, ackNumber, ranges, &sequencesCount, packetBuffer);
+}
+
 YRPacketRef YRPacketCreateEACKWithPayload(YRSequenceNumberType seqNumber,
                                           YRSequenceNumberType ackNumber,
                                           YRSequenceNumberType *sequences,
@@ -316,6 +369,25 @@ YRPacketRef YRPacketCreateWithPayload(YRSequenceNumberType seqNumber,
                                       YRPayloadLengthType payloadLength,
                                       bool copyPayload,
                                       void *packetBuffer) {
+    return YRPacketConstructWithPayload(seqNumber, ackNumber, payload, payloadLength, copyPayload, true, packetBuffer);
+}
+
+YRPacketRef YRPacketCreateWithPayloadHeaderChecksumOnly(YRSequenceNumberType seqNumber,
+                                                        YRSequenceNumberType ackNumber,
+                                                        const void *payload,
+                                                        YRPayloadLengthType payloadLength,
+                                                        bool copyPayload,
+                                                        void *packetBuffer) {
+    return YRPacketConstructWithPayload(seqNumber, ackNumber, payload, payloadLength, copyPayload, false, packetBuffer);
+}
+
+YRPacketRef YRPacketConstructWithPayload(YRSequenceNumberType seqNumber,
+                                         YRSequenceNumberType ackNumber,
+                                         const void *payload,
+                                         YRPayloadLengthType payloadLength,
+                                         bool copyPayload,
+                                         bool checksumPayload,
+                                         void *packetBuffer) {
     size_t packetSize = YRPacketLengthForPayload(payloadLength);
 
     return YRPacketConstruct(packetBuffer, packetSize, seqNumber, ackNumber, true,
@@ -325,7 +397,9 @@ YRPacketRef YRPacketCreateWithPayload(YRSequenceNumberType seqNumber,
             YRPacketHeaderSetPayloadLength(payloadHeader, payloadLength);
 
             if (payloadLength > 0) {
-                YRPacketHeaderSetCHK(header);
+                if (checksumPayload) {
+                    YRPacketHeaderSetCHK(header);
+                }
                 
                 if (copyPayload) {
                     memcpy(YRPacketGetPayloadPointer(packet), payload, payloadLength);
@@ -390,7 +464,7 @@ YRPayloadLengthType YRPacketGetLength(YRPacketRef packet) {
     YRPacketHeaderRef header = YRPacketGetHeader(packet);
     
     YRHeaderLengthType headerLength = YRPacketHeaderGetHeaderLength(header);
-    YRHeaderLengthType payloadLength = 0;
+    YRPayloadLengthType payloadLength = 0;
     
     if (YRPacketHeaderHasPayloadLength(header)) {
         payloadLength = YRPacketHeaderGetPayloadLength((YRPacketPayloadHeaderRef)header);
@@ -404,6 +478,14 @@ YRPayloadLengthType YRPacketGetLength(YRPacketRef packet) {
 }
 
 bool YRPacketIsLogicallyValid(YRPacketRef packet) {
+    return YRPacketValidate(packet, true);
+}
+
+bool YRPacketIsLogicallyValidIgnoringChecksum(YRPacketRef packet) {
+    return YRPacketValidate(packet, false);
+}
+
+bool YRPacketValidate(YRPacketRef packet, bool verifyChecksum) {
     // TODO: Return error codes
     YRPacketHeaderRef header = YRPacketGetHeader(packet);
     
@@ -428,7 +510,7 @@ bool YRPacketIsLogicallyValid(YRPacketRef packet) {
         }
     }
     
-    if (YRPacketCalculateChecksum(packet) != 0) {
+    if (verifyChecksum && YRPacketCalculateChecksum(packet) != 0) {
         return false;
     }
 
@@ -532,10 +614,122 @@ void YRPacketSerialize(YRPacketRef packet, YRLightweightOutputStreamRef stream)
     }
 }
 
+YRPayloadLengthType YRPacketSerializeAt(YRPacketRef packet, void *buffer, YRPayloadLengthType bufferSize) {
+    YRPayloadLengthType packetLength = YRPacketGetLength(packet);
+    
+    if (packetLength > bufferSize) {
+        return 0;
+    }
+    
+    uint8_t outputStreamBuffer[kYRLightweightOutputStreamSize] __attribute__ ((__aligned__(sizeof(uintptr_t))));
+    
+    YRLightweightOutputStreamRef outputStream = YRLightweightOutputStreamCreateAt(buffer, packetLength, outputStreamBuffer);
+    
+    YRPacketSerialize(packet, outputStream);
+    
+    return packetLength;
+}
+
+bool YRPacketSerializedSetAckNumber(void *bytes, YRPayloadLengthType length, YRSequenceNumberType ackNumber) {
+    if (length < kYRPacketHeaderGenericLength) {
+        return false;
+    }
+    
+    uint8_t inputStreamBuffer[kYRLightweightInputStreamSize] __attribute__ ((__aligned__(sizeof(uintptr_t))));
+    YRLightweightInputStreamRef inputStream = YRLightweightInputStreamCreateAt(bytes, length, inputStreamBuffer);
+    
+    // Checksum covers in-memory header, so update is done on generic header restored from wire.
+    uint64_t headerBuffer[2] = {0};
+    YRPacketHeaderRef header = (YRPacketHeaderRef)headerBuffer;
+    
+    YRPacketHeaderSetPacketDescription(header, YRLightweightInputStreamReadInt8(inputStream));
+    YRPacketHeaderSetHeaderLength(header, YRLightweightInputStreamReadInt8(inputStream));
+    YRPacketHeaderSetSequenceNumber(header, YRLightweightInputStreamReadInt16(inputStream));
+    
+    if (!YRPacketHeaderHasACK(header)) {
+        return false;
+    }
+    
+    YRPacketHeaderSetAckNumber(header, YRLightweightInputStreamReadInt16(inputStream));
+    YRPacketHeaderSetChecksum(header, YRLightweightInputStreamReadInt32(inputStream));
+    
+    YRPacketHeaderUpdateAckNumber(header, ackNumber);
+    
+    // Ack number directly precedes checksum on wire.
+    uint8_t outputStreamBuffer[kYRLightweightOutputStreamSize] __attribute__ ((__aligned__(sizeof(uintptr_t))));
+    YRPayloadLengthType offset = kYRPacketSerializedChecksumOffset - sizeof(YRSequenceNumberType);
+    YRLightweightOutputStreamRef outputStream = YRLightweightOutputStreamCreateAt((uint8_t *)bytes + offset,
+                                                                                   sizeof(YRSequenceNumberType) + sizeof(YRChecksumType),
+                                                                                   outputStreamBuffer);
+    
+    YRLightweightOutputStreamWriteInt16(outputStream, YRPacketHeaderGetAckNumber(header));
+    YRLightweightOutputStreamWriteInt32(outputStream, YRPacketHeaderGetChecksum(header));
+    
+    return true;
+}
+
+YRPacketDescriptionType YRPacketSerializedGetPacketDescription(const void *bytes, YRPayloadLengthType length) {
+    if (length < kYRPacketHeaderGenericLength) {
+        return 0;
+    }
+    
+    uint8_t inputStreamBuffer[kYRLightweightInputStreamSize] __attribute__ ((__aligned__(sizeof(uintptr_t))));
+    YRLightweightInputStreamRef inputStream = YRLightweightInputStreamCreateAt(bytes, length, inputStreamBuffer);
+    
+    return YRLightweightInputStreamReadInt8(inputStream);
+}
+
+void YRPacketSerializedSetCRC32C(void *bytes, YRPayloadLengthType length) {
+    if (length < kYRPacketHeaderGenericLength) {
+        return;
+    }
+    
+    uint8_t outputStreamBuffer[kYRLightweightOutputStreamSize] __attribute__ ((__aligned__(sizeof(uintptr_t))));
+    YRLightweightOutputStreamRef outputStream = YRLightweightOutputStreamCreateAt((uint8_t *)bytes + kYRPacketSerializedChecksumOffset,
+                                                                                   sizeof(YRChecksumType),
+                                                                                   outputStreamBuffer);
+    
+    YRLightweightOutputStreamWriteInt32(outputStream, YRPacketSerializedCalculateCRC32C(bytes, length));
+}
+
+bool YRPacketSerializedHasValidCRC32C(const void *bytes, YRPayloadLengthType length) {
+    if (length < kYRPacketHeaderGenericLength) {
+        return false;
+    }
+    
+    uint8_t inputStreamBuffer[kYRLightweightInputStreamSize] __attribute__ ((__aligned__(sizeof(uintptr_t))));
+    YRLightweightInputStreamRef inputStream = YRLightweightInputStreamCreateAt(bytes, length, inputStreamBuffer);
+    
+    YRLightweightInputStreamSetIndexTo(inputStream, kYRPacketSerializedChecksumOffset);
+    
+    return YRLightweightInputStreamReadInt32(inputStream) == YRPacketSerializedCalculateCRC32C(bytes, length);
+}
+
+size_t YRPacketDeserializedLengthForStream(YRLightweightInputStreamRef stream) {
+    YRLightweightInputSteamReset(stream);
+    
+    // Skip packet description.
+    YRLightweightInputStreamReadInt8(stream);
+    
+    return YRPacketDeserializedLengthForHeaderLength(YRLightweightInputStreamReadInt8(stream));
+}
+
 YRPacketRef YRPacketDeserialize(YRLightweightInputStreamRef stream) {
-//    size_t requiredSize = YRPacketDataStructureLengthForPacketSize(YRLightweightInputStreamSize(stream));
-    return YRPacketDeserializeAt(stream, calloc(1, 1024));
-//    return YRPacketDeserializeAt(stream, calloc(1, YRLightweightInputStreamSize(stream)));
+    // Heap packet may get its payload copied inline later, see YRPacketCopyPayloadInline.
+    size_t inlineLength = YRPacketDataStructureLengthForPacketSize(YRLightweightInputStreamSize(stream));
+    size_t referencedLength = YRPacketDeserializedLengthForStream(stream);
+    void *packetBuffer = calloc(1, inlineLength > referencedLength ? inlineLength : referencedLength);
+    YRPacketRef packet = YRPacketDeserializeAt(stream, packetBuffer);
+    
+    if (!packet) {
+        free(packetBuffer);
+        return NULL;
+    }
+    
+    // Heap packet is owned by caller and freed by YRPacketDestroy.
+    packet->flags &= ~YRPacketFlagIsCustomlyAllocated;
+    
+    return packet;
 }
 
 YRPacketRef YRPacketDeserializeAt(YRLightweightInputStreamRef stream, void *packetBuffer) {
@@ -550,6 +744,11 @@ YRPacketRef YRPacketDeserializeAt(YRLightweightInputStreamRef stream, void *pack
     YRSequenceNumberType ackNumber = YRLightweightInputStreamReadInt16(stream);
     YRChecksumType checksum = YRLightweightInputStreamReadInt32(stream);
     
+    // Buffer may be on caller's stack, clear structure and header as checksum covers header padding too.
+    memset(packet, 0, YRPacketDeserializedLengthForHeaderLength(headerLength));
+    
+    packet->flags |= YRPacketFlagIsCustomlyAllocated;
+    
     YRPacketHeaderSetPacketDescription(header, packetDescription);
     YRPacketHeaderSetHeaderLength(header, headerLength);
     YRPacketHeaderSetSequenceNumber(header, seqNumber);
@@ -641,6 +840,14 @@ void YRPacketCopyPayloadInline(YRPacketRef packet) {
 
 #pragma mark - Private
 
+size_t YRPacketDeserializedLengthForHeaderLength(YRHeaderLengthType headerLength) {
+    // Fixed headers (SYN/RST) are filled entirely regardless of header length received, so reserve the largest one.
+    YRHeaderLengthType storedHeaderLength = headerLength > kYRPacketHeaderSYNLength ? headerLength : kYRPacketHeaderSYNLength;
+    
+    // Structure, header, payload pointer (payload itself stays in stream's buffer).
+    return YRMakeMultipleTo(kYRPacketStructureLength + storedHeaderLength, kYRAlignmentWithPayloadInBytes) + sizeof(uintptr_t);
+}
+
 YRPacketRef YRPacketConstruct(void *whereAt,
                               size_t packetSize,
                               YRSequenceNumberType seqNumber,
@@ -675,6 +882,19 @@ YRPacketRef YRPacketConstruct(void *whereAt,
     return packet;
 }
 
+YRChecksumType YRPacketSerializedCalculateCRC32C(const void *bytes, YRPayloadLengthType length) {
+    static const uint8_t zeroChecksum[sizeof(YRChecksumType)] = {0};
+    
+    uint32_t crc = YRCRC32CUpdate(0, bytes, kYRPacketSerializedChecksumOffset);
+    
+    crc = YRCRC32CUpdate(crc, zeroChecksum, sizeof(zeroChecksum));
+    crc = YRCRC32CUpdate(crc,
+                         (const uint8_t *)bytes + kYRPacketSerializedChecksumOffset + sizeof(YRChecksumType),
+                         length - kYRPacketSerializedChecksumOffset - sizeof(YRChecksumType));
+    
+    return crc;
+}
+
 void YRPacketFinalize(YRPacketRef packet) {
     YRPacketHeaderSetProtocolVersion(YRPacketGetHeader(packet), kYRProtocolVersion);
     YRPacketHeaderSetChecksum(YRPacketGetHeader(packet), YRPacketCalculateChecksum(packet));
@@ -684,17 +904,9 @@ inline YRChecksumType YRPacketCalculateChecksum(YRPacketRef packet) {
     YRPacketHeaderRef header = YRPacketGetHeader(packet);
     YRHeaderLengthType headerLength = YRPacketHeaderGetHeaderLength(header);
     
-    YRChecksumType resultingChecksum = 0;
-    uint64_t sum = 0;
+    // Header is summed in whole words, padding after it is zeroed on construction and deserialization.
+    YRChecksumType sum = YRChecksumAdd(0, header, YRMakeMultipleTo(headerLength, sizeof(YRChecksumType)));
     
-    // Iterate through header
-    for (YRChecksumType *iterator = (YRChecksumType *)header;
-         iterator < (YRChecksumType *)((uint8_t *)header + headerLength);
-         iterator++) {
-        sum += *iterator;
-    }
-
-    void *payloadStart = YRPacketGetPayloadStart(packet);
     YRPayloadLengthType payloadLength = 0;
     
     if (YRPacketHeaderHasPayloadLength(header)) {
@@ -702,22 +914,10 @@ inline YRChecksumType YRPacketCalculateChecksum(YRPacketRef packet) {
     }
     
     if (YRPacketHeaderHasCHK(header)) {
-        // Iterate through payload
-        for (YRChecksumType *iterator = YRPacketGetPayloadStart(packet);
-             iterator < (YRChecksumType *)((uint8_t *)payloadStart + payloadLength);
-             iterator++) {
-            sum += *iterator;
-        }
+        sum = YRChecksumAdd(sum, YRPacketGetPayloadStart(packet), payloadLength);
     }
     
-    // TODO: Make more independent of type size
-    while (sum >> (sizeof(YRChecksumType) * 8)) {
-        sum = (sum & (YRChecksumType)(~0)) + (sum >> (sizeof(YRChecksumType) * 8));
-    }
-    
-    resultingChecksum = (YRChecksumType)(~sum);
-    
-    return resultingChecksum;
+    return (YRChecksumType)(~sum);
 }
 
 void *YRPacketGetPayloadPointer(YRPacketRef packet) {
@@ -24,6 +24,7 @@ YRPayloadLengthType YRPacketNULLength(void);
 YRPayloadLengthType YRPacketACKLength(void);
 YRPayloadLengthType YRPacketEACKLength(YRSequenceNumberType *ioSequencesCount);
 YRPayloadLengthType YRPacketEACKLengthWithPayload(YRSequenceNumberType *ioSequencesCount, YRPayloadLengthType payloadLength);
+YRPayloadLengthType YRPacketEACKRangesLength(YRSequenceNumberType *ioRangesCount);
 YRPayloadLengthType YRPacketLengthForPayload(YRPayloadLengthType payloadLength);
 
 /**
@@ -31,6 +32,11 @@ YRPayloadLengthType YRPacketLengthForPayload(YRPayloadLengthType payloadLength);
  *  Typically used to allocate buffers for session.
  */
 size_t YRPacketDataStructureLengthForPacketSize(YRPayloadLengthType packetSize);
+/**
+ *  Largest packet size which data structure length still fits YRPayloadLengthType.
+ *  Bigger maximum segment sizes can't be used by session.
+ */
+YRPayloadLengthType YRPacketMaximumLength(void);
 
 #pragma mark - Factory Methods
 
@@ -60,6 +66,15 @@ YRPacketRef YRPacketCreateEACK(YRSequenceNumberType seqNumber,
                                YRSequenceNumberType *ioSequencesCount,
                                void *packetBuffer);
 
+/**
+ *  Ranges are [first, last] pairs, so there are 2 * ioRangesCount sequence numbers.
+ */
+YRPacketRef YRPacketCreateEACKRanges(YRSequenceNumberType seqNumber,
+                                     YRSequenceNumberType ackNumber,
+                                     YRSequenceNumberType *ranges,
+                                     YRSequenceNumberType *ioRangesCount,
+                                     void *packetBuffer);
+
 YRPacketRef YRPacketCreateEACKWithPayload(YRSequenceNumberType seqNumber,
                                           YRSequenceNumberType ackNumber,
                                           YRSequenceNumberType *sequences,
@@ -76,6 +91,17 @@ YRPacketRef YRPacketCreateWithPayload(YRSequenceNumberType seqNumber,
                                       bool copyPayload,
                                       void *packetBuffer);
 
+/**
+ *  Same as YRPacketCreateWithPayload, but checksum covers header only (CHK isn't set), so payload isn't summed.
+ *  For paths where payload is protected otherwise, see kYRConnectionOptionHeaderOnlyChecksum.
+ */
+YRPacketRef YRPacketCreateWithPayloadHeaderChecksumOnly(YRSequenceNumberType seqNumber,
+                                                        YRSequenceNumberType ackNumber,
+                                                        const void *payload,
+                                                        YRPayloadLengthType payloadLength,
+                                                        bool copyPayload,
+                                                        void *packetBuffer);
+
 void YRPacketCopy(YRPacketRef packet, void *whereTo);
 
 void YRPacketDestroy(YRPacketRef packet);
@@ -95,13 +121,54 @@ YRPayloadLengthType YRPacketGetLength(YRPacketRef packet);
  *  Header is not valid if RST/SYN/NUL packet contains data.
  */
 bool YRPacketIsLogicallyValid(YRPacketRef packet);
+/**
+ *  Same as YRPacketIsLogicallyValid, but ones' complement checksum isn't verified.
+ *  For packets which integrity is verified on wire, see YRPacketSerializedHasValidCRC32C.
+ */
+bool YRPacketIsLogicallyValidIgnoringChecksum(YRPacketRef packet);
 bool YRPacketCanDeserializeFromStream(YRLightweightInputStreamRef stream);
 
 #pragma mark - Serialization
 
 void YRPacketSerialize(YRPacketRef packet, YRLightweightOutputStreamRef buffer);
 
+/**
+ *  Writes packet in wire format straight into given buffer, e.g. transport's transmit buffer or iovec.
+ *  Payload referenced by packet (see copyPayload) is copied only once here.
+ *  Returns amount of written bytes or 0 if packet doesn't fit into buffer.
+ */
+YRPayloadLengthType YRPacketSerializeAt(YRPacketRef packet, void *buffer, YRPayloadLengthType bufferSize);
+
+/**
+ *  Refreshes ack number of already serialized packet in place, checksum is updated incrementally
+ *  so cost doesn't depend on payload length. Returns false and leaves bytes intact if packet doesn't carry ACK.
+ */
+bool YRPacketSerializedSetAckNumber(void *bytes, YRPayloadLengthType length, YRSequenceNumberType ackNumber);
+
+/**
+ *  Packet description (see YRPacketHeaderIsSYN etc.) of serialized packet, 0 if bytes are too short for header.
+ */
+YRPacketDescriptionType YRPacketSerializedGetPacketDescription(const void *bytes, YRPayloadLengthType length);
+
+/**
+ *  Replaces checksum of serialized packet with CRC32C of the whole datagram (checksum field counts as zeroes).
+ *  Should be the last modification of bytes before they are sent.
+ */
+void YRPacketSerializedSetCRC32C(void *bytes, YRPayloadLengthType length);
+bool YRPacketSerializedHasValidCRC32C(const void *bytes, YRPayloadLengthType length);
+
+/**
+ *  Returns buffer size YRPacketDeserializeAt needs for packet in given stream.
+ *  Payload is referenced in stream's buffer, so size depends on header only, not on datagram size.
+ *  Stream should be checked with YRPacketCanDeserializeFromStream first.
+ */
+size_t YRPacketDeserializedLengthForStream(YRLightweightInputStreamRef stream);
+
 YRPacketRef YRPacketDeserialize(YRLightweightInputStreamRef stream);
+/**
+ *  Deserializes packet into caller's buffer of YRPacketDeserializedLengthForStream size, e.g. on stack or in arena. Payload is referenced in stream's buffer, so such packet is valid only while buffer is.
+ *  YRPacketDestroy doesn't free such packet.
+ */
 YRPacketRef YRPacketDeserializeAt(YRLightweightInputStreamRef stream, void *packetBuffer);
 
 /**
@@ -7,6 +7,8 @@
 //
 
 #include "YRPacketHeader.h"
+#include "YRChecksum.h"
+#include <stddef.h> // for offsetof
 #include <stdlib.h>
 #include <string.h> // for memcpy
 
@@ -34,10 +36,20 @@ typedef struct YRPacketHeader {
 //    } packetSpecificData;
 } YRPacketHeader;
 
+// Part of YRConnectionConfiguration advertised to peer, local-only fields never get into SYN.
+typedef struct YRPacketHeaderSYNConfiguration {
+    uint16_t options;
+    uint16_t retransmissionTimeoutValue;
+    uint16_t nullSegmentTimeoutValue;
+    uint16_t maximumSegmentSize;
+    uint8_t maxNumberOfOutstandingSegments;
+    uint8_t maxRetransmissions;
+} YRPacketHeaderSYNConfiguration;
+
 typedef struct YRPacketHeaderSYN {
     YRPacketHeader commonHeader;
     // SYN-related data
-    YRConnectionConfiguration connectionConfiguration;
+    YRPacketHeaderSYNConfiguration connectionConfiguration;
 } YRPacketHeaderSYN;
 
 typedef struct YRPacketHeaderRST {
@@ -63,6 +75,10 @@ typedef struct YRPacketHeaderACK {
 
 #pragma pack(pop)
 
+#pragma mark - Prototypes
+
+static void YRPacketHeaderUpdateField(YRPacketHeaderRef header, size_t offset, const void *value, size_t size);
+
 #pragma mark - Constants
 
 YRProtocolVersionType const kYRProtocolVersion = 0x01;
@@ -103,6 +119,20 @@ YRSequenceNumberType YRPacketHeaderEACKsCountThatFit(YRHeaderLengthType headerLe
     return headerLength / eackTypeSize;
 }
 
+YRHeaderLengthType YRPacketHeaderEACKRangesLength(YRSequenceNumberType *ioRangesCount) {
+    YRSequenceNumberType rangesCount = ioRangesCount ? *ioRangesCount : 0;
+    YRSequenceNumberType sequencesCount = rangesCount > UINT16_MAX / 2 ? UINT16_MAX - 1 : rangesCount * 2;
+    
+    YRHeaderLengthType headerLength = YRPacketHeaderEACKLength(&sequencesCount);
+    
+    if (ioRangesCount) {
+        *ioRangesCount = sequencesCount / 2;
+    }
+    
+    // Drop half of range if odd count fits.
+    return headerLength - (sequencesCount % 2) * sizeof(YRSequenceNumberType);
+}
+
 #pragma mark - Configuration
 
 void YRPacketHeaderSetPacketDescription(YRPacketHeaderRef header, YRPacketDescriptionType packetDescription) {
@@ -198,14 +228,50 @@ YRChecksumType YRPacketHeaderGetChecksum(YRPacketHeaderRef header) {
     return header->checksum;
 }
 
+#pragma mark - Incremental Update
+
+void YRPacketHeaderUpdatePacketDescription(YRPacketHeaderRef header, YRPacketDescriptionType packetDescription) {
+    YRPacketHeaderUpdateField(header, offsetof(YRPacketHeader, packetDescription), &packetDescription, sizeof(packetDescription));
+}
+
+void YRPacketHeaderUpdateSequenceNumber(YRPacketHeaderRef header, YRSequenceNumberType seqNumber) {
+    YRPacketHeaderUpdateField(header, offsetof(YRPacketHeader, sequenceNumber), &seqNumber, sizeof(seqNumber));
+}
+
+void YRPacketHeaderUpdateAckNumber(YRPacketHeaderRef header, YRSequenceNumberType ackNumber) {
+    YRPacketHeaderUpdatePacketDescription(header, header->packetDescription | YRPacketDescriptionACK);
+    YRPacketHeaderUpdateField(header, offsetof(YRPacketHeader, ackNumber), &ackNumber, sizeof(ackNumber));
+}
+
+void YRPacketHeaderUpdatePayloadLength(YRPacketPayloadHeaderRef header, YRPayloadLengthType length) {
+    YRPacketHeaderUpdateField(&header->base, offsetof(YRPacketPayloadHeader, payloadLength), &length, sizeof(length));
+}
+
 #pragma mark - SYN Header
 
 void YRPacketSYNHeaderSetConfiguration(YRPacketHeaderSYNRef synHeader, YRConnectionConfiguration configuration) {
-    synHeader->connectionConfiguration = configuration;
+    YRPacketHeaderSYNConfiguration *synConfiguration = &synHeader->connectionConfiguration;
+    
+    synConfiguration->options = configuration.options;
+    synConfiguration->retransmissionTimeoutValue = configuration.retransmissionTimeoutValue;
+    synConfiguration->nullSegmentTimeoutValue = configuration.nullSegmentTimeoutValue;
+    synConfiguration->maximumSegmentSize = configuration.maximumSegmentSize;
+    synConfiguration->maxNumberOfOutstandingSegments = configuration.maxNumberOfOutstandingSegments;
+    synConfiguration->maxRetransmissions = configuration.maxRetransmissions;
 }
 
 YRConnectionConfiguration YRPacketSYNHeaderGetConfiguration(YRPacketHeaderSYNRef synHeader) {
-    return synHeader->connectionConfiguration;
+    YRPacketHeaderSYNConfiguration *synConfiguration = &synHeader->connectionConfiguration;
+    YRConnectionConfiguration configuration = {0};
+    
+    configuration.options = synConfiguration->options;
+    configuration.retransmissionTimeoutValue = synConfiguration->retransmissionTimeoutValue;
+    configuration.nullSegmentTimeoutValue = synConfiguration->nullSegmentTimeoutValue;
+    configuration.maximumSegmentSize = synConfiguration->maximumSegmentSize;
+    configuration.maxNumberOfOutstandingSegments = synConfiguration->maxNumberOfOutstandingSegments;
+    configuration.maxRetransmissions = synConfiguration->maxRetransmissions;
+    
+    return configuration;
 }
 
 #pragma mark - RST Header
@@ -262,3 +328,29 @@ YRSequenceNumberType *YRPacketHeaderGetEACKs(YRPacketHeaderEACKRef eackHeader, Y
         return NULL;
     }
 }
+
+YRSequenceNumberType *YRPacketHeaderGetEACKRanges(YRPacketHeaderEACKRef eackHeader, YRSequenceNumberType *rangesCount) {
+    YRSequenceNumberType eacksCount = 0;
+    YRSequenceNumberType *eacks = YRPacketHeaderGetEACKs(eackHeader, &eacksCount);
+    
+    if (rangesCount) {
+        *rangesCount = eacksCount / 2;
+    }
+    
+    return eacksCount >= 2 ? eacks : NULL;
+}
+
+#pragma mark - Private
+
+void YRPacketHeaderUpdateField(YRPacketHeaderRef header, size_t offset, const void *value, size_t size) {
+    // Checksum sums header in 32-bit words, none of updatable fields crosses word boundary.
+    uint8_t *word = (uint8_t *)header + (offset & ~(sizeof(YRChecksumType) - 1));
+    uint32_t oldWord = 0;
+    uint32_t newWord = 0;
+    
+    memcpy(&oldWord, word, sizeof(oldWord));
+    memcpy((uint8_t *)header + offset, value, size);
+    memcpy(&newWord, word, sizeof(newWord));
+    
+    header->checksum = YRChecksumUpdate(header->checksum, oldWord, newWord);
+}
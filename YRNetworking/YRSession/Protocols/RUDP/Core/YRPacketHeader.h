@@ -76,6 +76,11 @@ YRHeaderLengthType YRPacketHeaderEACKLength(YRSequenceNumberType *ioCount);
  */
 YRSequenceNumberType YRPacketHeaderEACKsCountThatFit(YRHeaderLengthType headerLength);
 
+/**
+ *  Same as YRPacketHeaderEACKLength, but for [first, last] ranges, each one takes two sequence numbers.
+ */
+YRHeaderLengthType YRPacketHeaderEACKRangesLength(YRSequenceNumberType *ioRangesCount);
+
 #pragma mark - Configuration
 
 // Generic Header
@@ -105,6 +110,17 @@ YRSequenceNumberType YRPacketHeaderGetSequenceNumber(YRPacketHeaderRef header);
 YRSequenceNumberType YRPacketHeaderGetAckNumber(YRPacketHeaderRef header);
 YRChecksumType YRPacketHeaderGetChecksum(YRPacketHeaderRef header);
 
+#pragma mark - Incremental Update
+
+/**
+ *  Same as setters above, but keep checksum of finalized header valid without summing it again (RFC 1624).
+ *  Cost doesn't depend on header or payload length, e.g. to refresh ack number of retransmitted segment.
+ */
+void YRPacketHeaderUpdatePacketDescription(YRPacketHeaderRef header, YRPacketDescriptionType packetDescription);
+void YRPacketHeaderUpdateSequenceNumber(YRPacketHeaderRef header, YRSequenceNumberType seqNumber);
+void YRPacketHeaderUpdateAckNumber(YRPacketHeaderRef header, YRSequenceNumberType ackNumber);
+void YRPacketHeaderUpdatePayloadLength(YRPacketPayloadHeaderRef header, YRPayloadLengthType length);
+
 #pragma mark - SYN Header
 
 void YRPacketSYNHeaderSetConfiguration(YRPacketHeaderSYNRef synHeader, YRConnectionConfiguration configuration);
@@ -127,5 +143,10 @@ void YRPacketHeaderSetEACKs(YRPacketHeaderEACKRef eackHeader, YRSequenceNumberTy
 
 YRSequenceNumberType YRPacketHeaderEACKsCount(YRPacketHeaderEACKRef eackHeader);
 YRSequenceNumberType *YRPacketHeaderGetEACKs(YRPacketHeaderEACKRef eackHeader, YRSequenceNumberType *eacksCount);
+/**
+ *  Ranges are stored as pairs in the same list of sequence numbers, so header carries no marker of encoding:
+ *  it's negotiated per connection, see kYRConnectionOptionEACKRanges. Unpaired trailing number is ignored.
+ */
+YRSequenceNumberType *YRPacketHeaderGetEACKRanges(YRPacketHeaderEACKRef eackHeader, YRSequenceNumberType *rangesCount);
 
 #endif /* YRPacketHeader_h */
@@ -10,16 +10,84 @@
 #define __YRConnectionConfiguration__
 
 #include <stdio.h>
+#include <stdint.h>
+
+typedef enum {
+    // Segments other than SYN and RST carry CRC32C of the whole datagram instead of ones' complement checksum.
+    // Takes effect only when both peers advertise it.
+    kYRConnectionOptionCRC32C = 1 << 0,
+    // Checksum covers header only (CHK isn't set), payload relies on UDP/NIC checksum. For loopback and trusted paths.
+    // Takes effect only when both peers advertise it. Payload is still covered if CRC32C is negotiated too.
+    kYRConnectionOptionHeaderOnlyChecksum = 1 << 1,
+    // maxNumberOfOutstandingSegments is shifted left by window scale stored in kYRConnectionOptionWindowScaleMask bits.
+    // Describes advertiser's own receive window, so peers that don't know it just use unscaled (smaller) window.
+    kYRConnectionOptionLargeWindow = 1 << 2,
+    // EACK lists [first, last] ranges of out of sequence segments instead of every one of them.
+    // Takes effect only when both peers advertise it.
+    kYRConnectionOptionEACKRanges = 1 << 3,
+    // Payload of every data segment is a sequence of messages, each prefixed with 16-bit big-endian length,
+    // so several small sends share one segment. Takes effect only when both peers advertise it.
+    kYRConnectionOptionBatching = 1 << 4,
+    kYRConnectionOptionWindowScaleMask = 0xF << 8,
+} YRConnectionOption;
+
+static const uint8_t kYRConnectionOptionWindowScaleShift = 8;
+// Window stays below half of sequence space: 255 << 7 == 32640.
+static const uint8_t kYRConnectionMaxWindowScale = 7;
 
 typedef struct {
-    uint16_t options; // zero for now
+    uint16_t options; // YRConnectionOption flags
     uint16_t retransmissionTimeoutValue; // ms
     uint16_t nullSegmentTimeoutValue; // ms
     uint16_t maximumSegmentSize;
     uint8_t maxNumberOfOutstandingSegments;
     uint8_t maxRetransmissions;
-    //    uint8_t maxCumulativeAck;
-    //    uint16_t cumulativeAckTimeoutValue; // ms
+    // In-sequence segments acknowledged by one ACK at most, ACK is delayed for cumulativeAckTimeoutValue at most.
+    // Either one being 0 acknowledges every segment immediately. Local only, not sent in SYN.
+    // Timeout should stay well below peer's retransmission timeout.
+    uint8_t maxCumulativeAck;
+    uint16_t cumulativeAckTimeoutValue; // ms
+    // The longest time message waits in batch, see kYRConnectionOptionBatching.
+    // 0 keeps messages till batch is full or flushed explicitly. Local only, not sent in SYN.
+    uint16_t batchingTimeoutValue; // ms
 } YRConnectionConfiguration;
 
+/**
+ *  Number of segments peer that advertised configuration is ready to receive.
+ */
+static inline uint16_t YRConnectionConfigurationGetWindow(YRConnectionConfiguration configuration) {
+    if (!(configuration.options & kYRConnectionOptionLargeWindow)) {
+        return configuration.maxNumberOfOutstandingSegments;
+    }
+    
+    uint8_t scale = (configuration.options & kYRConnectionOptionWindowScaleMask) >> kYRConnectionOptionWindowScaleShift;
+    
+    if (scale > kYRConnectionMaxWindowScale) {
+        scale = kYRConnectionMaxWindowScale;
+    }
+    
+    return (uint16_t)configuration.maxNumberOfOutstandingSegments << scale;
+}
+
+/**
+ *  Picks the smallest scale that fits window, window is rounded down to multiple of 2^scale.
+ *  Windows up to UINT8_MAX don't set kYRConnectionOptionLargeWindow.
+ */
+static inline void YRConnectionConfigurationSetWindow(YRConnectionConfiguration *configuration, uint16_t window) {
+    uint8_t scale = 0;
+    
+    while (scale < kYRConnectionMaxWindowScale && (window >> scale) > UINT8_MAX) {
+        scale++;
+    }
+    
+    uint16_t segments = window >> scale;
+    
+    configuration->options &= ~(kYRConnectionOptionLargeWindow | kYRConnectionOptionWindowScaleMask);
+    configuration->maxNumberOfOutstandingSegments = segments > UINT8_MAX ? UINT8_MAX : segments;
+    
+    if (scale > 0) {
+        configuration->options |= kYRConnectionOptionLargeWindow | (scale << kYRConnectionOptionWindowScaleShift);
+    }
+}
+
 #endif
@@ -89,6 +89,14 @@ YRSessionProtocolClientCallbacks YRSessionProtocolGetClientCallbacks(YRSessionPr
     return protocol->clientCallbacks;
 }
 
+void YRSessionProtocolSetClientContext(YRSessionProtocolRef protocol, void *context) {
+    protocol->clientContext = context;
+}
+
+void *YRSessionProtocolGetClientContext(YRSessionProtocolRef protocol) {
+    return protocol->clientContext;
+}
+
 #pragma mark - Connection
 
 void YRSessionProtocolConnect(YRSessionProtocolRef protocol) {
@@ -66,6 +66,8 @@ typedef struct YRSessionProtocol {
     YRSessionProtocolLifecycleCallbacks lifecycleCallbacks;
     YRSessionProtocolCallbacks protocolCallbacks;
     YRSessionProtocolClientCallbacks clientCallbacks;
+    // Opaque pointer owned by whoever installed client callbacks.
+    void *clientContext;
 } YRSessionProtocol;
 
 #pragma mark - Lifecycle
@@ -84,6 +86,13 @@ YRSessionProtocolLifecycleCallbacks YRSessionProtocolGetLifecycleCallbacks(YRSes
 YRSessionProtocolCallbacks YRSessionProtocolGetCallbacks(YRSessionProtocolRef protocol);
 YRSessionProtocolClientCallbacks YRSessionProtocolGetClientCallbacks(YRSessionProtocolRef protocol);
 
+/**
+ *  Client context is never touched by protocol itself.
+ *  It lets client callbacks find their owner when blocks are not available (plain function pointers).
+ */
+void YRSessionProtocolSetClientContext(YRSessionProtocolRef protocol, void *context);
+void *YRSessionProtocolGetClientContext(YRSessionProtocolRef protocol);
+
 #pragma mark - Connection
 
 void YRSessionProtocolConnect(YRSessionProtocolRef protocol);
@@ -17,8 +17,32 @@
 
 // Private
 #include "YRPacketsQueue.h"
+#include "YRSubmissionRing.h"
+#include "YRBufferPool.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+// Bounds of adaptive retransmission timeout, ms.
+#define kYRSessionMinRetransmissionTimeout 20
+#define kYRSessionMaxRetransmissionTimeout 60000
+
+// Pacer credit is kept in 1/1024 of segment. Burst is amount of segments that may leave back to back.
+#define kYRSessionPacingCreditPerSegment 1024
+#define kYRSessionPacingBurst 2
+
+// Queue buffers start at cache line boundary, so stored segments don't share lines.
+#define kYRSessionQueueBufferAlignment 64
+
+// Segments EACK'd above outstanding one before it's considered lost and retransmitted early (RFC 6675 DupThresh).
+#define kYRSessionFastRetransmitThreshold 3
+
+// Payloads other threads may queue before session's thread picks them up.
+#define kYRSessionSubmissionsCapacity 64
+
+// Every batched message is prefixed with its length, see kYRConnectionOptionBatching.
+#define kYRSessionBatchedMessageHeaderLength sizeof(YRPayloadLengthType)
 
 typedef void (^YRPacketBuilder) (void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber);
 
@@ -29,11 +53,31 @@ typedef enum {
     YRSessionFlagHasPeerConfiguration = 1 << 2
 } YRSessionFlags;
 
+/**
+ *  Header of every send queue buffer, packet data structure follows it in the same buffer.
+ */
 typedef struct {
-    double sendTime; // TODO: Think about type
+    uint64_t sendTime; // ms, timer wheel time of the latest transmission
     uint8_t retransmissions;
+    // Queued by pacer and not transmitted yet.
+    bool isPending;
+    // Resent once on EACK before retransmission timeout, later losses are left to timer.
+    bool isFastRetransmitted;
+    // Packet is serialized into wire format once and resent as is.
+    YRPayloadLengthType length;
+    uint8_t bytes[] __attribute__ ((__aligned__(8)));
 } YRSessionSendOperation;
 
+typedef YRSessionSendOperation *YRSessionSendOperationRef;
+
+// Out of sequence segment parked in receive queue as received datagram till preceding segments arrive.
+typedef struct {
+    YRPayloadLengthType length;
+    uint8_t bytes[] __attribute__ ((__aligned__(8)));
+} YRSessionReceiveOperation;
+
+typedef YRSessionReceiveOperation *YRSessionReceiveOperationRef;
+
 // TODO: Transite to this abstract type.
 //typedef struct YRSession {
 //    YRSessionState state; // TODO: Reduce size of this one
@@ -51,8 +95,40 @@ typedef struct YRSession {
     YRConnectionConfiguration remoteConnectionConfiguration;
     YRSessionCallbacks callbacks;
     
-    void *(^createTimer) (void);
-    void (^cancelTimer) (void *timer);
+    // Timers are embedded into session, wheel just links them, so arming them never allocates.
+    YRTimerWheelRef timerWheel;
+    YRTimer retransmissionTimer;
+    YRTimer nullSegmentTimer;
+    YRTimer disconnectTimer;
+    YRTimer pacingTimer;
+    YRTimer cumulativeAckTimer;
+    YRTimer batchingTimer;
+    
+    // SYN is not stored in send queue, so its retransmissions are counted here.
+    uint8_t synRetransmissions;
+    uint64_t synSendTime;
+    
+    // RFC 6298 estimator: smoothed RTT is scaled by 8, its variance by 4 (ms).
+    bool hasRoundTripTimeSample;
+    uint32_t scaledSmoothedRoundTripTime;
+    uint32_t scaledRoundTripTimeVariance;
+    // Current timeout with backoff applied, starts with configured retransmissionTimeoutValue.
+    uint32_t retransmissionTimeout;
+    
+    // Initialized when peer's window becomes known, see YRSessionGetSendQueue.
+    const YRCongestionControlAlgorithm *congestionControlAlgorithm;
+    YRCongestionControl congestionControl;
+    // Window is reduced once per loss episode: till segments sent before loss detection are acknowledged.
+    bool isInRecovery;
+    YRSequenceNumberType recoveryPoint;
+    
+    // Pacer: segments [nextSegmentToTransmit, sendNextSequenceNumber) wait in send queue for credit.
+    YRSequenceNumberType nextSegmentToTransmit;
+    uint32_t pacingCredit;
+    uint64_t pacingUpdateTime;
+    
+    // The latest rcvLatestAckedSegment that left in any segment, ACK is owed while it lags behind.
+    YRSequenceNumberType sentAckNumber;
     
     // Determines if local peer should send NUL segments.
     bool shouldKeepAlive;
@@ -61,6 +137,18 @@ typedef struct YRSession {
     
     YRPacketsQueueRef sendQueue;
     YRPacketsQueueRef receiveQueue;
+    
+    // Created on session's thread once connected, producers on other threads only load it.
+    // Every slot holds payload copy, see YRSessionCreateSubmissionsIfNeeded.
+    YRSubmissionRingRef submissions;
+    // Submitted payloads YRSessionSend refused.
+    uint32_t droppedSubmissionsCount;
+    
+    // Messages waiting to leave in one segment, buffer is taken from buffer pool by the first of them.
+    uint8_t *batch;
+    YRPayloadLengthType batchLength;
+    // Close waits till batch that didn't fit into window leaves, see YRSessionCompleteRequestedClose.
+    bool isCloseRequested;
 } YRSession;
 
 static const YRSessionCallbacks kYRNullSessionCallbacks = {NULL, NULL, NULL};
@@ -75,29 +163,105 @@ void YRSessionTransiteToState(YRSessionRef session, YRSessionState state);
 // TODO: Let's go hardcore here, don't implement this, send queue will dynamically manage several regions of memory if it's needed.
 size_t YRSessionGetFinalMinimumSize(YRConnectionConfiguration localConfiguration, YRConnectionConfiguration remoteConfiguration);
 
-void YRSessionSchedulePacketSendReliably(YRSessionRef session, YRPacketRef packet);
-
 void YRSessionProcessOutOfSequencePacketsIfAny(YRSessionRef session);
 
+// Receiving
+void YRSessionReceiveSegment(YRSessionRef session, YRPacketRef packet, const void *datagram, YRPayloadLengthType length);
+void YRSessionDeliverPayload(YRSessionRef session, YRPacketRef packet);
+void YRSessionDeliverDatagram(YRSessionRef session, const void *datagram, YRPayloadLengthType length);
+void YRSessionDeliverBatch(YRSessionRef session, const uint8_t *batch, YRPayloadLengthType length);
+
+// Integrity
+bool YRSessionIsCRC32CNegotiated(YRSessionRef session);
+bool YRSessionIsUsingCRC32CForHeader(YRSessionRef session, YRPacketHeaderRef header);
+bool YRSessionIsHeaderOnlyChecksumNegotiated(YRSessionRef session);
+bool YRSessionShouldChecksumPayload(YRSessionRef session);
+bool YRSessionIsReceivedPacketValid(YRSessionRef session, YRPacketRef packet, const void *datagram, YRPayloadLengthType length);
+bool YRSessionIsEACKRangesNegotiated(YRSessionRef session);
+bool YRSessionIsBatchingNegotiated(YRSessionRef session);
+
 // Packet Queues
 YRPacketsQueueRef YRSessionGetSendQueue(YRSessionRef session);
 YRPacketsQueueRef YRSessionGetReceiveQueue(YRSessionRef session);
+YRPacketsQueueRef YRSessionCreateQueue(size_t bufferSize, uint16_t window);
+
+// Submissions
+void YRSessionCreateSubmissionsIfNeeded(YRSessionRef session);
+void YRSessionDiscardSubmissions(YRSessionRef session);
+
+// Batching
+YRPayloadLengthType YRSessionGetBatchCapacity(YRSessionRef session);
+bool YRSessionAppendToBatch(YRSessionRef session, const void *payload, YRPayloadLengthType length);
+void YRSessionScheduleBatchingTimerIfNeeded(YRSessionRef session);
+void YRSessionDiscardBatch(YRSessionRef session);
+void YRSessionCompleteRequestedClose(YRSessionRef session);
 
+// ACK'ing
 void YRSessionDoACKOrEACK(YRSessionRef session);
+void YRSessionScheduleACK(YRSessionRef session, bool isUrgent);
 
-void YRSessionDoReliableSend(YRSessionRef session, YRPacketBuilder packetBuilder, YRPayloadLengthType packetLength);
-void YRSessionDoReliableSendWithAutoIncrement(YRSessionRef session,
+bool YRSessionDoReliableSend(YRSessionRef session, YRPacketBuilder packetBuilder, YRPayloadLengthType packetLength);
+bool YRSessionDoReliableSendWithAutoIncrement(YRSessionRef session,
                                               YRPacketBuilder packetBuilder,
                                               YRPayloadLengthType packetLength,
                                               bool increment);
 
 void YRSessionDoUnreliableSend(YRSessionRef session, YRPacketBuilder packetBuilder, YRPayloadLengthType packetLength);
 void YRSessionSendPacket(YRSessionRef session, YRPacketRef packet);
+void YRSessionSendBytes(YRSessionRef session, const void *bytes, YRPayloadLengthType length);
+void YRSessionSendStoredSegment(YRSessionRef session, YRSessionSendOperationRef operation);
+bool YRSessionSendSegmentWithPayload(YRSessionRef session, const void *payload, YRPayloadLengthType length);
+YRPayloadLengthType YRSessionGetMaximumPayloadLength(YRSessionRef session);
+size_t YRSessionGetSendOperationCapacity(YRSessionRef session);
+void YRSessionSetRemoteConnectionConfiguration(YRSessionRef session, YRConnectionConfiguration configuration);
+
+// Timers
+void YRSessionScheduleTimer(YRSessionRef session, YRTimerRef timer, uint32_t timeout);
+void YRSessionCancelTimer(YRSessionRef session, YRTimerRef timer);
+void YRSessionCancelTimers(YRSessionRef session);
+void YRSessionUpdateTimersForState(YRSessionRef session);
+void YRSessionScheduleRetransmissionTimerIfNeeded(YRSessionRef session);
+void YRSessionScheduleNullSegmentTimer(YRSessionRef session);
+uint32_t YRSessionGetDisconnectTimeout(YRSessionRef session);
+
+// Round trip time
+int32_t YRSessionSampleRoundTripTime(YRSessionRef session, uint64_t sendTime, uint8_t retransmissions);
+int32_t YRSessionSampleRoundTripTimeForOperation(YRSessionRef session, YRSessionSendOperationRef operation);
+void YRSessionBackOffRetransmissionTimeout(YRSessionRef session);
+void YRSessionResetRoundTripTimeEstimation(YRSessionRef session);
+
+// Congestion control
+void YRSessionEnterRecovery(YRSessionRef session);
+void YRSessionRetransmitLostSegments(YRSessionRef session, YRSequenceNumberType highestAcknowledged);
+static inline bool YRSessionIsSequenceAfterOrEqual(YRSequenceNumberType sequence, YRSequenceNumberType other);
+
+// Pacing
+void YRSessionTransmitOperation(YRSessionRef session, YRSessionSendOperationRef operation);
+bool YRSessionIsPacingEnabled(YRSessionRef session);
+uint32_t YRSessionGetPacingCreditPerMillisecond(YRSessionRef session);
+void YRSessionRefillPacingCredit(YRSessionRef session);
+bool YRSessionTakePacingCredit(YRSessionRef session);
+void YRSessionSchedulePacingTimer(YRSessionRef session);
+
+void YRSessionHandleRetransmissionTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context);
+void YRSessionHandleNullSegmentTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context);
+void YRSessionHandleDisconnectTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context);
+void YRSessionHandlePacingTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context);
+void YRSessionHandleCumulativeAckTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context);
+void YRSessionHandleBatchingTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context);
+
+void YRSessionInvalidateConnection(YRSessionRef session);
+void YRSessionResendSYN(YRSessionRef session);
 
 #pragma mark - Sizes
 #pragma mark - Lifecycle
 
 YRSessionRef YRSessionCreateWithConfiguration(YRConnectionConfiguration configuration, YRSessionCallbacks callbacks) {
+    // Receive queue stores out of sequence segments up to maximum segment size, their length is YRPayloadLengthType.
+    if (configuration.maximumSegmentSize > YRPacketMaximumLength()) {
+        return NULL;
+    }
+    
     YRSessionRef session = calloc(1, sizeof(YRSession));
     
     if (!session) {
@@ -107,6 +271,17 @@ YRSessionRef YRSessionCreateWithConfiguration(YRConnectionConfiguration configur
     session->state = kYRSessionStateClosed;
     session->localConnectionConfiguration = configuration;
     
+    YRSessionResetRoundTripTimeEstimation(session);
+    
+    session->congestionControlAlgorithm = &kYRCongestionControlNewReno;
+    
+    YRTimerInit(&session->retransmissionTimer, YRSessionHandleRetransmissionTimeout, session);
+    YRTimerInit(&session->nullSegmentTimer, YRSessionHandleNullSegmentTimeout, session);
+    YRTimerInit(&session->disconnectTimer, YRSessionHandleDisconnectTimeout, session);
+    YRTimerInit(&session->pacingTimer, YRSessionHandlePacingTimeout, session);
+    YRTimerInit(&session->cumulativeAckTimer, YRSessionHandleCumulativeAckTimeout, session);
+    YRTimerInit(&session->batchingTimer, YRSessionHandleBatchingTimeout, session);
+    
     YRSessionSetCallbacks(session, callbacks);
     
     return session;
@@ -116,11 +291,32 @@ void YRSessionDestroy(YRSessionRef session) {
     if (session) {
         // TODO: Implement proper destruction
         YRSessionSetCallbacks(session, kYRNullSessionCallbacks);
+        YRSessionCancelTimers(session);
+        YRSessionDiscardBatch(session);
+        
+        YRPacketsQueueDestroy(session->sendQueue);
+        YRPacketsQueueDestroy(session->receiveQueue);
+        
+        YRSessionDiscardSubmissions(session);
         
         free(session);
     }
 }
 
+void YRSessionSetTimerWheel(YRSessionRef session, YRTimerWheelRef wheel) {
+    YRSessionCancelTimers(session);
+    
+    session->timerWheel = wheel;
+}
+
+void YRSessionSetCongestionControlAlgorithm(YRSessionRef session, const YRCongestionControlAlgorithm *algorithm) {
+    session->congestionControlAlgorithm = algorithm;
+    
+    if (session->sendQueue) {
+        YRCongestionControlInit(&session->congestionControl, algorithm, YRConnectionConfigurationGetWindow(session->remoteConnectionConfiguration));
+    }
+}
+
 #pragma mark - Configuration
 
 void YRSessionConnect(YRSessionRef session) {
@@ -151,42 +347,33 @@ void YRSessionWait(YRSessionRef session) {
 
 void YRSessionClose(YRSessionRef session) {
     //    [_sessionLogger logInfo:@"[CLOSE_REQ] (%@)", [self humanReadableState:self.state]];
-    //
-    //    if (self.state == kYRSessionStateConnected) {
-    //        [self transiteToState:kYRSessionStateDisconnecting];
-    //
-    //        YRPacketRef packet = YRPacketCreateRST(0, _sendNextSequenceNumber, _rcvLatestAckedSegment, true, NULL);
-    //        _sendNextSequenceNumber++;
-    //
-    //        [self sendPacketReliably:packet];
-    //
-    //        [_disconnectingTimer invalidate];
-    //        _disconnectingTimer = [NSTimer scheduledTimerWithTimeInterval:5 target:self
-    //                                                             selector:@selector(handleDisconnectTimeout:) userInfo:nil repeats:NO];
-    //
-    //        return;
-    //    }
-    //
-    //    if (self.state == kYRSessionStateWaiting) {
-    //        [self transiteToState:kYRSessionStateClosed];
-    //        return;
-    //    }
-    //
-    //    if (self.state == kYRSessionStateConnecting || self.state == kYRSessionStateInitiating) {
-    //        [self transiteToState:kYRSessionStateClosed];
-    //
-    //        YRPacketRef packet = YRPacketCreateRST(0, _sendNextSequenceNumber, 0, false, NULL);
-    //
-    //        [self sendPacketUnreliably:packet];
-    //        return;
-    //    }
+    
+    switch (session->state) {
+        case kYRSessionStateConnected:
+            session->isCloseRequested = true;
+            
+            YRSessionCompleteRequestedClose(session);
+            break;
+        case kYRSessionStateWaiting:
+            YRSessionTransiteToState(session, kYRSessionStateClosed);
+            break;
+        case kYRSessionStateConnecting:
+        case kYRSessionStateInitiating:
+            YRSessionTransiteToState(session, kYRSessionStateClosed);
+            
+            YRSessionDoUnreliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
+                YRPacketCreateRST(0, seqNumber, 0, false, packetBuffer);
+            }, YRPacketRSTLength());
+            break;
+        default:
+            break;
+    }
 }
 
 void YRSessionInvalidate(YRSessionRef session) {
-    //    [_sessionLogger logInfo:@"[INVL_REQ] (%@): <NOT IMPLEMENTED YET>", [self humanReadableState:self.state]];
-    //    // TODO:
-    //
-    //    [self transiteToState:kYRSessionStateClosed];
+    //    [_sessionLogger logInfo:@"[INVL_REQ] (%@)", [self humanReadableState:self.state]];
+    
+    YRSessionInvalidateConnection(session);
 }
 
 #pragma mark - Communication
@@ -195,7 +382,8 @@ bool YRSessionCanSend(YRSessionRef session) {
     if (session->state == kYRSessionStateConnected) {
         YRPacketsQueueRef queue = YRSessionGetSendQueue(session);
         
-        return YRPacketsQueueBuffersInUse(queue) < session->remoteConnectionConfiguration.maxNumberOfOutstandingSegments;
+        // Congestion window never exceeds peer's window.
+        return YRPacketsQueueBuffersInUse(queue) < YRCongestionControlGetWindow(&session->congestionControl);
     }
     
     return false;
@@ -219,20 +407,25 @@ void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType l
         return;
     }
     
-    // TODO: Deserialize packet on stack
-    //    uint8_t bufferForPacket[kYRLightweightInputStreamSize] __attribute__ ((__aligned__(8)));
-    YRPacketRef receivedPacket = YRPacketDeserialize(stream);
+    // Packet references payload in datagram, so in-sequence payload is delivered without copying.
+    uint8_t bufferForPacket[YRPacketDeserializedLengthForStream(stream)] __attribute__ ((__aligned__(8)));
+    YRPacketRef receivedPacket = YRPacketDeserializeAt(stream, bufferForPacket);
+    
+    if (!receivedPacket) {
+        // TODO: Error
+        return;
+    }
+    
     YRPacketHeaderRef receivedHeader = YRPacketGetHeader(receivedPacket);
     
     //    BOOL shouldResetConnection = NO;
-    bool isValidPacket = YRPacketIsLogicallyValid(receivedPacket);
+    bool isValidPacket = YRSessionIsReceivedPacketValid(session, receivedPacket, payload, length);
     
     if (isValidPacket) {
         //        [_sessionLogger logInfo:@"[RCV_REQ] (%@) Packet: %@", [self humanReadableState:self.state], [YRDebugUtils packetHeaderShortDescription:YRPacketGetHeader(receivedPacket)]];
     } else {
         //        [_sessionLogger logWarning:@"[RCV_REQ] (%@) Invalid Packet!\n%@", [self humanReadableState:self.state], [YRDebugUtils packetHeaderFullDescription:YRPacketGetHeader(receivedPacket)]];
         
-        YRPacketDestroy(receivedPacket);
         return;
     }
     
@@ -272,10 +465,12 @@ void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType l
             if (isSYN) {
                 session->sessionInfo.rcvLatestAckedSegment = rcvSeqNumber;
                 session->sessionInfo.rcvInitialSequenceNumber = rcvSeqNumber;
+                // SYN is acknowledged by our SYN or ACK right away.
+                session->sentAckNumber = rcvSeqNumber;
                 
                 YRPacketHeaderSYNRef synHeader = (YRPacketHeaderSYNRef)receivedHeader;
                 
-                session->remoteConnectionConfiguration = YRPacketSYNHeaderGetConfiguration(synHeader);
+                YRSessionSetRemoteConnectionConfiguration(session, YRPacketSYNHeaderGetConfiguration(synHeader));
                 
                 YRSessionTransiteToState(session, kYRSessionStateConnecting);
                 
@@ -312,10 +507,12 @@ void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType l
             if (isSYN) {
                 session->sessionInfo.rcvLatestAckedSegment = rcvSeqNumber;
                 session->sessionInfo.rcvInitialSequenceNumber = rcvSeqNumber;
+                // SYN is acknowledged by our SYN or ACK right away.
+                session->sentAckNumber = rcvSeqNumber;
                 
                 YRPacketHeaderSYNRef synHeader = (YRPacketHeaderSYNRef)receivedHeader;
                 
-                session->remoteConnectionConfiguration = YRPacketSYNHeaderGetConfiguration(synHeader);
+                YRSessionSetRemoteConnectionConfiguration(session, YRPacketSYNHeaderGetConfiguration(synHeader));
                 
                 if (hasACK) {
                     // Normally we should remove all operations from send queue.
@@ -352,12 +549,14 @@ void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType l
         case kYRSessionStateConnecting: {
             YRSequenceNumberType expectedToReceive = session->sessionInfo.rcvLatestAckedSegment + 1;
             
-            bool willWrapAround = (expectedToReceive + session->localConnectionConfiguration.maxNumberOfOutstandingSegments) < expectedToReceive;
+            YRSequenceNumberType maxToReceive = expectedToReceive + YRConnectionConfigurationGetWindow(session->localConnectionConfiguration);
+            
+            bool willWrapAround = maxToReceive < expectedToReceive;
             
-            bool canProcessPacket = expectedToReceive <= rcvSeqNumber && rcvSeqNumber <= (expectedToReceive + session->localConnectionConfiguration.maxNumberOfOutstandingSegments);
+            bool canProcessPacket = expectedToReceive <= rcvSeqNumber && rcvSeqNumber <= maxToReceive;
             
             if (willWrapAround) {
-                canProcessPacket = expectedToReceive <= rcvSeqNumber || rcvSeqNumber <= (expectedToReceive + session->localConnectionConfiguration.maxNumberOfOutstandingSegments);
+                canProcessPacket = expectedToReceive <= rcvSeqNumber || rcvSeqNumber <= maxToReceive;
             }
             
             if (!canProcessPacket) {
@@ -428,61 +627,30 @@ void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType l
             }
             
             if (isNUL || payloadLength > 0) {
-                if (rcvSeqNumber == expectedToReceive) {
-                    session->sessionInfo.rcvLatestAckedSegment = rcvSeqNumber;
-                    
-                    if (payloadLength > 0) {
-                        // Copy data
-                        void *rawPayload = YRPacketGetPayload(receivedPacket, &payloadLength);
-                        
-                        //                        assert(rawPayload);
-                        
-                        !session->callbacks.receiveCallout ?: session->callbacks.receiveCallout(session, rawPayload, payloadLength);
-                    }
-                    
-                    YRSessionProcessOutOfSequencePacketsIfAny(session);
-                } else {
-                    // Received out-of-seq packet
-                    YRPacketsQueueRef receiveQueue = YRSessionGetReceiveQueue(session);
-                    
-                    if (!YRPacketsQueueIsBufferInUseForSegment(receiveQueue, rcvSeqNumber)) {
-                        // Buffer data
-                        // snd: EAK
-                        YRPacketCopyPayloadInline(receivedPacket);
-                        
-                        void *buffer = YRPacketsQueueBufferForSegment(receiveQueue, rcvSeqNumber);
-                        
-                        //                        assert(buffer);
-                        
-                        if (buffer) {
-                            // This MUST be true always
-                            // Move packet to heap
-                            YRPacketCopy(receivedPacket, buffer);
-                            
-                            YRPacketsQueueMarkBufferInUseForSegment(receiveQueue, rcvSeqNumber);
-                        }
-                    } else {
-                        // Received duplicated out of sequence segment, ignore.
-                    }
-                }
+                YRSessionReceiveSegment(session, receivedPacket, payload, length);
                 
                 YRSessionDoACKOrEACK(session);
             }
         }
             break;
         case kYRSessionStateConnected: {
+            if (!session->shouldKeepAlive) {
+                // Any segment proves that active peer is still there.
+                YRSessionScheduleNullSegmentTimer(session);
+            }
+            
             // This will forcefully create receive queue, should we postpone this?
             YRPacketsQueueRef receiveQueue = YRSessionGetReceiveQueue(session);
             
-            // TODO: Wrong, rcv queue stores only out of seq data
-            if (!YRPacketsQueueHasBufferForSegment(receiveQueue, rcvSeqNumber)) {
+            YRSequenceNumberType expectedToReceive = session->sessionInfo.rcvLatestAckedSegment + 1;
+            
+            // Receive queue stores only out of sequence segments, it starts right after expected one.
+            if (rcvSeqNumber != expectedToReceive && !YRPacketsQueueHasBufferForSegment(receiveQueue, rcvSeqNumber)) {
                 // Can't process packet, because it's out of range.
                 YRSessionDoACKOrEACK(session);
                 break;
             }
             
-            YRSequenceNumberType expectedToReceive = session->sessionInfo.rcvLatestAckedSegment + 1;
-            
             //            YRSequenceNumberType expectedToReceive = _rcvLatestAckedSegment + 1;
             //
             //            YRSequenceNumberType maxSegmentThatCanBeReceived = expectedToReceive + _localConfiguration.maxNumberOfOutstandingSegments;
@@ -510,10 +678,7 @@ void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType l
             
             if (isRST) {
                 // signal: connection reset
-                //                [_disconnectingTimer invalidate];
-                //                _disconnectingTimer = [NSTimer scheduledTimerWithTimeInterval:5 target:self
-                //                                                                     selector:@selector(handleDisconnectTimeout:) userInfo:nil repeats:NO];
-                
+                // Arms disconnect timer.
                 YRSessionTransiteToState(session, kYRSessionStateDisconnecting);
                 break;
             }
@@ -522,13 +687,38 @@ void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType l
                 // queue: flush.
                 YRPacketsQueueRef sendQueue = YRSessionGetSendQueue(session);
                 
-                session->sessionInfo.sendLatestUnackSegment = rcvAckNumber + 1;
-                
+                // Queue base is the oldest unacknowledged segment, ack number is the latest segment peer received in sequence.
                 YRSequenceNumberType currentSegment = YRPacketsQueueGetBaseSegment(sendQueue);
-                YRPacketsQueueAdvanceBaseSegment(sendQueue, rcvAckNumber - currentSegment);
+                YRSequenceNumberType acknowledgedCount = rcvAckNumber + 1 - currentSegment;
+                YRSequenceNumberType outstandingCount = session->sessionInfo.sendNextSequenceNumber - currentSegment;
                 
-                if (YRPacketsQueueBuffersInUse(sendQueue) == 0) {
-                    // TODO: Cancel retransmission timer.
+                // Stale (reordered) ACK or one for segment that was never sent would flush queue, ignore it.
+                if (acknowledgedCount <= outstandingCount) {
+                    session->sessionInfo.sendLatestUnackSegment = rcvAckNumber + 1;
+                    
+                    int32_t roundTripTime = -1;
+                    uint16_t segmentsInUse = YRPacketsQueueBuffersInUse(sendQueue);
+                    
+                    if (YRPacketsQueueIsBufferInUseForSegment(sendQueue, rcvAckNumber)) {
+                        YRSessionSendOperationRef operation = YRPacketsQueueBufferForSegment(sendQueue, rcvAckNumber);
+                        
+                        roundTripTime = YRSessionSampleRoundTripTimeForOperation(session, operation);
+                    }
+                    
+                    // Acknowledged segment itself is released too.
+                    YRPacketsQueueAdvanceBaseSegment(sendQueue, acknowledgedCount);
+                    
+                    YRCongestionControlOnAck(&session->congestionControl,
+                                             segmentsInUse - YRPacketsQueueBuffersInUse(sendQueue),
+                                             roundTripTime);
+                    
+                    if (session->isInRecovery && YRSessionIsSequenceAfterOrEqual(rcvAckNumber, session->recoveryPoint)) {
+                        session->isInRecovery = false;
+                    }
+                    
+                    if (YRPacketsQueueBuffersInUse(sendQueue) == 0) {
+                        YRSessionCancelTimer(session, &session->retransmissionTimer);
+                    }
                 }
             }
             
@@ -537,73 +727,113 @@ void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType l
                 YRPacketHeaderEACKRef receivedEACKHeader = (YRPacketHeaderEACKRef)receivedHeader;
                 YRPacketsQueueRef sendQueue = YRSessionGetSendQueue(session);
                 
+                bool hasRanges = YRSessionIsEACKRangesNegotiated(session);
                 YRSequenceNumberType eacksCount = 0;
-                YRSequenceNumberType *eacks = YRPacketHeaderGetEACKs(receivedEACKHeader, &eacksCount);
+                YRSequenceNumberType *eacks = hasRanges ? YRPacketHeaderGetEACKRanges(receivedEACKHeader, &eacksCount) :
+                                                          YRPacketHeaderGetEACKs(receivedEACKHeader, &eacksCount);
+                
+                int32_t roundTripTime = -1;
+                uint16_t segmentsInUse = YRPacketsQueueBuffersInUse(sendQueue);
+                uint16_t window = YRConnectionConfigurationGetWindow(session->remoteConnectionConfiguration);
+                
+                // One past the highest EACK'd segment relative to queue base, 0 if nothing is in window.
+                YRSequenceNumberType base = YRPacketsQueueGetBaseSegment(sendQueue);
+                uint16_t highestOffset = 0;
                 
                 for (YRSequenceNumberType i = 0; i < eacksCount; i++) {
-                    YRSequenceNumberType sequence = eacks[i];
+                    YRSequenceNumberType first = hasRanges ? eacks[2 * i] : eacks[i];
+                    YRSequenceNumberType span = hasRanges ? eacks[2 * i + 1] - first : 0;
+                    
+                    if (span >= window) {
+                        // Bogus range, no more segments than window are ever outstanding.
+                        continue;
+                    }
                     
-                    // TODO: What if we receive here eack that is really ack?
-                    YRPacketsQueueUnmarkBufferInUseForSegment(sendQueue, sequence);
+                    for (uint32_t offset = 0; offset <= span; offset++) {
+                        YRSequenceNumberType sequence = first + offset;
+                        
+                        // Segments EACK'd again count as well, they're still above holes.
+                        if (YRPacketsQueueHasBufferForSegment(sendQueue, sequence) &&
+                            (YRSequenceNumberType)(sequence - base) >= highestOffset) {
+                            highestOffset = (YRSequenceNumberType)(sequence - base) + 1;
+                        }
+                        
+                        if (!YRPacketsQueueIsBufferInUseForSegment(sendQueue, sequence)) {
+                            continue;
+                        }
+                        
+                        YRSessionSendOperationRef operation = YRPacketsQueueBufferForSegment(sendQueue, sequence);
+                        
+                        int32_t sample = YRSessionSampleRoundTripTimeForOperation(session, operation);
+                        
+                        roundTripTime = sample >= 0 ? sample : roundTripTime;
+                        
+                        // TODO: What if we receive here eack that is really ack?
+                        YRPacketsQueueUnmarkBufferInUseForSegment(sendQueue, sequence);
+                    }
+                }
+                
+                YRCongestionControlOnAck(&session->congestionControl,
+                                         segmentsInUse - YRPacketsQueueBuffersInUse(sendQueue),
+                                         roundTripTime);
+                
+                if (eacksCount > 0 && !session->isInRecovery) {
+                    // Segments received out of sequence mean that ones before them were lost.
+                    YRSessionEnterRecovery(session);
+                    YRCongestionControlOnLoss(&session->congestionControl);
                 }
                 
                 if (YRPacketsQueueBuffersInUse(sendQueue) == 0) {
-                    // TODO: Cancel retransmission timer.
+                    YRSessionCancelTimer(session, &session->retransmissionTimer);
+                } else if (highestOffset > 0) {
+                    YRSessionRetransmitLostSegments(session, base + highestOffset - 1);
+                    
+                    if (session->state != kYRSessionStateConnected) {
+                        // Send callout invalidated session.
+                        break;
+                    }
+                }
+            }
+            
+            if (session->isCloseRequested && (hasACK || hasEACK)) {
+                // Window might have opened for batch that holds close back.
+                YRSessionCompleteRequestedClose(session);
+                
+                if (session->state != kYRSessionStateConnected) {
+                    break;
+                }
+            }
+            
+            if (hasACK || hasEACK) {
+                // Window might have opened for submitted payloads too.
+                YRSessionProcessSubmissions(session);
+                
+                if (session->state != kYRSessionStateConnected) {
+                    break;
                 }
             }
             
             if (isNUL) {
-                // TODO: Next iteration: NUL segment.
-                // We must ack it if it falls into acceptance window.
-                // However we shouldn't set _rcvLatestAckedSegment to this seq number.
-                session->sessionInfo.rcvLatestAckedSegment = rcvSeqNumber;
+                // NUL occupies sequence number, so it's ordered the same way as data segments.
+                YRSessionReceiveSegment(session, receivedPacket, payload, length);
                 YRSessionDoACKOrEACK(session);
                 break;
             }
             
             if (YRPacketHeaderHasPayloadLength(receivedHeader) &&
                 YRPacketHeaderGetPayloadLength((YRPacketPayloadHeaderRef)receivedHeader) > 0) {
-                if (rcvSeqNumber == expectedToReceive) {
-                    session->sessionInfo.rcvLatestAckedSegment = rcvSeqNumber;
-                    
-                    // Do callout with data.
-                    YRPayloadLengthType payloadLength = 0;
-                    void *rawPayload = YRPacketGetPayload(receivedPacket, &payloadLength);
-                    
-                    !session->callbacks.receiveCallout ?: session->callbacks.receiveCallout(session, rawPayload, payloadLength);
-                    
-                    YRSessionProcessOutOfSequencePacketsIfAny(session);
-                } else {
-                    if (!YRPacketsQueueIsBufferInUseForSegment(receiveQueue, rcvSeqNumber)) {
-                        // Buffer data
-                        // snd: EAK
-                        YRPacketCopyPayloadInline(receivedPacket);
-                        
-                        void *buffer = YRPacketsQueueBufferForSegment(receiveQueue, rcvSeqNumber);
-                        
-                        //                        assert(buffer);
-                        
-                        if (buffer) {
-                            // This MUST be true always
-                            // Move packet to heap
-                            YRPacketCopy(receivedPacket, buffer);
-                            
-                            YRPacketsQueueMarkBufferInUseForSegment(receiveQueue, rcvSeqNumber);
-                        }
-                    } else {
-                        // Received duplicated out of sequence segment, ignore.
-                    }
-                }
+                // Segments that fill a gap are acknowledged right away, so peer learns about recovery sooner.
+                bool isUrgent = rcvSeqNumber != expectedToReceive || YRPacketsQueueBuffersInUse(receiveQueue) > 0;
                 
-                YRSessionDoACKOrEACK(session);
+                YRSessionReceiveSegment(session, receivedPacket, payload, length);
+                
+                YRSessionScheduleACK(session, isUrgent);
             }
         }
             break;
         case kYRSessionStateDisconnecting:
             if (isRST) {
-                //                [_disconnectingTimer invalidate];
-                
-                YRSessionTransiteToState(session, kYRSessionStateClosed);
+                YRSessionInvalidateConnection(session);
             }
             break;
         default:
@@ -611,28 +841,178 @@ void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType l
             //            NSAssert(NO, @"Can't handle incoming packet because state is not defined: %d", self.state);
             break;
     }
-    
-    YRPacketDestroy(receivedPacket);
 }
 
-void YRSessionSend(YRSessionRef session, void *payload, YRPayloadLengthType length) {
+bool YRSessionSend(YRSessionRef session, void *payload, YRPayloadLengthType length) {
     //    [_sessionLogger logInfo:@"[SEND_REQ] (%@)", [self humanReadableState:self.state]];
     
-    if (length == 0) {
-        // TODO: error: payload is empty
+    if (length == 0 || session->state != kYRSessionStateConnected || session->isCloseRequested) {
+        return false;
+    }
+    
+    if (YRSessionIsBatchingNegotiated(session)) {
+        // Message is too big or no space available.
+        return YRSessionAppendToBatch(session, payload, length);
+    }
+    
+    if (length > YRSessionGetMaximumPayloadLength(session) || !YRSessionCanSend(session)) {
+        return false;
+    }
+    
+    return YRSessionSendSegmentWithPayload(session, payload, length);
+}
+
+void YRSessionFlush(YRSessionRef session) {
+    if (session->batchLength == 0 || session->state != kYRSessionStateConnected) {
         return;
     }
     
-    if (session->state == kYRSessionStateConnected) {
-        if (YRSessionCanSend(session)) {
-            YRSessionDoReliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
-                YRPacketCreateWithPayload(seqNumber, ackNumber, payload, length, true, packetBuffer);
-            }, YRPacketLengthForPayload(length));
+    if (!YRSessionCanSend(session)) {
+        // Window is full, batch is retried on timeout or by the next flush.
+        YRSessionScheduleBatchingTimerIfNeeded(session);
+        return;
+    }
+    
+    YRPayloadLengthType batchLength = session->batchLength;
+    
+    YRSessionCancelTimer(session, &session->batchingTimer);
+    
+    // Batch is copied into send queue before send callout, which may already start the next one.
+    session->batchLength = 0;
+    
+    if (!YRSessionSendSegmentWithPayload(session, session->batch, batchLength)) {
+        // Nothing was sent, so send callout didn't touch batch.
+        session->batchLength = batchLength;
+        YRSessionScheduleBatchingTimerIfNeeded(session);
+    }
+}
+
+bool YRSessionSubmit(YRSessionRef session, const void *payload, YRPayloadLengthType length, bool *outShouldWakeOwner) {
+    YRSubmissionRingRef submissions = __atomic_load_n(&session->submissions, __ATOMIC_ACQUIRE);
+    
+    // Ring rejects payloads bigger than its slots, those wouldn't fit into a segment anyway.
+    if (length == 0 || !submissions) {
+        return false;
+    }
+    
+    return YRSubmissionRingPushCopy(submissions, payload, length, outShouldWakeOwner);
+}
+
+uint32_t YRSessionProcessSubmissions(YRSessionRef session) {
+    YRSubmissionRingRef submissions = session->submissions;
+    uint32_t processed = 0;
+    void *payload = NULL;
+    uint32_t length = 0;
+    
+    if (!submissions) {
+        return 0;
+    }
+    
+    // Whatever doesn't fit into window waits in ring, so producers feel backpressure once it's full.
+    while (session->state == kYRSessionStateConnected &&
+           YRSessionCanSend(session) &&
+           YRSubmissionRingPeek(submissions, &payload, &length)) {
+        // Payload lives in ring's slot, it's released only after send copied it.
+        if (YRSessionSend(session, payload, length)) {
+            processed++;
         } else {
-            // TODO: error: no space available
+            session->droppedSubmissionsCount++;
+        }
+        
+        YRSubmissionRingPop(submissions);
+    }
+    
+    return processed;
+}
+
+uint32_t YRSessionGetDroppedSubmissionsCount(YRSessionRef session) {
+    return session->droppedSubmissionsCount;
+}
+
+#pragma mark - Receiving
+
+void YRSessionReceiveSegment(YRSessionRef session, YRPacketRef packet, const void *datagram, YRPayloadLengthType length) {
+    YRPacketsQueueRef receiveQueue = YRSessionGetReceiveQueue(session);
+    YRSequenceNumberType sequence = YRPacketHeaderGetSequenceNumber(YRPacketGetHeader(packet));
+    
+    if (sequence == (YRSequenceNumberType)(session->sessionInfo.rcvLatestAckedSegment + 1)) {
+        session->sessionInfo.rcvLatestAckedSegment = sequence;
+        
+        YRSessionDeliverPayload(session, packet);
+        YRSessionProcessOutOfSequencePacketsIfAny(session);
+    } else if (YRPacketsQueueHasBufferForSegment(receiveQueue, sequence) &&
+               !YRPacketsQueueIsBufferInUseForSegment(receiveQueue, sequence)) {
+        // Datagram is owned by caller, so out of sequence segment is the only one that is copied.
+        YRSessionReceiveOperationRef operation = YRPacketsQueueBufferForSegment(receiveQueue, sequence);
+        
+        if (!operation) {
+            // Out of memory, peer will retransmit it.
+            return;
         }
+        
+        memcpy(operation->bytes, datagram, length);
+        operation->length = length;
+        
+        YRPacketsQueueMarkBufferInUseForSegment(receiveQueue, sequence);
+    } else {
+        // Received duplicated out of sequence segment, ignore.
+    }
+}
+
+void YRSessionDeliverPayload(YRSessionRef session, YRPacketRef packet) {
+    YRPayloadLengthType payloadLength = 0;
+    void *rawPayload = YRPacketGetPayload(packet, &payloadLength);
+    
+    if (!rawPayload) {
+        return;
+    }
+    
+    if (YRSessionIsBatchingNegotiated(session)) {
+        YRSessionDeliverBatch(session, rawPayload, payloadLength);
     } else {
-        // TODO: error: not connected
+        // Payload is borrowed: it points into datagram and is valid only during callout.
+        !session->callbacks.receiveCallout ?: session->callbacks.receiveCallout(session, rawPayload, payloadLength);
+    }
+}
+
+void YRSessionDeliverBatch(YRSessionRef session, const uint8_t *batch, YRPayloadLengthType length) {
+    YRPacketsQueueRef receiveQueue = session->receiveQueue;
+    YRPayloadLengthType offset = 0;
+    
+    while (length - offset >= kYRSessionBatchedMessageHeaderLength && session->callbacks.receiveCallout) {
+        YRPayloadLengthType messageLength = 0;
+        
+        memcpy(&messageLength, batch + offset, sizeof(messageLength));
+        
+        messageLength = ntohs(messageLength);
+        offset += kYRSessionBatchedMessageHeaderLength;
+        
+        if (messageLength == 0 || messageLength > length - offset) {
+            // Malformed batch, the rest of segment can't be trusted.
+            break;
+        }
+        
+        // Every message is borrowed the same way as whole payload.
+        session->callbacks.receiveCallout(session, batch + offset, messageLength);
+        
+        offset += messageLength;
+        
+        if (session->receiveQueue != receiveQueue) {
+            // Connection was invalidated by callout.
+            break;
+        }
+    }
+}
+
+void YRSessionDeliverDatagram(YRSessionRef session, const void *datagram, YRPayloadLengthType length) {
+    uint8_t bufferForStream[kYRLightweightInputStreamSize] __attribute__ ((__aligned__(sizeof(uintptr_t))));
+    YRLightweightInputStreamRef stream = YRLightweightInputStreamCreateAt(datagram, length, bufferForStream);
+    
+    uint8_t bufferForPacket[YRPacketDeserializedLengthForStream(stream)] __attribute__ ((__aligned__(8)));
+    YRPacketRef packet = YRPacketDeserializeAt(stream, bufferForPacket);
+    
+    if (packet) {
+        YRSessionDeliverPayload(session, packet);
     }
 }
 
@@ -657,7 +1037,26 @@ YRConnectionConfiguration YRSessionGetRemoteConnectionInfo(YRSessionRef session)
 #pragma mark - Private
 
 void YRSessionInvalidateConnection(YRSessionRef session) {
-    // TODO: Clean-up all packets to be sent, remove all timers, delete remote configuration and do callout.
+    YRSessionCancelTimers(session);
+    // Capacity depends on remote configuration, so batch goes first.
+    YRSessionDiscardBatch(session);
+    session->isCloseRequested = false;
+    
+    YRPacketsQueueDestroy(session->sendQueue);
+    YRPacketsQueueDestroy(session->receiveQueue);
+    
+    session->sendQueue = NULL;
+    session->receiveQueue = NULL;
+    
+    memset(&session->remoteConnectionConfiguration, 0, sizeof(YRConnectionConfiguration));
+    memset(&session->sessionInfo, 0, sizeof(YRSessionInfo));
+    
+    session->shouldKeepAlive = false;
+    session->synRetransmissions = 0;
+    session->isInRecovery = false;
+    
+    YRSessionResetRoundTripTimeEstimation(session);
+    YRSessionTransiteToState(session, kYRSessionStateClosed);
 }
 
 void YRSessionSetCallbacks(YRSessionRef session, YRSessionCallbacks callbacks) {
@@ -690,12 +1089,22 @@ void YRSessionSetCallbacks(YRSessionRef session, YRSessionCallbacks callbacks) {
 
 YRPacketsQueueRef YRSessionGetSendQueue(YRSessionRef session) {
     if (!session->sendQueue && session->remoteConnectionConfiguration.maximumSegmentSize > 0) {
-        session->sendQueue = YRPacketsQueueCreate(session->remoteConnectionConfiguration.maximumSegmentSize,
-                                                  session->remoteConnectionConfiguration.maxNumberOfOutstandingSegments);
+        size_t bufferSize = sizeof(YRSessionSendOperation) + YRSessionGetSendOperationCapacity(session);
+        
+        session->sendQueue = YRSessionCreateQueue(bufferSize,
+                                                  YRConnectionConfigurationGetWindow(session->remoteConnectionConfiguration));
         
         // assert send queue, or do graceful fallback EVERYWHERE
         
         YRPacketsQueueSetBaseSegment(session->sendQueue, session->sessionInfo.sendNextSequenceNumber);
+        
+        YRCongestionControlInit(&session->congestionControl,
+                                session->congestionControlAlgorithm,
+                                YRConnectionConfigurationGetWindow(session->remoteConnectionConfiguration));
+        
+        session->nextSegmentToTransmit = session->sessionInfo.sendNextSequenceNumber;
+        session->pacingCredit = kYRSessionPacingBurst * kYRSessionPacingCreditPerSegment;
+        session->pacingUpdateTime = session->timerWheel ? YRTimerWheelGetTime(session->timerWheel) : 0;
     }
     
     return session->sendQueue;
@@ -703,8 +1112,8 @@ YRPacketsQueueRef YRSessionGetSendQueue(YRSessionRef session) {
 
 YRPacketsQueueRef YRSessionGetReceiveQueue(YRSessionRef session) {
     if (!session->receiveQueue && session->localConnectionConfiguration.maximumSegmentSize > 0) {
-        session->receiveQueue = YRPacketsQueueCreate(session->localConnectionConfiguration.maximumSegmentSize,
-                                                     session->localConnectionConfiguration.maxNumberOfOutstandingSegments);
+        session->receiveQueue = YRSessionCreateQueue(sizeof(YRSessionReceiveOperation) + session->localConnectionConfiguration.maximumSegmentSize,
+                                                     YRConnectionConfigurationGetWindow(session->localConnectionConfiguration));
         
         // assert receive queue, or do graceful fallback EVERYWHERE
         
@@ -716,88 +1125,272 @@ YRPacketsQueueRef YRSessionGetReceiveQueue(YRSessionRef session) {
     return session->receiveQueue;
 }
 
-void YRSessionTransiteToState(YRSessionRef session, YRSessionState state) {
-    if (session->state != state) {
-        session->state = state;
-        
-        !session->callbacks.connectionStateCallout ?: session->callbacks.connectionStateCallout(session, state);
+void YRSessionCreateSubmissionsIfNeeded(YRSessionRef session) {
+    if (session->submissions) {
+        return;
     }
-}
-
-void YRSessionSchedulePacketSendReliably(YRSessionRef session, YRPacketRef packet) {
-    YRPacketCopyPayloadInline(packet);
     
-    //    YRSequenceNumberType seqNumber = YRPacketHeaderGetSequenceNumber(YRPacketGetHeader(packet));
-    //    YRSendOperation *operation = [[YRSendOperation alloc] initWithPacket:packet sequenceNumber:seqNumber];
-    //
-    //    if ([_sendQueue[seqNumber] isKindOfClass:[YRSendOperation class]]) {
-    //        [_sendQueue[seqNumber] end];
-    //    }
-    //
-    //    _sendQueue[seqNumber] = operation;
-    //
-    //    [operation start];
-    //
-    //    __typeof(self) __weak weakSelf = self;
-    //    __typeof(YRLogger *) __weak weakLogger = _sessionLogger;
-    //
-    //    operation.onTransmissionTimeout = ^(YRSendOperation *operation) {
-    //        [weakLogger logInfo:@"[SEND_TIM]: Header: %@.", [YRDebugUtils packetHeaderShortDescription:YRPacketGetHeader(packet)]];
-    //
-    //        [operation start];
-    //        [weakSelf sendDataFromPacket:operation.packet];
-    //    };
-    //
-    //    [_sessionLogger logInfo:@"[SEND_REL]: Header: %@", [YRDebugUtils packetHeaderShortDescription:YRPacketGetHeader(operation.packet)]];
-    //
-    //    [self sendDataFromPacket:packet];
+    // Slots fit the largest payload both sides allow, so producers check length without touching session
+    // and ring stays small when either side's segments are.
+    YRPayloadLengthType headerLength = YRMakeMultipleTo(kYRPacketPayloadHeaderLength, 8);
+    YRPayloadLengthType localMaximumSegmentSize = session->localConnectionConfiguration.maximumSegmentSize;
+    YRPayloadLengthType localMaximumPayloadLength = localMaximumSegmentSize > headerLength ? localMaximumSegmentSize - headerLength : 0;
+    YRPayloadLengthType elementSize = YRSessionGetMaximumPayloadLength(session);
+    
+    elementSize = elementSize < localMaximumPayloadLength ? elementSize : localMaximumPayloadLength;
+    
+    if (elementSize == 0) {
+        return;
+    }
+    
+    // Published for producers on other threads.
+    __atomic_store_n(&session->submissions, YRSubmissionRingCreateWithElementSize(kYRSessionSubmissionsCapacity, elementSize), __ATOMIC_RELEASE);
 }
 
-void YRSessionProcessOutOfSequencePacketsIfAny(YRSessionRef session) {
-    //    YRSequenceNumberType nextSegment = _rcvLatestAckedSegment + 1;
-    //    id operation = _receiveQueue[nextSegment];
-    //
-    //    while ([operation isKindOfClass:[YRReceiveOperation class]]) {
-    //        _rcvLatestAckedSegment = nextSegment;
-    //
-    //        YRReceiveOperation *outOfSeqOperation = operation;
-    //        YRPacketRef packet = outOfSeqOperation.packet;
-    //
-    //        // Do callout with data.
-    //        YRPayloadLengthType payloadLength = 0;
-    //        void *rawPayload = YRPacketGetPayload(packet, &payloadLength);
-    //
-    //        if (rawPayload) {
-    //            NSData *rawPacketData = [NSData dataWithBytesNoCopy:rawPayload length:payloadLength freeWhenDone:NO];
-    //
-    //            !_sessionContext.receiveCallout ?: _sessionContext.receiveCallout(self, rawPacketData);
-    //        }
-    //
-    //        _receiveQueue[nextSegment] = [NSNull null];
-    //        [_outOfSequenceSegmentsReceived removeObject:@(nextSegment)];
-    //
-    //        nextSegment++;
-    //
-    //        operation = _receiveQueue[nextSegment];
-    //    }
+void YRSessionDiscardSubmissions(YRSessionRef session) {
+    // Payloads live in ring's own storage.
+    YRSubmissionRingDestroy(session->submissions);
+    session->submissions = NULL;
 }
 
-#pragma mark - ACK'ing
+YRPayloadLengthType YRSessionGetBatchCapacity(YRSessionRef session) {
+    // Batch leaves as one segment, so it's limited the same way as unbatched payload.
+    return YRSessionGetMaximumPayloadLength(session);
+}
 
-void YRSessionDoACKOrEACK(YRSessionRef session) {
-    if (session->receiveQueue && YRPacketsQueueBuffersInUse(session->receiveQueue) > 0) {
-        YRSequenceNumberType outOfSequenceReceived = YRPacketsQueueBuffersInUse(session->receiveQueue);
-        YRPayloadLengthType packetLength = YRPacketEACKLength(&outOfSequenceReceived);
+bool YRSessionAppendToBatch(YRSessionRef session, const void *payload, YRPayloadLengthType length) {
+    size_t capacity = YRSessionGetBatchCapacity(session);
+    size_t messageLength = kYRSessionBatchedMessageHeaderLength + (size_t)length;
+    
+    if (messageLength > capacity) {
+        return false;
+    }
+    
+    if (session->batchLength + messageLength > capacity) {
+        YRSessionFlush(session);
         
-        YRSessionDoUnreliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
-            uint8_t outOfSeqReceivedSmallInt = YRPacketsQueueBuffersInUse(session->receiveQueue);
-            YRSequenceNumberType outOfSeq[outOfSeqReceivedSmallInt];
-            
-            YRPacketsQueueGetSegmentNumbersForBuffersInUse(session->receiveQueue, outOfSeq, &outOfSeqReceivedSmallInt);
-            YRSequenceNumberType outOfSeqReceived = outOfSeqReceivedSmallInt;
-            
-            YRPacketCreateEACK(seqNumber, ackNumber, outOfSeq, &outOfSeqReceived, packetBuffer);
-        }, packetLength);
+        if (session->batchLength > 0) {
+            // Window is full and batch is still pending.
+            return false;
+        }
+    }
+    
+    if (!session->batch) {
+        session->batch = YRBufferPoolAcquire(capacity);
+        
+        if (!session->batch) {
+            return false;
+        }
+    }
+    
+    YRPayloadLengthType networkLength = htons(length);
+    
+    memcpy(session->batch + session->batchLength, &networkLength, sizeof(networkLength));
+    memcpy(session->batch + session->batchLength + kYRSessionBatchedMessageHeaderLength, payload, length);
+    
+    session->batchLength += messageLength;
+    
+    if (capacity - session->batchLength <= kYRSessionBatchedMessageHeaderLength) {
+        // Not even one byte message fits anymore.
+        YRSessionFlush(session);
+    } else {
+        YRSessionScheduleBatchingTimerIfNeeded(session);
+    }
+    
+    return true;
+}
+
+void YRSessionScheduleBatchingTimerIfNeeded(YRSessionRef session) {
+    uint16_t timeout = session->localConnectionConfiguration.batchingTimeoutValue;
+    
+    // Deadline is counted from the oldest message in batch.
+    if (timeout > 0 && !YRTimerIsScheduled(&session->batchingTimer)) {
+        YRSessionScheduleTimer(session, &session->batchingTimer, timeout);
+    }
+}
+
+void YRSessionDiscardBatch(YRSessionRef session) {
+    if (session->batch) {
+        YRBufferPoolRelease(session->batch, YRSessionGetBatchCapacity(session));
+    }
+    
+    session->batch = NULL;
+    session->batchLength = 0;
+}
+
+void YRSessionCompleteRequestedClose(YRSessionRef session) {
+    if (!session->isCloseRequested || session->state != kYRSessionStateConnected) {
+        return;
+    }
+    
+    // Batched messages precede RST.
+    YRSessionFlush(session);
+    
+    if (session->batchLength > 0 || !YRSessionCanSend(session)) {
+        // Window is full, close is completed by ACK that opens it or by batching timeout.
+        return;
+    }
+    
+    session->isCloseRequested = false;
+    
+    // RST is queued while still connected so it's retransmitted like any other segment.
+    YRSessionDoReliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
+        YRPacketCreateRST(0, seqNumber, ackNumber, true, packetBuffer);
+    }, YRPacketRSTLength());
+    
+    // Arms disconnect timer.
+    YRSessionTransiteToState(session, kYRSessionStateDisconnecting);
+}
+
+YRPacketsQueueRef YRSessionCreateQueue(size_t bufferSize, uint16_t window) {
+    // Buffers come from process-wide pool only for stored segments, so idle sessions hold no payload memory.
+    return YRPacketsQueueCreateWithOptions(bufferSize,
+                                           window,
+                                           kYRSessionQueueBufferAlignment,
+                                           kYRPacketsQueueOptionPooled);
+}
+
+void YRSessionTransiteToState(YRSessionRef session, YRSessionState state) {
+    if (session->state != state) {
+        session->state = state;
+        
+        if (state == kYRSessionStateConnected) {
+            // Before state callout, so it may submit already.
+            YRSessionCreateSubmissionsIfNeeded(session);
+        }
+        
+        YRSessionUpdateTimersForState(session);
+        
+        !session->callbacks.connectionStateCallout ?: session->callbacks.connectionStateCallout(session, state);
+    }
+}
+
+void YRSessionProcessOutOfSequencePacketsIfAny(YRSessionRef session) {
+    // Receive callout may invalidate session, queue mustn't be recreated then.
+    YRPacketsQueueRef receiveQueue = session->receiveQueue;
+    
+    if (!receiveQueue) {
+        return;
+    }
+    
+    // Latest acked segment was just advanced, so receive queue base is next expected segment now.
+    while (YRPacketsQueueIsBufferInUseForSegment(receiveQueue, session->sessionInfo.rcvLatestAckedSegment + 1)) {
+        YRSessionReceiveOperationRef operation = YRPacketsQueueBufferForSegment(receiveQueue,
+                                                                                session->sessionInfo.rcvLatestAckedSegment + 1);
+        
+        session->sessionInfo.rcvLatestAckedSegment++;
+        
+        YRSessionDeliverDatagram(session, operation->bytes, operation->length);
+        
+        if (session->receiveQueue != receiveQueue) {
+            return;
+        }
+        
+        YRPacketsQueueAdvanceBaseSegment(receiveQueue, 1);
+    }
+    
+    // Restore invariant: queue base is the one after next expected segment.
+    YRPacketsQueueAdvanceBaseSegment(receiveQueue, 1);
+}
+
+#pragma mark - Integrity
+
+bool YRSessionIsCRC32CNegotiated(YRSessionRef session) {
+    // Remote configuration is zeroed till its SYN is received.
+    uint16_t options = session->localConnectionConfiguration.options & session->remoteConnectionConfiguration.options;
+    
+    return (options & kYRConnectionOptionCRC32C) != 0;
+}
+
+bool YRSessionIsUsingCRC32CForHeader(YRSessionRef session, YRPacketHeaderRef header) {
+    // SYN and RST may cross with peer's SYN before options are known on both sides.
+    if (YRPacketHeaderIsSYN(header) || YRPacketHeaderIsRST(header)) {
+        return false;
+    }
+    
+    return YRSessionIsCRC32CNegotiated(session);
+}
+
+bool YRSessionIsHeaderOnlyChecksumNegotiated(YRSessionRef session) {
+    uint16_t options = session->localConnectionConfiguration.options & session->remoteConnectionConfiguration.options;
+    
+    return (options & kYRConnectionOptionHeaderOnlyChecksum) != 0;
+}
+
+bool YRSessionShouldChecksumPayload(YRSessionRef session) {
+    // CRC32C replaces ones' complement checksum on wire, summing payload for it would be wasted.
+    return !YRSessionIsHeaderOnlyChecksumNegotiated(session) && !YRSessionIsCRC32CNegotiated(session);
+}
+
+bool YRSessionIsEACKRangesNegotiated(YRSessionRef session) {
+    uint16_t options = session->localConnectionConfiguration.options & session->remoteConnectionConfiguration.options;
+    
+    return (options & kYRConnectionOptionEACKRanges) != 0;
+}
+
+bool YRSessionIsBatchingNegotiated(YRSessionRef session) {
+    uint16_t options = session->localConnectionConfiguration.options & session->remoteConnectionConfiguration.options;
+    
+    return (options & kYRConnectionOptionBatching) != 0;
+}
+
+bool YRSessionIsReceivedPacketValid(YRSessionRef session, YRPacketRef packet, const void *datagram, YRPayloadLengthType length) {
+    YRPacketHeaderRef header = YRPacketGetHeader(packet);
+    
+    if (YRSessionIsUsingCRC32CForHeader(session, header)) {
+        return YRPacketSerializedHasValidCRC32C(datagram, length) && YRPacketIsLogicallyValidIgnoringChecksum(packet);
+    }
+    
+    if (!YRPacketHeaderHasCHK(header) && !YRSessionIsHeaderOnlyChecksumNegotiated(session)) {
+        YRPayloadLengthType payloadLength = 0;
+        
+        YRPacketGetPayload(packet, &payloadLength);
+        
+        if (payloadLength > 0) {
+            // Peer didn't agree to leave payload unprotected.
+            return false;
+        }
+    }
+    
+    return YRPacketIsLogicallyValid(packet);
+}
+
+#pragma mark - ACK'ing
+
+void YRSessionDoACKOrEACK(YRSessionRef session) {
+    YRSessionCancelTimer(session, &session->cumulativeAckTimer);
+    
+    session->sentAckNumber = session->sessionInfo.rcvLatestAckedSegment;
+    
+    if (session->receiveQueue && YRPacketsQueueBuffersInUse(session->receiveQueue) > 0 && YRSessionIsEACKRangesNegotiated(session)) {
+        // There can't be more ranges than segments, actual count is known only after bitmap is walked.
+        YRSequenceNumberType rangesCount = YRPacketsQueueBuffersInUse(session->receiveQueue);
+        YRPayloadLengthType packetLength = YRPacketEACKRangesLength(&rangesCount);
+        
+        YRSessionDoUnreliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
+            // Ranges closest to ack number come first, so those that don't fit into header are the least urgent ones.
+            uint16_t rangesSmallInt = rangesCount;
+            YRSequenceNumberType ranges[2 * rangesSmallInt];
+            
+            YRPacketsQueueGetSegmentRangesForBuffersInUse(session->receiveQueue, ranges, &rangesSmallInt);
+            YRSequenceNumberType rangesReceived = rangesSmallInt;
+            
+            YRPacketCreateEACKRanges(seqNumber, ackNumber, ranges, &rangesReceived, packetBuffer);
+        }, packetLength);
+    } else if (session->receiveQueue && YRPacketsQueueBuffersInUse(session->receiveQueue) > 0) {
+        YRSequenceNumberType outOfSequenceReceived = YRPacketsQueueBuffersInUse(session->receiveQueue);
+        YRPayloadLengthType packetLength = YRPacketEACKLength(&outOfSequenceReceived);
+        
+        YRSessionDoUnreliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
+            // Only as many as fit into EACK header.
+            uint16_t outOfSeqReceivedSmallInt = outOfSequenceReceived;
+            YRSequenceNumberType outOfSeq[outOfSeqReceivedSmallInt];
+            
+            YRPacketsQueueGetSegmentNumbersForBuffersInUse(session->receiveQueue, outOfSeq, &outOfSeqReceivedSmallInt);
+            YRSequenceNumberType outOfSeqReceived = outOfSeqReceivedSmallInt;
+            
+            YRPacketCreateEACK(seqNumber, ackNumber, outOfSeq, &outOfSeqReceived, packetBuffer);
+        }, packetLength);
     } else {
         // We don't have receive queue yet, so do simple ack
         YRSessionDoUnreliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
@@ -806,28 +1399,80 @@ void YRSessionDoACKOrEACK(YRSessionRef session) {
     }
 }
 
+void YRSessionScheduleACK(YRSessionRef session, bool isUrgent) {
+    if (session->state != kYRSessionStateConnected) {
+        // Receive callout closed session.
+        return;
+    }
+    
+    YRConnectionConfiguration configuration = session->localConnectionConfiguration;
+    YRSequenceNumberType segmentsToAcknowledge = session->sessionInfo.rcvLatestAckedSegment - session->sentAckNumber;
+    
+    // EACK tells about out of sequence segments, so it's never delayed.
+    bool hasOutOfSequenceSegments = session->receiveQueue && YRPacketsQueueBuffersInUse(session->receiveQueue) > 0;
+    bool canDelay = configuration.maxCumulativeAck > 0 && configuration.cumulativeAckTimeoutValue > 0 && session->timerWheel;
+    
+    if (!isUrgent && !hasOutOfSequenceSegments) {
+        if (segmentsToAcknowledge == 0) {
+            // Already piggybacked on data sent from receive callout.
+            return;
+        }
+        
+        if (canDelay && segmentsToAcknowledge < configuration.maxCumulativeAck) {
+            // Timer isn't re-armed, so the oldest unacknowledged segment waits for timeout at most.
+            if (!YRTimerIsScheduled(&session->cumulativeAckTimer)) {
+                YRSessionScheduleTimer(session, &session->cumulativeAckTimer, configuration.cumulativeAckTimeoutValue);
+            }
+            
+            return;
+        }
+    }
+    
+    YRSessionDoACKOrEACK(session);
+}
+
 #pragma mark - Sending
 
-void YRSessionDoReliableSend(YRSessionRef session, YRPacketBuilder packetBuilder, YRPayloadLengthType packetLength) {
-    YRSessionDoReliableSendWithAutoIncrement(session, packetBuilder, packetLength, true);
+bool YRSessionDoReliableSend(YRSessionRef session, YRPacketBuilder packetBuilder, YRPayloadLengthType packetLength) {
+    return YRSessionDoReliableSendWithAutoIncrement(session, packetBuilder, packetLength, true);
 }
 
-void YRSessionDoReliableSendWithAutoIncrement(YRSessionRef session,
+bool YRSessionDoReliableSendWithAutoIncrement(YRSessionRef session,
                                               YRPacketBuilder packetBuilder,
                                               YRPayloadLengthType packetLength,
                                               bool increment) {
     if (session->state == kYRSessionStateConnected) {
         YRPacketsQueueRef queue = YRSessionGetSendQueue(session);
         
-        //        if (packetLength > // buffer size in queue) {
-        //            // Can't send packet because packet length exceeds maximum payload size to be received by remote
-        //            return;
-        //        }
+        if (!queue) {
+            // Out of memory.
+            return false;
+        }
         
-        void *buffer = YRPacketsQueueBufferForSegment(queue, session->sessionInfo.sendNextSequenceNumber);
+        YRSequenceNumberType segment = session->sessionInfo.sendNextSequenceNumber;
+        YRSessionSendOperationRef operation = YRPacketsQueueBufferForSegment(queue, segment);
         
-        if (buffer) {
-            packetBuilder(buffer, session->sessionInfo.sendNextSequenceNumber, session->sessionInfo.rcvLatestAckedSegment);
+        if (operation) {
+            uint8_t packetBuffer[packetLength] __attribute__ ((__aligned__(8)));
+            
+            packetBuilder(packetBuffer, segment, session->sessionInfo.rcvLatestAckedSegment);
+            
+            // Serialize only into space operation really has.
+            size_t capacity = YRPacketsQueueGetBufferSize(queue) - sizeof(YRSessionSendOperation);
+            
+            operation->length = YRPacketSerializeAt((YRPacketRef)packetBuffer,
+                                                    operation->bytes,
+                                                    capacity < UINT16_MAX ? (YRPayloadLengthType)capacity : UINT16_MAX);
+            
+            if (operation->length == 0 || operation->length > session->remoteConnectionConfiguration.maximumSegmentSize) {
+                // Packet exceeds maximum segment size of remote.
+                return false;
+            }
+            
+            operation->sendTime = 0;
+            operation->retransmissions = 0;
+            operation->isPending = true;
+            operation->isFastRetransmitted = false;
             
             YRPacketsQueueMarkBufferInUseForSegment(queue, session->sessionInfo.sendNextSequenceNumber);
             
@@ -836,13 +1481,22 @@ void YRSessionDoReliableSendWithAutoIncrement(YRSessionRef session,
             }
         } else {
             // Insufficient space to store data for sending!
-            return;
+            return false;
         }
         
-        // Copy payload if any as we're going to send reliably
-        YRPacketCopyPayloadInline((YRPacketRef)buffer);
+        // Segments leave in order: new one waits if others are queued by pacer already.
+        if (session->nextSegmentToTransmit == segment && YRSessionTakePacingCredit(session)) {
+            session->nextSegmentToTransmit = session->sessionInfo.sendNextSequenceNumber;
+            
+            YRSessionTransmitOperation(session, operation);
+        } else {
+            YRSessionSchedulePacingTimer(session);
+        }
         
-        YRSessionSendPacket(session, (YRPacketRef)buffer);
+        if (session->shouldKeepAlive) {
+            // Connection isn't idle anymore, postpone NUL segment.
+            YRSessionScheduleNullSegmentTimer(session);
+        }
     } else {
         // This branch is exclusively taken when we're not connected and that means only SYN segment will hit this.
         uint8_t buffer[packetLength] __attribute__ ((__aligned__(8)));
@@ -850,7 +1504,19 @@ void YRSessionDoReliableSendWithAutoIncrement(YRSessionRef session,
         packetBuilder(buffer, session->sessionInfo.sendNextSequenceNumber, session->sessionInfo.rcvLatestAckedSegment);
         
         YRSessionSendPacket(session, (YRPacketRef)buffer);
+        
+        if (increment) {
+            // SYN occupies sequence number, so peer expects the first segment after it.
+            session->sessionInfo.sendNextSequenceNumber++;
+        }
+        
+        // SYN is rebuilt on retransmission, see YRSessionResendSYN.
+        session->synRetransmissions = 0;
+        session->synSendTime = session->timerWheel ? YRTimerWheelGetTime(session->timerWheel) : 0;
+        YRSessionScheduleRetransmissionTimerIfNeeded(session);
     }
+    
+    return true;
 }
 
 void YRSessionDoUnreliableSend(YRSessionRef session, YRPacketBuilder packetBuilder, YRPayloadLengthType packetLength) {
@@ -864,12 +1530,505 @@ void YRSessionDoUnreliableSend(YRSessionRef session, YRPacketBuilder packetBuild
 void YRSessionSendPacket(YRSessionRef session, YRPacketRef packet) {
     YRPayloadLengthType packetLength = YRPacketGetLength(packet);
     
-    uint8_t outputStreamBuffer[kYRLightweightOutputStreamSize] __attribute__ ((__aligned__(sizeof(uintptr_t))));
     uint8_t packetBuffer[packetLength] __attribute__ ((__aligned__(8)));
     
-    YRLightweightOutputStreamRef outputStream = YRLightweightOutputStreamCreateAt(packetBuffer, packetLength, outputStreamBuffer);
+    packetLength = YRPacketSerializeAt(packet, packetBuffer, packetLength);
     
-    YRPacketSerialize(packet, outputStream);
+    if (YRSessionIsUsingCRC32CForHeader(session, YRPacketGetHeader(packet))) {
+        YRPacketSerializedSetCRC32C(packetBuffer, packetLength);
+    }
     
-    !session->callbacks.sendCallout ?: session->callbacks.sendCallout(session, YRLightweightOutputStreamGetBytes(outputStream), packetLength);
+    YRSessionSendBytes(session, packetBuffer, packetLength);
+}
+
+void YRSessionSendStoredSegment(YRSessionRef session, YRSessionSendOperationRef operation) {
+    // Segment might have waited for pacer or retransmission, so piggyback the latest ack. O(1), see YRPacketHeaderUpdateAckNumber.
+    YRPacketSerializedSetAckNumber(operation->bytes, operation->length, session->sessionInfo.rcvLatestAckedSegment);
+    
+    // Delayed ACK rides along, EACKs are never delayed so there's nothing else to wait for.
+    session->sentAckNumber = session->sessionInfo.rcvLatestAckedSegment;
+    YRSessionCancelTimer(session, &session->cumulativeAckTimer);
+    
+    // Close RST is stored too, it keeps ones' complement checksum. Only packet description matters here.
+    uint64_t headerBuffer[2] = {0};
+    YRPacketHeaderRef header = (YRPacketHeaderRef)headerBuffer;
+    
+    YRPacketHeaderSetPacketDescription(header, YRPacketSerializedGetPacketDescription(operation->bytes, operation->length));
+    
+    // CRC32C can't be updated incrementally, so it's recomputed on every send.
+    if (YRSessionIsUsingCRC32CForHeader(session, header)) {
+        YRPacketSerializedSetCRC32C(operation->bytes, operation->length);
+    }
+    
+    YRSessionSendBytes(session, operation->bytes, operation->length);
+}
+
+void YRSessionSendBytes(YRSessionRef session, const void *bytes, YRPayloadLengthType length) {
+    !session->callbacks.sendCallout ?: session->callbacks.sendCallout(session, bytes, length);
+}
+
+bool YRSessionSendSegmentWithPayload(YRSessionRef session, const void *payload, YRPayloadLengthType length) {
+    bool checksumPayload = YRSessionShouldChecksumPayload(session);
+    
+    return YRSessionDoReliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
+        // Payload is referenced, it's copied only once while being serialized into send queue.
+        if (checksumPayload) {
+            YRPacketCreateWithPayload(seqNumber, ackNumber, payload, length, false, packetBuffer);
+        } else {
+            YRPacketCreateWithPayloadHeaderChecksumOnly(seqNumber, ackNumber, payload, length, false, packetBuffer);
+        }
+    }, YRPacketLengthForPayload(length));
+}
+
+YRPayloadLengthType YRSessionGetMaximumPayloadLength(YRSessionRef session) {
+    YRPayloadLengthType maximumSegmentSize = session->remoteConnectionConfiguration.maximumSegmentSize;
+    // Payload starts at 8 bytes boundary on the wire, see YRPacketGetLength.
+    YRPayloadLengthType headerLength = YRMakeMultipleTo(kYRPacketPayloadHeaderLength, 8);
+    
+    return maximumSegmentSize > headerLength ? maximumSegmentSize - headerLength : 0;
+}
+
+size_t YRSessionGetSendOperationCapacity(YRSessionRef session) {
+    return YRPacketDataStructureLengthForPacketSize(session->remoteConnectionConfiguration.maximumSegmentSize);
+}
+
+void YRSessionSetRemoteConnectionConfiguration(YRSessionRef session, YRConnectionConfiguration configuration) {
+    // Peer's segment size comes from network: bigger one than we can store would overflow send operation length.
+    if (configuration.maximumSegmentSize > YRPacketMaximumLength()) {
+        configuration.maximumSegmentSize = YRPacketMaximumLength();
+    }
+    
+    session->remoteConnectionConfiguration = configuration;
+}
+
+#pragma mark - Timers
+
+void YRSessionScheduleTimer(YRSessionRef session, YRTimerRef timer, uint32_t timeout) {
+    if (session->timerWheel) {
+        YRTimerWheelSchedule(session->timerWheel, timer, timeout);
+    }
+}
+
+void YRSessionCancelTimer(YRSessionRef session, YRTimerRef timer) {
+    if (session->timerWheel) {
+        YRTimerWheelCancel(session->timerWheel, timer);
+    }
+}
+
+void YRSessionCancelTimers(YRSessionRef session) {
+    YRSessionCancelTimer(session, &session->retransmissionTimer);
+    YRSessionCancelTimer(session, &session->nullSegmentTimer);
+    YRSessionCancelTimer(session, &session->disconnectTimer);
+    YRSessionCancelTimer(session, &session->pacingTimer);
+    YRSessionCancelTimer(session, &session->cumulativeAckTimer);
+    YRSessionCancelTimer(session, &session->batchingTimer);
+}
+
+void YRSessionUpdateTimersForState(YRSessionRef session) {
+    switch (session->state) {
+        case kYRSessionStateConnected:
+            // Handshake is over: SYN is acknowledged and gives the first RTT sample.
+            YRSessionSampleRoundTripTime(session, session->synSendTime, session->synRetransmissions);
+            YRSessionCancelTimer(session, &session->retransmissionTimer);
+            YRSessionScheduleNullSegmentTimer(session);
+            break;
+        case kYRSessionStateDisconnecting:
+            // Retransmission timer keeps running to deliver RST.
+            YRSessionCancelTimer(session, &session->nullSegmentTimer);
+            YRSessionScheduleTimer(session, &session->disconnectTimer, YRSessionGetDisconnectTimeout(session));
+            break;
+        case kYRSessionStateClosed:
+        case kYRSessionStateWaiting:
+            YRSessionCancelTimers(session);
+            break;
+        default:
+            break;
+    }
+}
+
+void YRSessionScheduleRetransmissionTimerIfNeeded(YRSessionRef session) {
+    // Single timer serves every outstanding segment, it's re-armed for the oldest one when fired.
+    if (session->retransmissionTimeout > 0 && !YRTimerIsScheduled(&session->retransmissionTimer)) {
+        YRSessionScheduleTimer(session, &session->retransmissionTimer, session->retransmissionTimeout);
+    }
+}
+
+void YRSessionScheduleNullSegmentTimer(YRSessionRef session) {
+    uint32_t timeout = session->localConnectionConfiguration.nullSegmentTimeoutValue;
+    
+    if (timeout == 0) {
+        return;
+    }
+    
+    // Passive peer waits twice as long for NUL segment before considering connection broken.
+    YRSessionScheduleTimer(session, &session->nullSegmentTimer, session->shouldKeepAlive ? timeout : timeout * 2);
+}
+
+uint32_t YRSessionGetDisconnectTimeout(YRSessionRef session) {
+    YRConnectionConfiguration configuration = session->localConnectionConfiguration;
+    
+    // Enough for RST to be retransmitted maximum number of times.
+    return (uint32_t)configuration.retransmissionTimeoutValue * (configuration.maxRetransmissions + 1);
+}
+
+void YRSessionHandleRetransmissionTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context) {
+    YRSessionRef session = context;
+    YRConnectionConfiguration configuration = session->localConnectionConfiguration;
+    
+    if (session->state == kYRSessionStateInitiating || session->state == kYRSessionStateConnecting) {
+        if (session->synRetransmissions >= configuration.maxRetransmissions) {
+            // err: Connection timed out
+            YRSessionInvalidateConnection(session);
+            return;
+        }
+        
+        session->synRetransmissions++;
+        
+        YRSessionBackOffRetransmissionTimeout(session);
+        YRSessionResendSYN(session);
+        YRSessionScheduleTimer(session, timer, session->retransmissionTimeout);
+        
+        return;
+    }
+    
+    YRPacketsQueueRef queue = session->sendQueue;
+    uint16_t segmentsCount = queue ? YRPacketsQueueBuffersInUse(queue) : 0;
+    
+    if (segmentsCount == 0) {
+        return;
+    }
+    
+    YRSequenceNumberType segments[segmentsCount];
+    
+    YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, segments, &segmentsCount);
+    
+    uint64_t now = YRTimerWheelGetTime(wheel);
+    uint64_t nearestDeadline = UINT64_MAX;
+    bool hasTimedOut = false;
+    
+    for (uint16_t i = 0; i < segmentsCount; i++) {
+        YRSessionSendOperationRef operation = YRPacketsQueueBufferForSegment(queue, segments[i]);
+        
+        if (operation->isPending) {
+            // Not transmitted yet, pacer takes care of it.
+            continue;
+        }
+        
+        uint64_t deadline = operation->sendTime + session->retransmissionTimeout;
+        
+        if (deadline <= now) {
+            if (operation->retransmissions >= configuration.maxRetransmissions) {
+                // err: Peer is unreachable
+                YRSessionInvalidateConnection(session);
+                return;
+            }
+            
+            if (!hasTimedOut) {
+                // Back off once per expiration, not per segment.
+                hasTimedOut = true;
+                
+                YRSessionBackOffRetransmissionTimeout(session);
+                YRSessionEnterRecovery(session);
+                YRCongestionControlOnTimeout(&session->congestionControl);
+            }
+            
+            operation->retransmissions++;
+            operation->sendTime = now;
+            deadline = now + session->retransmissionTimeout;
+            
+            YRSessionSendStoredSegment(session, operation);
+            
+            if (session->sendQueue != queue) {
+                // Send callout invalidated session.
+                return;
+            }
+        }
+        
+        nearestDeadline = deadline < nearestDeadline ? deadline : nearestDeadline;
+    }
+    
+    if (nearestDeadline != UINT64_MAX) {
+        YRSessionScheduleTimer(session, timer, (uint32_t)(nearestDeadline - now));
+    }
+}
+
+void YRSessionHandleNullSegmentTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context) {
+    YRSessionRef session = context;
+    
+    if (!session->shouldKeepAlive) {
+        // err: Active peer went silent
+        YRSessionInvalidateConnection(session);
+        return;
+    }
+    
+    if (YRSessionCanSend(session)) {
+        // Reschedules timer.
+        YRSessionDoReliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
+            YRPacketCreateNUL(seqNumber, ackNumber, packetBuffer);
+        }, YRPacketNULLength());
+    } else {
+        // Send window is full, outstanding segments are retransmitted anyway.
+        YRSessionScheduleNullSegmentTimer(session);
+    }
+}
+
+void YRSessionHandleDisconnectTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context) {
+    YRSessionInvalidateConnection(context);
+}
+
+void YRSessionHandleCumulativeAckTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context) {
+    YRSessionRef session = context;
+    
+    if (session->state == kYRSessionStateConnected) {
+        YRSessionDoACKOrEACK(session);
+    }
+}
+
+void YRSessionHandleBatchingTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context) {
+    YRSessionRef session = context;
+    
+    if (session->isCloseRequested) {
+        YRSessionCompleteRequestedClose(session);
+    } else {
+        YRSessionFlush(session);
+    }
+}
+
+void YRSessionResendSYN(YRSessionRef session) {
+    // Passive peer answers with SYN/ACK.
+    bool hasACK = session->state == kYRSessionStateConnecting;
+    
+    YRSessionDoUnreliableSend(session, ^(void *packetBuffer, YRSequenceNumberType seqNumber, YRSequenceNumberType ackNumber) {
+        YRPacketCreateSYN(session->localConnectionConfiguration,
+                          session->sessionInfo.sendInitialSequenceNumber,
+                          ackNumber,
+                          hasACK,
+                          packetBuffer);
+    }, YRPacketSYNLength());
+}
+
+#pragma mark - Round Trip Time
+
+int32_t YRSessionSampleRoundTripTime(YRSessionRef session, uint64_t sendTime, uint8_t retransmissions) {
+    // Karn's rule: ACK of retransmitted segment is ambiguous, so it's never sampled.
+    if (!session->timerWheel || retransmissions > 0) {
+        return -1;
+    }
+    
+    uint64_t elapsed = YRTimerWheelGetTime(session->timerWheel) - sendTime;
+    int32_t roundTripTime = elapsed > kYRSessionMaxRetransmissionTimeout ? kYRSessionMaxRetransmissionTimeout : (int32_t)elapsed;
+    
+    if (session->localConnectionConfiguration.retransmissionTimeoutValue == 0) {
+        // Retransmissions are disabled, sample is still useful for congestion control.
+        return roundTripTime;
+    }
+    
+    if (!session->hasRoundTripTimeSample) {
+        session->hasRoundTripTimeSample = true;
+        session->scaledSmoothedRoundTripTime = roundTripTime << 3;
+        session->scaledRoundTripTimeVariance = roundTripTime << 1;
+    } else {
+        // SRTT += (R - SRTT) / 8, RTTVAR += (|R - SRTT| - RTTVAR) / 4 in scaled form.
+        int32_t delta = roundTripTime - (int32_t)(session->scaledSmoothedRoundTripTime >> 3);
+        
+        session->scaledSmoothedRoundTripTime += delta;
+        session->scaledRoundTripTimeVariance += (delta < 0 ? -delta : delta) - (int32_t)(session->scaledRoundTripTimeVariance >> 2);
+    }
+    
+    // RTO = SRTT + max(G, 4 * RTTVAR), clock granularity G is 1 ms. New sample also drops backoff.
+    uint32_t variance = session->scaledRoundTripTimeVariance > 1 ? session->scaledRoundTripTimeVariance : 1;
+    uint32_t timeout = (session->scaledSmoothedRoundTripTime >> 3) + variance;
+    
+    if (timeout < kYRSessionMinRetransmissionTimeout) {
+        timeout = kYRSessionMinRetransmissionTimeout;
+    }
+    
+    session->retransmissionTimeout = timeout < kYRSessionMaxRetransmissionTimeout ? timeout : kYRSessionMaxRetransmissionTimeout;
+    
+    return roundTripTime;
+}
+
+int32_t YRSessionSampleRoundTripTimeForOperation(YRSessionRef session, YRSessionSendOperationRef operation) {
+    // Segment still waiting for pacer was never sent, its sendTime means nothing.
+    if (operation->isPending) {
+        return -1;
+    }
+    
+    return YRSessionSampleRoundTripTime(session, operation->sendTime, operation->retransmissions);
+}
+
+void YRSessionBackOffRetransmissionTimeout(YRSessionRef session) {
+    uint32_t timeout = session->retransmissionTimeout * 2;
+    
+    session->retransmissionTimeout = timeout < kYRSessionMaxRetransmissionTimeout ? timeout : kYRSessionMaxRetransmissionTimeout;
+}
+
+void YRSessionResetRoundTripTimeEstimation(YRSessionRef session) {
+    session->hasRoundTripTimeSample = false;
+    session->scaledSmoothedRoundTripTime = 0;
+    session->scaledRoundTripTimeVariance = 0;
+    // Zero disables retransmissions altogether.
+    session->retransmissionTimeout = session->localConnectionConfiguration.retransmissionTimeoutValue;
+}
+
+#pragma mark - Congestion Control
+
+void YRSessionEnterRecovery(YRSessionRef session) {
+    session->isInRecovery = true;
+    session->recoveryPoint = session->sessionInfo.sendNextSequenceNumber - 1;
+}
+
+void YRSessionRetransmitLostSegments(YRSessionRef session, YRSequenceNumberType highestAcknowledged) {
+    YRPacketsQueueRef queue = session->sendQueue;
+    uint16_t segmentsCount = queue ? YRPacketsQueueBuffersInUse(queue) : 0;
+    
+    if (segmentsCount == 0) {
+        return;
+    }
+    
+    YRSequenceNumberType segments[segmentsCount];
+    
+    YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, segments, &segmentsCount);
+    
+    YRSequenceNumberType base = YRPacketsQueueGetBaseSegment(queue);
+    YRSequenceNumberType highestOffset = highestAcknowledged - base;
+    uint16_t holesCount = 0;
+    
+    // Segments come in ascending order, holes are outstanding ones below the highest EACK'd segment.
+    while (holesCount < segmentsCount && (YRSequenceNumberType)(segments[holesCount] - base) < highestOffset) {
+        holesCount++;
+    }
+    
+    uint64_t now = session->timerWheel ? YRTimerWheelGetTime(session->timerWheel) : 0;
+    
+    for (uint16_t i = 0; i < holesCount; i++) {
+        // Whatever isn't outstanding between hole and the highest EACK'd segment was received.
+        // Count only decreases for later holes, so the rest wait for more EACKs.
+        uint16_t acknowledgedAbove = (YRSequenceNumberType)(highestAcknowledged - segments[i]) - (holesCount - i - 1);
+        
+        if (acknowledgedAbove < kYRSessionFastRetransmitThreshold) {
+            break;
+        }
+        
+        YRSessionSendOperationRef operation = YRPacketsQueueBufferForSegment(queue, segments[i]);
+        
+        if (operation->isPending ||
+            operation->isFastRetransmitted ||
+            operation->retransmissions >= session->localConnectionConfiguration.maxRetransmissions) {
+            continue;
+        }
+        
+        operation->isFastRetransmitted = true;
+        operation->retransmissions++;
+        operation->sendTime = now;
+        
+        YRSessionSendStoredSegment(session, operation);
+        
+        if (session->sendQueue != queue) {
+            // Send callout invalidated session.
+            return;
+        }
+    }
+}
+
+bool YRSessionIsSequenceAfterOrEqual(YRSequenceNumberType sequence, YRSequenceNumberType other) {
+    // Serial number arithmetic, sequence numbers wrap around.
+    return (YRSequenceNumberType)(sequence - other) < (YRSequenceNumberType)(1 << (sizeof(YRSequenceNumberType) * 8 - 1));
+}
+
+#pragma mark - Pacing
+
+void YRSessionTransmitOperation(YRSessionRef session, YRSessionSendOperationRef operation) {
+    operation->isPending = false;
+    operation->sendTime = session->timerWheel ? YRTimerWheelGetTime(session->timerWheel) : 0;
+    
+    YRSessionSendStoredSegment(session, operation);
+    YRSessionScheduleRetransmissionTimerIfNeeded(session);
+}
+
+bool YRSessionIsPacingEnabled(YRSessionRef session) {
+    // Rate is derived from RTT, so segments go out immediately till the first sample.
+    return session->timerWheel && session->hasRoundTripTimeSample;
+}
+
+uint32_t YRSessionGetPacingCreditPerMillisecond(YRSessionRef session) {
+    uint64_t window = YRCongestionControlGetWindow(&session->congestionControl);
+    uint64_t smoothedRoundTripTime = session->scaledSmoothedRoundTripTime >> 3;
+    
+    // Pace slightly faster than window / RTT so window can still grow: x2 in slow start, x1.25 afterwards.
+    uint64_t credit = window * kYRSessionPacingCreditPerSegment;
+    
+    if (window < session->congestionControl.slowStartThreshold) {
+        credit *= 2;
+    } else {
+        credit += credit / 4;
+    }
+    
+    credit /= smoothedRoundTripTime > 0 ? smoothedRoundTripTime : 1;
+    
+    return credit > 0 ? (credit < UINT32_MAX ? (uint32_t)credit : UINT32_MAX) : 1;
+}
+
+void YRSessionRefillPacingCredit(YRSessionRef session) {
+    uint64_t now = YRTimerWheelGetTime(session->timerWheel);
+    uint64_t credit = session->pacingCredit + (now - session->pacingUpdateTime) * YRSessionGetPacingCreditPerMillisecond(session);
+    
+    session->pacingUpdateTime = now;
+    session->pacingCredit = credit < kYRSessionPacingBurst * kYRSessionPacingCreditPerSegment ?
+        (uint32_t)credit : kYRSessionPacingBurst * kYRSessionPacingCreditPerSegment;
+}
+
+bool YRSessionTakePacingCredit(YRSessionRef session) {
+    if (!YRSessionIsPacingEnabled(session)) {
+        return true;
+    }
+    
+    YRSessionRefillPacingCredit(session);
+    
+    if (session->pacingCredit < kYRSessionPacingCreditPerSegment) {
+        return false;
+    }
+    
+    session->pacingCredit -= kYRSessionPacingCreditPerSegment;
+    
+    return true;
+}
+
+void YRSessionSchedulePacingTimer(YRSessionRef session) {
+    if (YRTimerIsScheduled(&session->pacingTimer)) {
+        return;
+    }
+    
+    uint32_t missingCredit = session->pacingCredit < kYRSessionPacingCreditPerSegment ?
+        kYRSessionPacingCreditPerSegment - session->pacingCredit : 0;
+    uint32_t creditPerMillisecond = YRSessionGetPacingCreditPerMillisecond(session);
+    
+    YRSessionScheduleTimer(session, &session->pacingTimer, (missingCredit + creditPerMillisecond - 1) / creditPerMillisecond);
+}
+
+void YRSessionHandlePacingTimeout(YRTimerWheelRef wheel, YRTimerRef timer, void *context) {
+    YRSessionRef session = context;
+    YRPacketsQueueRef queue = session->sendQueue;
+    
+    while (queue && session->nextSegmentToTransmit != session->sessionInfo.sendNextSequenceNumber) {
+        YRSequenceNumberType segment = session->nextSegmentToTransmit;
+        
+        if (!YRPacketsQueueIsBufferInUseForSegment(queue, segment)) {
+            // Bogus acknowledgment released segment that was never sent.
+            session->nextSegmentToTransmit++;
+            continue;
+        }
+        
+        if (!YRSessionTakePacingCredit(session)) {
+            YRSessionSchedulePacingTimer(session);
+            return;
+        }
+        
+        session->nextSegmentToTransmit++;
+        
+        YRSessionTransmitOperation(session, YRPacketsQueueBufferForSegment(queue, segment));
+        
+        // Transmission callout may invalidate session.
+        queue = session->sendQueue;
+    }
 }
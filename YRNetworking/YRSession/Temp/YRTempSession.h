@@ -12,6 +12,8 @@
 #include "YRConnectionConfiguration.h"
 #include "YRTypes.h"
 #include "YRSessionState.h"
+#include "YRTimerWheel.h"
+#include "YRCongestionControl.h"
 
 #include <Block.h>
 
@@ -50,11 +52,27 @@ size_t YRSessionGetMinimumSize(YRConnectionConfiguration configuration);
 
 #pragma mark - Lifecycle
 
+/**
+ *  Returns NULL if configuration's maximumSegmentSize exceeds YRPacketMaximumLength.
+ */
 YRSessionRef YRSessionCreateWithConfiguration(YRConnectionConfiguration configuration, YRSessionCallbacks callbacks);
 void YRSessionDestroy(YRSessionRef session);
 
-// Temporary solution
-void YRSessionSetTimerProvider(YRSessionRef session, void *(^createTimer) (uint32_t seconds), void (^cancel) (void *));
+/**
+ *  Sets wheel that drives retransmission, null segment, disconnect and pacing timers of session.
+ *  Wheel is not owned by session and is usually shared by every session running on the same thread.
+ *  Should be set before connecting, session without wheel never retransmits nor times out.
+ *  Once round trip time is measured, reliable segments are paced at congestion window per RTT
+ *  instead of leaving in bursts, so send callout may be invoked from wheel advance.
+ */
+void YRSessionSetTimerWheel(YRSessionRef session, YRTimerWheelRef wheel);
+
+/**
+ *  Algorithm that limits amount of outstanding segments, kYRCongestionControlNewReno by default.
+ *  NULL disables congestion control, so only peer's advertised window (see YRConnectionConfigurationGetWindow) limits sending.
+ *  Resets congestion window if connection is established already.
+ */
+void YRSessionSetCongestionControlAlgorithm(YRSessionRef session, const YRCongestionControlAlgorithm *algorithm);
 
 //YRSessionRef YRSessionRetain(YRSessionRef session);
 //YRSessionRef YRSessionRelease(YRSessionRef session);
@@ -73,6 +91,8 @@ void YRSessionWait(YRSessionRef session);
 
 /**
  *  Closes connection and notifies its peer about that.
+ *  Pending batch leaves first. If window is full, session stays connected till ACK opens window for batch and RST,
+ *  YRSessionSend fails meanwhile.
  */
 void YRSessionClose(YRSessionRef session);
 
@@ -95,7 +115,42 @@ bool YRSessionCanSend(YRSessionRef session);
  *  YRSession will call handlers passed on initialization providing real data to be sent/received.
  */
 void YRSessionReceive(YRSessionRef session, void *payload, YRPayloadLengthType length);
-void YRSessionSend(YRSessionRef session, void *payload, YRPayloadLengthType length);
+/**
+ *  Returns false (payload is dropped) if session isn't connected, there's no space available, there's no memory
+ *  or payload is empty or exceeds peer's maximum segment size.
+ */
+bool YRSessionSend(YRSessionRef session, void *payload, YRPayloadLengthType length);
+
+/**
+ *  When kYRConnectionOptionBatching is negotiated YRSessionSend copies message into batch instead of sending it.
+ *  Batch leaves as one segment once the next message doesn't fit into peer's maximum segment size,
+ *  on batchingTimeoutValue or on this call. Every message is delivered by its own receive callout on peer's side.
+ *  Keeps batch if there's no space available. Does nothing when batch is empty.
+ */
+void YRSessionFlush(YRSessionRef session);
+
+/**
+ *  Counterpart of YRSessionSend that may be called from any thread: payload is copied into slot of
+ *  lock-free submission ring, session sends it when YRSessionProcessSubmissions is called on its own thread.
+ *  Never waits for session's thread, takes no locks and doesn't allocate: slots are preallocated once session connects.
+ *  Returns false (payload is dropped) if session hasn't connected yet, ring is full or payload is empty
+ *  or exceeds maximum payload length of either side (as known when session connected).
+ *  outShouldWakeOwner (optional) is set to true when session's thread may be idle and should be woken up.
+ */
+bool YRSessionSubmit(YRSessionRef session, const void *payload, YRPayloadLengthType length, bool *outShouldWakeOwner);
+
+/**
+ *  Sends submitted payloads in order while session is connected and has space available, the rest stay queued.
+ *  Should be called on session's thread, e.g. on every loop iteration. Session calls it itself after ACKs open window.
+ *  Payloads YRSessionSend refuses (e.g. close was requested) are dropped and counted,
+ *  see YRSessionGetDroppedSubmissionsCount. Returns number of payloads sent.
+ */
+uint32_t YRSessionProcessSubmissions(YRSessionRef session);
+
+/**
+ *  Number of submitted payloads dropped by YRSessionProcessSubmissions. Should be called on session's thread.
+ */
+uint32_t YRSessionGetDroppedSubmissionsCount(YRSessionRef session);
 
 #pragma mark - State
 
@@ -0,0 +1,212 @@
+//
+//  YRAddressTableTests.m
+//  YRNetworkingCoreTests
+//
+//  Created by Yuriy Romanchenko on 3/9/19.
+//  Copyright © 2019 Yuriy Romanchenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "YRAddressTable.h"
+
+#import <netinet/in.h>
+#import <arpa/inet.h>
+
+@interface YRAddressTableTests : XCTestCase
+@end
+
+@implementation YRAddressTableTests
+
+- (void)testTableDestroy {
+    YRAddressTableDestroy(NULL);
+
+    YRAddressTableRef table = YRAddressTableCreate(0);
+
+    XCTAssertTrue(table != NULL);
+    XCTAssertTrue(YRAddressTableGetCount(table) == 0);
+
+    YRAddressTableDestroy(table);
+}
+
+- (void)testSetGetRemove {
+    YRAddressTableRef table = YRAddressTableCreate(0);
+
+    struct sockaddr_in first = [self IPv4AddressWithHost:0x7F000001 port:5000];
+    struct sockaddr_in second = [self IPv4AddressWithHost:0x7F000001 port:5001];
+
+    int firstValue = 1;
+    int secondValue = 2;
+
+    XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&first) == NULL);
+
+    XCTAssertTrue(YRAddressTableSet(table, (struct sockaddr *)&first, &firstValue));
+    XCTAssertTrue(YRAddressTableSet(table, (struct sockaddr *)&second, &secondValue));
+    XCTAssertTrue(YRAddressTableGetCount(table) == 2);
+
+    XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&first) == &firstValue);
+    XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&second) == &secondValue);
+
+    // Replacing value doesn't change count.
+    XCTAssertTrue(YRAddressTableSet(table, (struct sockaddr *)&first, &secondValue));
+    XCTAssertTrue(YRAddressTableGetCount(table) == 2);
+    XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&first) == &secondValue);
+
+    XCTAssertTrue(YRAddressTableRemove(table, (struct sockaddr *)&first) == &secondValue);
+    XCTAssertTrue(YRAddressTableRemove(table, (struct sockaddr *)&first) == NULL);
+    XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&first) == NULL);
+    XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&second) == &secondValue);
+    XCTAssertTrue(YRAddressTableGetCount(table) == 1);
+
+    YRAddressTableRemoveAll(table);
+
+    XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&second) == NULL);
+    XCTAssertTrue(YRAddressTableGetCount(table) == 0);
+
+    YRAddressTableDestroy(table);
+}
+
+- (void)testIPv4MappedAddressesAreEqual {
+    YRAddressTableRef table = YRAddressTableCreate(0);
+
+    struct sockaddr_in address4 = [self IPv4AddressWithHost:0x0A000001 port:4242];
+
+    struct sockaddr_in6 address6 = {0};
+
+    address6.sin6_family = AF_INET6;
+    address6.sin6_port = htons(4242);
+    inet_pton(AF_INET6, "::ffff:10.0.0.1", &address6.sin6_addr);
+
+    int value = 0;
+
+    XCTAssertTrue(YRAddressTableSet(table, (struct sockaddr *)&address4, &value));
+    XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&address6) == &value);
+
+    address6.sin6_port = htons(4243);
+
+    XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&address6) == NULL);
+
+    YRAddressTableDestroy(table);
+}
+
+- (void)testUnsupportedFamily {
+    YRAddressTableRef table = YRAddressTableCreate(0);
+
+    struct sockaddr address = {0};
+    address.sa_family = AF_UNIX;
+
+    int value = 0;
+
+    XCTAssertFalse(YRAddressTableSet(table, &address, &value));
+    XCTAssertTrue(YRAddressTableGet(table, &address) == NULL);
+    XCTAssertTrue(YRAddressTableGetCount(table) == 0);
+
+    YRAddressTableDestroy(table);
+}
+
+- (void)testRandomOperationsMatchReference {
+    const uint32_t addressesCount = 4096;
+
+    YRAddressTableRef table = YRAddressTableCreate(0);
+    struct sockaddr_in6 *addresses = calloc(addressesCount, sizeof(struct sockaddr_in6));
+    void **reference = calloc(addressesCount, sizeof(void *));
+    uint32_t expectedCount = 0;
+
+    for (uint32_t i = 0; i < addressesCount; i++) {
+        addresses[i].sin6_family = AF_INET6;
+        addresses[i].sin6_port = htons(i % 7);
+        addresses[i].sin6_addr.s6_addr[14] = i >> 8;
+        addresses[i].sin6_addr.s6_addr[15] = i & 0xFF;
+    }
+
+    // Heavy churn makes sure backward shift deletion keeps every cluster reachable.
+    for (uintptr_t iterator = 1; iterator < 200000; iterator++) {
+        uint32_t index = arc4random_uniform(addressesCount);
+        struct sockaddr *address = (struct sockaddr *)&addresses[index];
+
+        switch (arc4random_uniform(3)) {
+            case 0:
+                expectedCount += reference[index] == NULL;
+                reference[index] = (void *)iterator;
+
+                XCTAssertTrue(YRAddressTableSet(table, address, reference[index]));
+                break;
+            case 1:
+                XCTAssertTrue(YRAddressTableRemove(table, address) == reference[index]);
+
+                expectedCount -= reference[index] != NULL;
+                reference[index] = NULL;
+                break;
+            default:
+                XCTAssertTrue(YRAddressTableGet(table, address) == reference[index]);
+                break;
+        }
+
+        XCTAssertTrue(YRAddressTableGetCount(table) == expectedCount);
+    }
+
+    for (uint32_t i = 0; i < addressesCount; i++) {
+        XCTAssertTrue(YRAddressTableGet(table, (struct sockaddr *)&addresses[i]) == reference[i]);
+    }
+
+    free(reference);
+    free(addresses);
+    YRAddressTableDestroy(table);
+}
+
+#pragma mark - Performance
+
+- (void)testLookupPerformance1K {
+    [self measureLookupWithSessionsCount:1000];
+}
+
+- (void)testLookupPerformance10K {
+    [self measureLookupWithSessionsCount:10000];
+}
+
+- (void)testLookupPerformance100K {
+    [self measureLookupWithSessionsCount:100000];
+}
+
+#pragma mark - Private
+
+- (struct sockaddr_in)IPv4AddressWithHost:(uint32_t)host port:(uint16_t)port {
+    struct sockaddr_in address = {0};
+
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(host);
+
+    return address;
+}
+
+- (void)measureLookupWithSessionsCount:(uint32_t)count {
+    // Same amount of lookups for every table size, so results are comparable per lookup.
+    const uint32_t lookupsCount = 1000000;
+
+    YRAddressTableRef table = YRAddressTableCreate(count);
+    struct sockaddr_in *addresses = calloc(count, sizeof(struct sockaddr_in));
+
+    for (uint32_t i = 0; i < count; i++) {
+        addresses[i] = [self IPv4AddressWithHost:0x0A000000 + i / 50000 port:1024 + i % 50000];
+
+        YRAddressTableSet(table, (struct sockaddr *)&addresses[i], &addresses[i]);
+    }
+
+    __block uint32_t hits = 0;
+
+    [self measureBlock:^{
+        for (uint32_t i = 0; i < lookupsCount; i++) {
+            struct sockaddr *address = (struct sockaddr *)&addresses[(i * 7919) % count];
+
+            hits += YRAddressTableGet(table, address) == address;
+        }
+    }];
+
+    XCTAssertTrue(hits % lookupsCount == 0);
+
+    free(addresses);
+    YRAddressTableDestroy(table);
+}
+
+@end
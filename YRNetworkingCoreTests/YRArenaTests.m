@@ -0,0 +1,56 @@
+//
+//  YRArenaTests.m
+//  YRNetworkingCoreTests
+//
+//  Created by Yuriy Romanchenko on 3/19/19.
+//  Copyright © 2019 Yuriy Romanchenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "YRArena.h"
+
+@interface YRArenaTests : XCTestCase
+@end
+
+@implementation YRArenaTests
+
+- (void)testAllocationsAreAligned {
+    YRArenaRef arena = YRArenaCreate(64);
+
+    uint8_t *first = YRArenaAllocate(arena, 3);
+    uint8_t *second = YRArenaAllocate(arena, 8);
+
+    XCTAssertTrue(first != NULL && second != NULL);
+    XCTAssertTrue((uintptr_t)first % 8 == 0);
+    XCTAssertTrue(second - first == 8);
+    XCTAssertTrue(YRArenaGetUsedSize(arena) == 16);
+
+    YRArenaDestroy(arena);
+}
+
+- (void)testExhaustion {
+    YRArenaRef arena = YRArenaCreate(64);
+
+    XCTAssertTrue(YRArenaAllocate(arena, 65) == NULL);
+    XCTAssertTrue(YRArenaAllocate(arena, SIZE_MAX) == NULL);
+    XCTAssertTrue(YRArenaAllocate(arena, 64) != NULL);
+    XCTAssertTrue(YRArenaAllocate(arena, 1) == NULL);
+
+    YRArenaDestroy(arena);
+}
+
+- (void)testResetReusesMemory {
+    YRArenaRef arena = YRArenaCreate(64);
+
+    void *first = YRArenaAllocate(arena, 64);
+
+    YRArenaReset(arena);
+
+    XCTAssertTrue(YRArenaGetUsedSize(arena) == 0);
+    XCTAssertTrue(YRArenaAllocate(arena, 64) == first);
+
+    YRArenaDestroy(arena);
+}
+
+@end
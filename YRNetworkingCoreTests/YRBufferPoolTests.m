@@ -0,0 +1,152 @@
+//
+//  YRBufferPoolTests.m
+//  YRNetworkingCoreTests
+//
+//  Created by Yuriy Romanchenko on 3/23/19.
+//  Copyright © 2019 Yuriy Romanchenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "YRBufferPool.h"
+#import "YRPacketsQueue.h"
+
+static const size_t kYRTestBuffersCount = 1000;
+
+@interface YRBufferPoolTests : XCTestCase
+@end
+
+@implementation YRBufferPoolTests
+
+- (void)testSizeClasses {
+    XCTAssertTrue(YRBufferPoolGetSizeClass(0) == 64);
+    XCTAssertTrue(YRBufferPoolGetSizeClass(64) == 64);
+    XCTAssertTrue(YRBufferPoolGetSizeClass(65) == 128);
+    XCTAssertTrue(YRBufferPoolGetSizeClass(1400) == 2048);
+    XCTAssertTrue(YRBufferPoolGetSizeClass(kYRBufferPoolMaxBufferSize) == kYRBufferPoolMaxBufferSize);
+    XCTAssertTrue(YRBufferPoolGetSizeClass(kYRBufferPoolMaxBufferSize + 1) == 0);
+
+    XCTAssertTrue(YRBufferPoolAcquire(kYRBufferPoolMaxBufferSize + 1) == NULL);
+}
+
+- (void)testReleasedBufferIsReused {
+    void *buffer = YRBufferPoolAcquire(1400);
+
+    XCTAssertTrue(buffer != NULL);
+    XCTAssertTrue((uintptr_t)buffer % 2048 == 0);
+
+    YRBufferPoolRelease(buffer, 1400);
+
+    XCTAssertTrue(YRBufferPoolAcquire(1400) == buffer);
+
+    YRBufferPoolRelease(buffer, 1400);
+}
+
+- (void)testBuffersAreDistinct {
+    uint8_t *buffers[kYRTestBuffersCount];
+
+    for (size_t i = 0; i < kYRTestBuffersCount; i++) {
+        buffers[i] = YRBufferPoolAcquire(100);
+        memset(buffers[i], (uint8_t)i, 100);
+    }
+
+    for (size_t i = 0; i < kYRTestBuffersCount; i++) {
+        XCTAssertTrue(buffers[i][0] == (uint8_t)i && buffers[i][99] == (uint8_t)i);
+    }
+
+    for (size_t i = 0; i < kYRTestBuffersCount; i++) {
+        YRBufferPoolRelease(buffers[i], 100);
+    }
+
+    YRBufferPoolFlushThreadCache();
+}
+
+- (void)testBuffersReleasedOnOtherThreads {
+    const size_t buffersCount = kYRTestBuffersCount;
+    uint8_t **buffers = calloc(buffersCount, sizeof(uint8_t *));
+
+    for (size_t i = 0; i < buffersCount; i++) {
+        buffers[i] = YRBufferPoolAcquire(1000);
+        buffers[i][0] = (uint8_t)i;
+    }
+
+    dispatch_apply(4, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t iteration) {
+        for (size_t i = iteration; i < buffersCount; i += 4) {
+            YRBufferPoolRelease(buffers[i], 1000);
+        }
+
+        YRBufferPoolFlushThreadCache();
+    });
+
+    // Everything went back to shared lists, so acquiring again doesn't need new memory.
+    size_t reservedSize = YRBufferPoolGetReservedSize();
+
+    for (size_t i = 0; i < buffersCount; i++) {
+        buffers[i] = YRBufferPoolAcquire(1000);
+    }
+
+    XCTAssertTrue(YRBufferPoolGetReservedSize() == reservedSize);
+
+    for (size_t i = 0; i < buffersCount; i++) {
+        YRBufferPoolRelease(buffers[i], 1000);
+    }
+
+    free(buffers);
+}
+
+- (void)testPooledQueueGivesBuffersBack {
+    YRPacketsQueueRef queue = YRPacketsQueueCreateWithOptions(1300, 1000, 64, kYRPacketsQueueOptionPooled);
+
+    YRPacketsQueueSetBaseSegment(queue, 0);
+
+    void *buffer = YRPacketsQueueBufferForSegment(queue, 10);
+
+    XCTAssertTrue((uintptr_t)buffer % 64 == 0);
+    XCTAssertTrue(YRPacketsQueueBufferForSegment(queue, 10) == buffer);
+
+    YRPacketsQueueMarkBufferInUseForSegment(queue, 10);
+    YRPacketsQueueUnmarkBufferInUseForSegment(queue, 10);
+
+    // Unmarked buffer went back to thread cache and is the first one handed out.
+    XCTAssertTrue(YRBufferPoolAcquire(1300) == buffer);
+
+    YRBufferPoolRelease(buffer, 1300);
+
+    // Buffer that was taken but never marked is returned when base passes it.
+    buffer = YRPacketsQueueBufferForSegment(queue, 20);
+    YRPacketsQueueAdvanceBaseSegment(queue, 21);
+
+    XCTAssertTrue(YRBufferPoolAcquire(1300) == buffer);
+
+    YRBufferPoolRelease(buffer, 1300);
+    YRPacketsQueueDestroy(queue);
+}
+
+- (void)testPooledQueueStoresOversizeBuffersItself {
+    size_t bufferSize = kYRBufferPoolMaxBufferSize + 100;
+    YRPacketsQueueRef queue = YRPacketsQueueCreateWithOptions(bufferSize, 4, 64, kYRPacketsQueueOptionPooled);
+
+    YRPacketsQueueSetBaseSegment(queue, 0);
+
+    XCTAssertTrue(YRBufferPoolAcquire(bufferSize) == NULL);
+    XCTAssertTrue(YRPacketsQueueGetBufferSize(queue) >= bufferSize);
+
+    uint8_t *buffer = YRPacketsQueueBufferForSegment(queue, 3);
+
+    XCTAssertTrue(buffer != NULL);
+    XCTAssertTrue((uintptr_t)buffer % 64 == 0);
+
+    // The whole buffer is usable.
+    memset(buffer, 0xAB, bufferSize);
+
+    YRPacketsQueueMarkBufferInUseForSegment(queue, 3);
+    YRPacketsQueueUnmarkBufferInUseForSegment(queue, 3);
+
+    // Contents survive as buffer isn't given back to pool.
+    XCTAssertTrue(YRPacketsQueueBufferForSegment(queue, 3) == buffer);
+    XCTAssertTrue(buffer[bufferSize - 1] == 0xAB);
+
+    YRPacketsQueueDestroy(queue);
+}
+
+@end
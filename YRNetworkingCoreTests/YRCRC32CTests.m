@@ -0,0 +1,105 @@
+//
+//  YRCRC32CTests.m
+//  YRNetworkingCoreTests
+//
+//  Created by Yuriy Romanchenko on 3/21/19.
+//  Copyright © 2019 Yuriy Romanchenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "YRCRC32C.h"
+#import "YRChecksum.h"
+
+// Bit at a time, straight from definition.
+static uint32_t YRTestReferenceCRC32C(uint32_t crc, const uint8_t *bytes, size_t length) {
+    crc = ~crc;
+
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
+
+@interface YRCRC32CTests : XCTestCase
+@end
+
+@implementation YRCRC32CTests
+
+- (void)testKnownValues {
+    XCTAssertEqual(YRCRC32CUpdate(0, "", 0), 0);
+    XCTAssertEqual(YRCRC32CUpdate(0, "123456789", 9), 0xE3069283);
+
+    uint8_t zeroes[32] = {0};
+
+    // RFC 3720, B.4.
+    XCTAssertEqual(YRCRC32CUpdate(0, zeroes, sizeof(zeroes)), 0x8A9136AA);
+}
+
+- (void)testKernelsMatchSoftwareKernel {
+    YRCRC32CKernel software = YRCRC32CGetKernel(kYRCRC32CKernelSoftware);
+    uint8_t bytes[2048 + 64];
+
+    XCTAssertTrue(software != NULL);
+
+    srand(42);
+
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = rand();
+    }
+
+    // Slicing-by-8 is the reference for hardware kernels, so it's checked bit by bit first.
+    for (size_t length = 0; length <= 64; length++) {
+        XCTAssertEqual(software(0, bytes + length % 8, length), YRTestReferenceCRC32C(0, bytes + length % 8, length));
+    }
+
+    for (int type = 0; type < kYRCRC32CKernelsCount; type++) {
+        YRCRC32CKernel kernel = YRCRC32CGetKernel(type);
+
+        if (!kernel) {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < 5000; i++) {
+            size_t length = rand() % 2048;
+            // Unaligned starts too.
+            size_t offset = rand() % 64;
+            uint32_t crc = i % 3 == 0 ? 0 : rand();
+
+            XCTAssertEqual(kernel(crc, bytes + offset, length), software(crc, bytes + offset, length));
+        }
+    }
+}
+
+- (void)testCRCOfPartsEqualsCRCOfWhole {
+    uint8_t bytes[1500];
+    size_t split = 7;
+
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    uint32_t whole = YRCRC32CUpdate(0, bytes, sizeof(bytes));
+    uint32_t parts = YRCRC32CUpdate(YRCRC32CUpdate(0, bytes, split), bytes + split, sizeof(bytes) - split);
+
+    XCTAssertEqual(whole, parts);
+}
+
+- (void)testDetectsBurstErrorsMissedByOnesComplement {
+    uint8_t original[64] = {0};
+    uint8_t corrupted[64] = {0};
+
+    // Same words swapped: ones' complement sum can't see reordering.
+    original[0] = 1;
+    corrupted[4] = 1;
+
+    XCTAssertEqual(YRChecksumAdd(0, original, sizeof(original)), YRChecksumAdd(0, corrupted, sizeof(corrupted)));
+    XCTAssertNotEqual(YRCRC32CUpdate(0, original, sizeof(original)), YRCRC32CUpdate(0, corrupted, sizeof(corrupted)));
+}
+
+@end
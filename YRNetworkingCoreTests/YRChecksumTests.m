@@ -0,0 +1,162 @@
+//
+//  YRChecksumTests.m
+//  YRNetworkingCoreTests
+//
+//  Created by Yuriy Romanchenko on 3/20/19.
+//  Copyright © 2019 Yuriy Romanchenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "YRChecksum.h"
+#import "YRCRC32C.h"
+
+static const size_t kYRTestBufferSize = 65536 + 64;
+
+// Straightforward 32-bit word sum the kernels have to match.
+static uint32_t YRTestReferenceChecksum(uint32_t sum, const uint8_t *bytes, size_t length) {
+    uint64_t result = sum;
+    size_t offset = 0;
+
+    for (; offset + sizeof(uint32_t) <= length; offset += sizeof(uint32_t)) {
+        uint32_t word;
+
+        memcpy(&word, bytes + offset, sizeof(word));
+
+        result += word;
+    }
+
+    if (offset < length) {
+        uint32_t word = 0;
+
+        memcpy(&word, bytes + offset, length - offset);
+
+        result += word;
+    }
+
+    while (result >> 32) {
+        result = (result & UINT32_MAX) + (result >> 32);
+    }
+
+    return (uint32_t)result;
+}
+
+@interface YRChecksumTests : XCTestCase
+@end
+
+@implementation YRChecksumTests {
+    uint8_t *_buffer;
+}
+
+- (void)setUp {
+    [super setUp];
+
+    _buffer = malloc(kYRTestBufferSize);
+
+    srand(42);
+
+    for (size_t i = 0; i < kYRTestBufferSize; i++) {
+        _buffer[i] = rand();
+    }
+}
+
+- (void)tearDown {
+    free(_buffer);
+
+    [super tearDown];
+}
+
+- (void)testScalarKernelIsAlwaysAvailable {
+    XCTAssertTrue(YRChecksumGetKernel(kYRChecksumKernelScalar) != NULL);
+    XCTAssertTrue(YRChecksumGetKernel(kYRChecksumKernelsCount) == NULL);
+    XCTAssertTrue(YRChecksumGetKernel(YRChecksumGetSelectedKernelType()) != NULL);
+}
+
+- (void)testKernelsMatchReference {
+    for (int type = 0; type < kYRChecksumKernelsCount; type++) {
+        YRChecksumKernel kernel = YRChecksumGetKernel(type);
+
+        if (!kernel) {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < 20000; i++) {
+            size_t length = i % 100 == 0 ? rand() % 65536 : rand() % 300;
+            // Unaligned starts too.
+            size_t offset = rand() % 64;
+            uint32_t sum = i % 3 == 0 ? 0 : rand();
+
+            XCTAssertEqual(kernel(sum, _buffer + offset, length),
+                           YRTestReferenceChecksum(sum, _buffer + offset, length));
+        }
+    }
+}
+
+- (void)testKernelsCarryOnAllOnes {
+    memset(_buffer, 0xFF, kYRTestBufferSize);
+
+    for (int type = 0; type < kYRChecksumKernelsCount; type++) {
+        YRChecksumKernel kernel = YRChecksumGetKernel(type);
+
+        if (!kernel) {
+            continue;
+        }
+
+        for (size_t length = 0; length <= 257; length++) {
+            XCTAssertEqual(kernel(UINT32_MAX, _buffer, length),
+                           YRTestReferenceChecksum(UINT32_MAX, _buffer, length));
+        }
+    }
+}
+
+- (void)testSumOfPartsEqualsSumOfWhole {
+    size_t length = 1500;
+    size_t split = 124;
+
+    uint32_t whole = YRChecksumAdd(0, _buffer, length);
+    uint32_t parts = YRChecksumAdd(YRChecksumAdd(0, _buffer, split), _buffer + split, length - split);
+
+    XCTAssertEqual(whole, parts);
+}
+
+#pragma mark - Performance
+
+// Ones' complement sum and CRC32C are measured by the same loop so their numbers compare directly.
+- (void)measureKernel:(YRChecksumKernel)kernel ofLength:(size_t)length {
+    uint8_t *buffer = _buffer;
+    uint32_t iterations = (uint32_t)(64 * 1024 * 1024 / length);
+
+    [self measureBlock:^{
+        volatile uint32_t sum = 0;
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            sum += kernel(0, buffer, length);
+        }
+    }];
+}
+
+- (void)testChecksum64BytesPerformance {
+    [self measureKernel:YRChecksumAdd ofLength:64];
+}
+
+- (void)testChecksum1KBPerformance {
+    [self measureKernel:YRChecksumAdd ofLength:1024];
+}
+
+- (void)testChecksum64KBPerformance {
+    [self measureKernel:YRChecksumAdd ofLength:65536];
+}
+
+- (void)testCRC32C64BytesPerformance {
+    [self measureKernel:YRCRC32CUpdate ofLength:64];
+}
+
+- (void)testCRC32C1KBPerformance {
+    [self measureKernel:YRCRC32CUpdate ofLength:1024];
+}
+
+- (void)testCRC32C64KBPerformance {
+    [self measureKernel:YRCRC32CUpdate ofLength:65536];
+}
+
+@end
@@ -0,0 +1,125 @@
+//
+//  YRCongestionControlTests.m
+//  YRNetworkingCoreTests
+//
+//  Created by Yuriy Romanchenko on 3/17/19.
+//  Copyright © 2019 Yuriy Romanchenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "YRCongestionControl.h"
+
+@interface YRCongestionControlTests : XCTestCase
+@end
+
+@implementation YRCongestionControlTests
+
+- (void)testDisabledControlUsesMaxWindow {
+    YRCongestionControl control;
+
+    YRCongestionControlInit(&control, NULL, 32);
+
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) == 32);
+
+    YRCongestionControlOnLoss(&control);
+    YRCongestionControlOnTimeout(&control);
+
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) == 32);
+}
+
+- (void)testNewRenoSlowStartAndLoss {
+    YRCongestionControl control;
+
+    YRCongestionControlInit(&control, &kYRCongestionControlNewReno, 64);
+
+    uint32_t initialWindow = YRCongestionControlGetWindow(&control);
+
+    XCTAssertTrue(initialWindow > 0 && initialWindow < 64);
+
+    // Slow start grows window by every acknowledged segment.
+    YRCongestionControlOnAck(&control, initialWindow, 10);
+
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) == initialWindow * 2);
+
+    YRCongestionControlOnLoss(&control);
+
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) == initialWindow);
+
+    // Congestion avoidance: one segment per window.
+    for (uint32_t i = 0; i < initialWindow; i++) {
+        YRCongestionControlOnAck(&control, 1, 10);
+    }
+
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) == initialWindow + 1);
+
+    YRCongestionControlOnTimeout(&control);
+
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) == 1);
+}
+
+- (void)testWindowNeverExceedsMaxWindow {
+    YRCongestionControl control;
+
+    YRCongestionControlInit(&control, &kYRCongestionControlNewReno, 8);
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        YRCongestionControlOnAck(&control, 8, 10);
+    }
+
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) == 8);
+}
+
+- (void)testDelayBasedStopsGrowingWhenDelayIncreases {
+    YRCongestionControl control;
+
+    YRCongestionControlInit(&control, &kYRCongestionControlDelayBased, 64);
+
+    for (uint32_t i = 0; i < 12; i++) {
+        YRCongestionControlOnAck(&control, 1, 10);
+    }
+
+    uint32_t window = YRCongestionControlGetWindow(&control);
+
+    XCTAssertTrue(window == 16);
+
+    // RTT doubled: half of the window sits in queues, so window shrinks instead of growing.
+    for (uint32_t i = 0; i < 200; i++) {
+        YRCongestionControlOnAck(&control, 1, 20);
+    }
+
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) < window);
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) >= 2);
+}
+
+- (void)testNewRenoTracksMinRoundTripTime {
+    YRCongestionControl control;
+
+    YRCongestionControlInit(&control, &kYRCongestionControlNewReno, 64);
+
+    XCTAssertTrue(control.minRoundTripTime < 0);
+
+    YRCongestionControlOnAck(&control, 1, 30);
+    YRCongestionControlOnAck(&control, 1, 10);
+    YRCongestionControlOnAck(&control, 1, 20);
+
+    // Retransmitted segments give no sample.
+    YRCongestionControlOnAck(&control, 1, -1);
+
+    XCTAssertTrue(control.minRoundTripTime == 10);
+}
+
+- (void)testDelayBasedLossBackOff {
+    YRCongestionControl control;
+
+    YRCongestionControlInit(&control, &kYRCongestionControlDelayBased, 64);
+    YRCongestionControlOnAck(&control, 12, 10);
+
+    uint32_t window = YRCongestionControlGetWindow(&control);
+
+    YRCongestionControlOnLoss(&control);
+
+    XCTAssertTrue(YRCongestionControlGetWindow(&control) == window - window / 4);
+}
+
+@end
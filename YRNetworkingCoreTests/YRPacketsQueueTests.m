@@ -118,11 +118,11 @@
     YRPacketsQueueUnmarkBufferInUseForSegment(queue, segmentBase);
     YRPacketsQueueUnmarkBufferInUseForSegment(queue, segmentBase + buffersCount - 1);
 
-    uint8_t buffersInUse = YRPacketsQueueBuffersInUse(queue);
+    uint16_t buffersInUse = YRPacketsQueueBuffersInUse(queue);
     YRSequenceNumberType seq[buffersInUse];
     memset(seq, 0, sizeof(YRSequenceNumberType) * buffersInUse);
-    uint8_t zeroBuffersIn = 0;
-    uint8_t tooMuchBuffersIn = buffersInUse + 1;
+    uint16_t zeroBuffersIn = 0;
+    uint16_t tooMuchBuffersIn = buffersInUse + 1;
     YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, NULL, NULL);
     YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, seq, NULL);
     YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, seq, &zeroBuffersIn);
@@ -192,11 +192,11 @@
     YRPacketsQueueUnmarkBufferInUseForSegment(queue, segmentBase);
     YRPacketsQueueUnmarkBufferInUseForSegment(queue, segmentBase + buffersCount - 1);
     
-    uint8_t buffersInUse = YRPacketsQueueBuffersInUse(queue);
+    uint16_t buffersInUse = YRPacketsQueueBuffersInUse(queue);
     YRSequenceNumberType seq[buffersInUse];
     memset(seq, 0, sizeof(YRSequenceNumberType) * buffersInUse);
-    uint8_t zeroBuffersIn = 0;
-    uint8_t tooMuchBuffersIn = buffersInUse + 1;
+    uint16_t zeroBuffersIn = 0;
+    uint16_t tooMuchBuffersIn = buffersInUse + 1;
     YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, NULL, NULL);
     YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, seq, NULL);
     YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, seq, &zeroBuffersIn);
@@ -220,4 +220,154 @@
     YRPacketsQueueDestroy(queue);
 }
 
+- (void)testLargeQueueBuffers {
+    uint16_t buffersCount = 5000;
+    YRPacketsQueueRef queue = YRPacketsQueueCreate(sizeof(int), buffersCount);
+    
+    YRSequenceNumberType segmentBase = 65500;
+    
+    YRPacketsQueueSetBaseSegment(queue, segmentBase);
+    
+    XCTAssertTrue(YRPacketsQueueHasBufferForSegment(queue, segmentBase + buffersCount - 1));
+    XCTAssertFalse(YRPacketsQueueHasBufferForSegment(queue, segmentBase + buffersCount));
+    // Nothing is allocated for untouched segments.
+    XCTAssertFalse(YRPacketsQueueIsBufferInUseForSegment(queue, segmentBase + 4000));
+    
+    for (uint16_t bufferIterator = 0; bufferIterator < buffersCount; bufferIterator++) {
+        void *buffer = YRPacketsQueueBufferForSegment(queue, segmentBase + bufferIterator);
+        
+        YRPacketsQueueMarkBufferInUseForSegment(queue, segmentBase + bufferIterator);
+        
+        *((int *)buffer) = bufferIterator;
+    }
+    
+    XCTAssertTrue(YRPacketsQueueBuffersInUse(queue) == buffersCount);
+    
+    YRPacketsQueueAdvanceBaseSegment(queue, 1234);
+    segmentBase += 1234;
+    
+    XCTAssertTrue(YRPacketsQueueBuffersInUse(queue) == buffersCount - 1234);
+    
+    uint16_t buffersInUse = YRPacketsQueueBuffersInUse(queue);
+    YRSequenceNumberType seq[buffersInUse];
+    
+    YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, seq, &buffersInUse);
+    
+    XCTAssertTrue(buffersInUse == buffersCount - 1234);
+    
+    for (uint16_t i = 0; i < buffersInUse; i++) {
+        XCTAssertTrue(seq[i] == (YRSequenceNumberType)(segmentBase + i));
+        
+        void *buffer = YRPacketsQueueBufferForSegment(queue, seq[i]);
+        
+        XCTAssertTrue(*(int *)buffer == 1234 + i);
+    }
+    
+    YRPacketsQueueDestroy(queue);
+}
+
+- (void)testAdvanceKeepsBuffersForAnyBuffersCount {
+    // 256 isn't multiple of 7, so index must wrap by buffersCount rather than by its type.
+    uint16_t buffersCount = 7;
+    YRPacketsQueueRef queue = YRPacketsQueueCreate(sizeof(int), buffersCount);
+    
+    YRSequenceNumberType segmentBase = 10;
+    
+    YRPacketsQueueSetBaseSegment(queue, segmentBase);
+    
+    for (uint16_t iterator = 0; iterator < 1000; iterator++) {
+        YRSequenceNumberType segment = segmentBase + iterator;
+        
+        *(int *)YRPacketsQueueBufferForSegment(queue, segment + 1) = segment + 1;
+        YRPacketsQueueMarkBufferInUseForSegment(queue, segment + 1);
+        
+        YRPacketsQueueAdvanceBaseSegment(queue, 1);
+        
+        YRSequenceNumberType inUse = 0;
+        uint16_t count = 1;
+        
+        YRPacketsQueueGetSegmentNumbersForBuffersInUse(queue, &inUse, &count);
+        
+        XCTAssertTrue(count == 1);
+        XCTAssertTrue(inUse == segment + 1);
+        XCTAssertTrue(*(int *)YRPacketsQueueBufferForSegment(queue, segment + 1) == segment + 1);
+        
+        YRPacketsQueueUnmarkBufferInUseForSegment(queue, segment + 1);
+    }
+    
+    YRPacketsQueueDestroy(queue);
+}
+
+- (void)testAlignedQueueBuffers {
+    uint16_t alignments[] = {0, 64, 100, 4096};
+    uint16_t expectedAlignments[] = {8, 64, 128, 4096};
+    
+    for (int hugePages = 0; hugePages < 2; hugePages++) {
+        for (int i = 0; i < sizeof(alignments) / sizeof(alignments[0]); i++) {
+            YRPacketsQueueRef queue = YRPacketsQueueCreateWithOptions(1300, 1000, alignments[i],
+                                                                      hugePages ? kYRPacketsQueueOptionHugePages : 0);
+            
+            YRPacketsQueueSetBaseSegment(queue, 0);
+            
+            for (YRSequenceNumberType segment = 0; segment < 1000; segment += 3) {
+                uint8_t *buffer = YRPacketsQueueBufferForSegment(queue, segment);
+                
+                XCTAssertTrue((uintptr_t)buffer % expectedAlignments[i] == 0);
+                
+                memset(buffer, segment, 1300);
+            }
+            
+            for (YRSequenceNumberType segment = 0; segment < 1000; segment += 3) {
+                uint8_t *buffer = YRPacketsQueueBufferForSegment(queue, segment);
+                
+                XCTAssertTrue(buffer[0] == (uint8_t)segment && buffer[1299] == (uint8_t)segment);
+            }
+            
+            YRPacketsQueueDestroy(queue);
+        }
+    }
+}
+
+- (void)testSegmentRangesForBuffersInUse {
+    uint16_t buffersCount = 200;
+    YRPacketsQueueRef queue = YRPacketsQueueCreate(sizeof(int), buffersCount);
+    
+    // Ring index wraps in the middle of window, segment numbers wrap too.
+    YRSequenceNumberType segmentBase = 65500;
+    
+    YRPacketsQueueSetBaseSegment(queue, segmentBase - 150);
+    YRPacketsQueueAdvanceBaseSegment(queue, 150);
+    
+    YRSequenceNumberType marked[][2] = {{0, 0}, {2, 70}, {72, 72}, {100, 199}};
+    
+    for (int i = 0; i < 4; i++) {
+        for (YRSequenceNumberType offset = marked[i][0]; offset <= marked[i][1]; offset++) {
+            YRPacketsQueueBufferForSegment(queue, segmentBase + offset);
+            YRPacketsQueueMarkBufferInUseForSegment(queue, segmentBase + offset);
+        }
+    }
+    
+    uint16_t rangesCount = 10;
+    YRSequenceNumberType ranges[2 * rangesCount];
+    
+    YRPacketsQueueGetSegmentRangesForBuffersInUse(queue, ranges, &rangesCount);
+    
+    XCTAssertTrue(rangesCount == 4);
+    
+    for (int i = 0; i < 4; i++) {
+        XCTAssertTrue(ranges[2 * i] == (YRSequenceNumberType)(segmentBase + marked[i][0]));
+        XCTAssertTrue(ranges[2 * i + 1] == (YRSequenceNumberType)(segmentBase + marked[i][1]));
+    }
+    
+    // The lowest ranges are provided when there's no room for all of them.
+    rangesCount = 2;
+    
+    YRPacketsQueueGetSegmentRangesForBuffersInUse(queue, ranges, &rangesCount);
+    
+    XCTAssertTrue(rangesCount == 2);
+    XCTAssertTrue(ranges[3] == (YRSequenceNumberType)(segmentBase + 70));
+    
+    YRPacketsQueueDestroy(queue);
+}
+
 @end
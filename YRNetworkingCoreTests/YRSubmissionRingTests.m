@@ -0,0 +1,163 @@
+//
+//  YRSubmissionRingTests.m
+//  YRNetworkingCoreTests
+//
+//  Created by Yuriy Romanchenko on 3/24/19.
+//  Copyright © 2019 Yuriy Romanchenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "YRSubmissionRing.h"
+
+static const uint32_t kYRTestProducersCount = 4;
+static const uint32_t kYRTestElementsPerProducer = 10000;
+
+@interface YRSubmissionRingTests : XCTestCase
+@end
+
+@implementation YRSubmissionRingTests
+
+- (void)testElementsComeOutInOrder {
+    YRSubmissionRingRef ring = YRSubmissionRingCreate(5);
+    bool wasEmpty = false;
+    void *element = NULL;
+    uint32_t length = 0;
+
+    XCTAssertFalse(YRSubmissionRingPeek(ring, &element, &length));
+
+    XCTAssertTrue(YRSubmissionRingPush(ring, (void *)1, 10, &wasEmpty));
+    XCTAssertTrue(wasEmpty);
+    XCTAssertTrue(YRSubmissionRingPush(ring, (void *)2, 20, &wasEmpty));
+    XCTAssertFalse(wasEmpty);
+
+    XCTAssertTrue(YRSubmissionRingPeek(ring, &element, &length));
+    XCTAssertTrue(element == (void *)1 && length == 10);
+
+    // Peek doesn't remove.
+    XCTAssertTrue(YRSubmissionRingPeek(ring, &element, &length));
+    XCTAssertTrue(element == (void *)1);
+
+    YRSubmissionRingPop(ring);
+
+    XCTAssertTrue(YRSubmissionRingPeek(ring, &element, &length));
+    XCTAssertTrue(element == (void *)2 && length == 20);
+
+    YRSubmissionRingPop(ring);
+
+    XCTAssertFalse(YRSubmissionRingPeek(ring, &element, &length));
+
+    YRSubmissionRingDestroy(ring);
+}
+
+- (void)testFullRingRejectsPush {
+    // Rounded up to 8.
+    YRSubmissionRingRef ring = YRSubmissionRingCreate(5);
+    void *element = NULL;
+    uint32_t length = 0;
+
+    for (uintptr_t i = 0; i < 8; i++) {
+        XCTAssertTrue(YRSubmissionRingPush(ring, (void *)i, 0, NULL));
+    }
+
+    XCTAssertFalse(YRSubmissionRingPush(ring, (void *)8, 0, NULL));
+
+    YRSubmissionRingPeek(ring, &element, &length);
+    YRSubmissionRingPop(ring);
+
+    XCTAssertTrue(YRSubmissionRingPush(ring, (void *)8, 0, NULL));
+
+    for (uintptr_t i = 1; i <= 8; i++) {
+        XCTAssertTrue(YRSubmissionRingPeek(ring, &element, &length));
+        XCTAssertTrue(element == (void *)i);
+        YRSubmissionRingPop(ring);
+    }
+
+    YRSubmissionRingDestroy(ring);
+}
+
+- (void)testCopiedElementsLiveInRing {
+    YRSubmissionRingRef ring = YRSubmissionRingCreateWithElementSize(2, 5);
+    char bytes[] = "abcde";
+    bool wasEmpty = false;
+    void *element = NULL;
+    uint32_t length = 0;
+
+    XCTAssertTrue(YRSubmissionRingPushCopy(ring, bytes, 5, &wasEmpty));
+    XCTAssertTrue(wasEmpty);
+    XCTAssertFalse(YRSubmissionRingPushCopy(ring, bytes, 6, NULL));
+    XCTAssertTrue(YRSubmissionRingPushCopy(ring, bytes, 3, &wasEmpty));
+    XCTAssertFalse(wasEmpty);
+    XCTAssertFalse(YRSubmissionRingPushCopy(ring, bytes, 1, NULL));
+
+    // Producer's bytes may change right after push.
+    bytes[0] = 'z';
+
+    XCTAssertTrue(YRSubmissionRingPeek(ring, &element, &length));
+    XCTAssertTrue(length == 5 && memcmp(element, "abcde", 5) == 0);
+    XCTAssertTrue(element != bytes);
+
+    void *firstElement = element;
+
+    YRSubmissionRingPop(ring);
+
+    XCTAssertTrue(YRSubmissionRingPeek(ring, &element, &length));
+    XCTAssertTrue(length == 3 && memcmp(element, "abc", 3) == 0);
+    XCTAssertTrue(element != firstElement);
+
+    YRSubmissionRingPop(ring);
+
+    // Slots are reused.
+    XCTAssertTrue(YRSubmissionRingPushCopy(ring, "xyz", 3, NULL));
+    XCTAssertTrue(YRSubmissionRingPeek(ring, &element, &length));
+    XCTAssertTrue(element == firstElement && memcmp(element, "xyz", 3) == 0);
+
+    YRSubmissionRingDestroy(ring);
+}
+
+- (void)testConcurrentProducers {
+    YRSubmissionRingRef ring = YRSubmissionRingCreate(64);
+    uint32_t *lastReceived = calloc(kYRTestProducersCount, sizeof(uint32_t));
+    __block uint32_t received = 0;
+    __block bool isOrdered = true;
+
+    dispatch_group_t group = dispatch_group_create();
+
+    dispatch_group_async(group, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+        dispatch_apply(kYRTestProducersCount, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t producer) {
+            for (uint32_t i = 1; i <= kYRTestElementsPerProducer; i++) {
+                while (!YRSubmissionRingPush(ring, (void *)(uintptr_t)producer, i, NULL)) {
+                    sched_yield();
+                }
+            }
+        });
+    });
+
+    while (received < kYRTestProducersCount * kYRTestElementsPerProducer) {
+        void *element = NULL;
+        uint32_t length = 0;
+
+        if (!YRSubmissionRingPeek(ring, &element, &length)) {
+            sched_yield();
+            continue;
+        }
+
+        YRSubmissionRingPop(ring);
+
+        // Elements of every single producer keep their order.
+        uintptr_t producer = (uintptr_t)element;
+
+        isOrdered = isOrdered && lastReceived[producer] + 1 == length;
+        lastReceived[producer] = length;
+        received++;
+    }
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    XCTAssertTrue(isOrdered);
+
+    free(lastReceived);
+    YRSubmissionRingDestroy(ring);
+}
+
+@end
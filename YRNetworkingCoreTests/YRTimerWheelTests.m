@@ -0,0 +1,323 @@
+//
+//  YRTimerWheelTests.m
+//  YRNetworkingCoreTests
+//
+//  Created by Yuriy Romanchenko on 3/16/19.
+//  Copyright © 2019 Yuriy Romanchenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "YRTimerWheel.h"
+
+typedef struct {
+    uint32_t firesCount;
+    uint64_t firedAt;
+    // Optional timer to cancel or reschedule from callback.
+    YRTimerRef otherTimer;
+    uint32_t rescheduleTimeout;
+} YRTestTimerContext;
+
+static void YRTestTimerCallback(YRTimerWheelRef wheel, YRTimerRef timer, void *context) {
+    YRTestTimerContext *testContext = context;
+
+    testContext->firesCount++;
+    testContext->firedAt = YRTimerWheelGetTime(wheel);
+}
+
+static void YRTestCancellingTimerCallback(YRTimerWheelRef wheel, YRTimerRef timer, void *context) {
+    YRTestTimerContext *testContext = context;
+
+    YRTestTimerCallback(wheel, timer, context);
+    YRTimerWheelCancel(wheel, testContext->otherTimer);
+}
+
+static void YRTestReschedulingTimerCallback(YRTimerWheelRef wheel, YRTimerRef timer, void *context) {
+    YRTestTimerContext *testContext = context;
+
+    YRTestTimerCallback(wheel, timer, context);
+    YRTimerWheelSchedule(wheel, timer, testContext->rescheduleTimeout);
+}
+
+@interface YRTimerWheelTests : XCTestCase
+@end
+
+@implementation YRTimerWheelTests
+
+- (void)testWheelDestroy {
+    YRTimerWheelDestroy(NULL);
+
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 1000);
+    YRTestTimerContext context = {0};
+    YRTimer timer;
+
+    YRTimerInit(&timer, YRTestTimerCallback, &context);
+    YRTimerWheelSchedule(wheel, &timer, 10);
+
+    XCTAssertTrue(YRTimerIsScheduled(&timer));
+
+    YRTimerWheelDestroy(wheel);
+
+    // Pending timers are detached, not fired.
+    XCTAssertFalse(YRTimerIsScheduled(&timer));
+    XCTAssertTrue(context.firesCount == 0);
+}
+
+- (void)testTimerFiresOnce {
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 1000);
+    YRTestTimerContext context = {0};
+    YRTimer timer;
+
+    YRTimerInit(&timer, YRTestTimerCallback, &context);
+    YRTimerWheelSchedule(wheel, &timer, 100);
+
+    XCTAssertTrue(YRTimerWheelGetTimersCount(wheel) == 1);
+    // Timer sits on upper level, so wheel asks to be advanced earlier to cascade it.
+    XCTAssertTrue(YRTimerWheelGetTimeout(wheel, 1000) > 0);
+    XCTAssertTrue(YRTimerWheelGetTimeout(wheel, 1000) <= 100);
+
+    YRTimerWheelAdvance(wheel, 1099);
+
+    XCTAssertTrue(context.firesCount == 0);
+    XCTAssertTrue(YRTimerWheelGetTimeout(wheel, 1099) == 1);
+
+    YRTimerWheelAdvance(wheel, 1100);
+
+    XCTAssertTrue(context.firesCount == 1);
+    XCTAssertTrue(context.firedAt == 1100);
+    XCTAssertFalse(YRTimerIsScheduled(&timer));
+    XCTAssertTrue(YRTimerWheelGetTimersCount(wheel) == 0);
+    XCTAssertTrue(YRTimerWheelGetTimeout(wheel, 1100) == -1);
+
+    YRTimerWheelAdvance(wheel, 100000);
+
+    XCTAssertTrue(context.firesCount == 1);
+
+    YRTimerWheelDestroy(wheel);
+}
+
+- (void)testCancel {
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 0);
+    YRTestTimerContext context = {0};
+    YRTimer timer;
+
+    YRTimerInit(&timer, YRTestTimerCallback, &context);
+
+    // Cancelling timer that is not scheduled is no-op.
+    YRTimerWheelCancel(wheel, &timer);
+
+    YRTimerWheelSchedule(wheel, &timer, 5000);
+    YRTimerWheelCancel(wheel, &timer);
+
+    XCTAssertFalse(YRTimerIsScheduled(&timer));
+    XCTAssertTrue(YRTimerWheelGetTimersCount(wheel) == 0);
+
+    YRTimerWheelAdvance(wheel, 10000);
+
+    XCTAssertTrue(context.firesCount == 0);
+
+    YRTimerWheelDestroy(wheel);
+}
+
+- (void)testRescheduleMovesPendingTimer {
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 0);
+    YRTestTimerContext context = {0};
+    YRTimer timer;
+
+    YRTimerInit(&timer, YRTestTimerCallback, &context);
+    YRTimerWheelSchedule(wheel, &timer, 10);
+    YRTimerWheelSchedule(wheel, &timer, 300);
+
+    XCTAssertTrue(YRTimerWheelGetTimersCount(wheel) == 1);
+
+    YRTimerWheelAdvance(wheel, 299);
+
+    XCTAssertTrue(context.firesCount == 0);
+
+    YRTimerWheelAdvance(wheel, 300);
+
+    XCTAssertTrue(context.firesCount == 1);
+
+    YRTimerWheelDestroy(wheel);
+}
+
+- (void)testZeroTimeoutFiresOnNextTick {
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 0);
+    YRTestTimerContext context = {0};
+    YRTimer timer;
+
+    YRTimerInit(&timer, YRTestTimerCallback, &context);
+    YRTimerWheelSchedule(wheel, &timer, 0);
+
+    YRTimerWheelAdvance(wheel, 0);
+
+    XCTAssertTrue(context.firesCount == 0);
+
+    YRTimerWheelAdvance(wheel, 1);
+
+    XCTAssertTrue(context.firesCount == 1);
+
+    YRTimerWheelDestroy(wheel);
+}
+
+- (void)testResolution {
+    YRTimerWheelRef wheel = YRTimerWheelCreate(10, 0);
+    YRTestTimerContext context = {0};
+    YRTimer timer;
+
+    YRTimerInit(&timer, YRTestTimerCallback, &context);
+
+    // Rounded up to 3 ticks.
+    YRTimerWheelSchedule(wheel, &timer, 25);
+
+    YRTimerWheelAdvance(wheel, 29);
+
+    XCTAssertTrue(context.firesCount == 0);
+
+    YRTimerWheelAdvance(wheel, 30);
+
+    XCTAssertTrue(context.firesCount == 1);
+
+    YRTimerWheelDestroy(wheel);
+}
+
+- (void)testTimersOnUpperLevelsCascade {
+    const uint32_t timeouts[] = {63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300000, 20000000};
+    const uint32_t timersCount = sizeof(timeouts) / sizeof(timeouts[0]);
+
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 0);
+    YRTestTimerContext contexts[timersCount];
+    YRTimer timers[timersCount];
+
+    memset(contexts, 0, sizeof(contexts));
+
+    for (uint32_t i = 0; i < timersCount; i++) {
+        YRTimerInit(&timers[i], YRTestTimerCallback, &contexts[i]);
+        YRTimerWheelSchedule(wheel, &timers[i], timeouts[i]);
+    }
+
+    // Follow timeouts the way event loop does, every timer must fire exactly at its time.
+    uint64_t now = 0;
+
+    while (YRTimerWheelGetTimersCount(wheel) > 0) {
+        int32_t timeout = YRTimerWheelGetTimeout(wheel, now);
+
+        XCTAssertTrue(timeout >= 0);
+
+        now += timeout > 0 ? timeout : 1;
+
+        YRTimerWheelAdvance(wheel, now);
+    }
+
+    for (uint32_t i = 0; i < timersCount; i++) {
+        XCTAssertTrue(contexts[i].firesCount == 1);
+        XCTAssertTrue(contexts[i].firedAt == timeouts[i]);
+    }
+
+    YRTimerWheelDestroy(wheel);
+}
+
+- (void)testLargeTimeJump {
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 0);
+    YRTestTimerContext firstContext = {0};
+    YRTestTimerContext secondContext = {0};
+    YRTimer first;
+    YRTimer second;
+
+    YRTimerInit(&first, YRTestTimerCallback, &firstContext);
+    YRTimerInit(&second, YRTestTimerCallback, &secondContext);
+
+    YRTimerWheelSchedule(wheel, &first, 100);
+    YRTimerWheelSchedule(wheel, &second, 50000000);
+
+    YRTimerWheelAdvance(wheel, 40000000);
+
+    XCTAssertTrue(firstContext.firesCount == 1);
+    XCTAssertTrue(secondContext.firesCount == 0);
+
+    YRTimerWheelAdvance(wheel, 50000000);
+
+    XCTAssertTrue(secondContext.firesCount == 1);
+
+    YRTimerWheelDestroy(wheel);
+}
+
+- (void)testCallbackCancelsExpiredTimer {
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 0);
+    YRTestTimerContext firstContext = {0};
+    YRTestTimerContext secondContext = {0};
+    YRTimer first;
+    YRTimer second;
+
+    firstContext.otherTimer = &second;
+
+    YRTimerInit(&first, YRTestCancellingTimerCallback, &firstContext);
+    YRTimerInit(&second, YRTestTimerCallback, &secondContext);
+
+    YRTimerWheelSchedule(wheel, &first, 10);
+    YRTimerWheelSchedule(wheel, &second, 10);
+
+    YRTimerWheelAdvance(wheel, 10);
+
+    XCTAssertTrue(firstContext.firesCount == 1);
+    XCTAssertTrue(secondContext.firesCount == 0);
+    XCTAssertTrue(YRTimerWheelGetTimersCount(wheel) == 0);
+
+    YRTimerWheelDestroy(wheel);
+}
+
+- (void)testCallbackReschedulesItself {
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 0);
+    YRTestTimerContext context = {0};
+    YRTimer timer;
+
+    context.rescheduleTimeout = 10;
+
+    YRTimerInit(&timer, YRTestReschedulingTimerCallback, &context);
+    YRTimerWheelSchedule(wheel, &timer, 10);
+
+    // Periodic timer fires once per period even if wheel lags behind.
+    YRTimerWheelAdvance(wheel, 35);
+
+    XCTAssertTrue(context.firesCount == 1);
+    XCTAssertTrue(YRTimerIsScheduled(&timer));
+
+    YRTimerWheelAdvance(wheel, 45);
+
+    XCTAssertTrue(context.firesCount == 2);
+
+    YRTimerWheelDestroy(wheel);
+}
+
+#pragma mark - Performance
+
+- (void)testScheduleCancelPerformance {
+    const uint32_t timersCount = 100000;
+
+    YRTimerWheelRef wheel = YRTimerWheelCreate(0, 0);
+    YRTimer *timers = calloc(timersCount, sizeof(YRTimer));
+
+    for (uint32_t i = 0; i < timersCount; i++) {
+        YRTimerInit(&timers[i], YRTestTimerCallback, NULL);
+    }
+
+    // Mirrors retransmission timers: armed on send, re-armed or cancelled on every ACK.
+    [self measureBlock:^{
+        for (uint32_t round = 0; round < 10; round++) {
+            for (uint32_t i = 0; i < timersCount; i++) {
+                YRTimerWheelSchedule(wheel, &timers[i], 200 + (i * 7919) % 5000);
+            }
+
+            for (uint32_t i = 0; i < timersCount; i++) {
+                YRTimerWheelCancel(wheel, &timers[i]);
+            }
+        }
+    }];
+
+    XCTAssertTrue(YRTimerWheelGetTimersCount(wheel) == 0);
+
+    YRTimerWheelDestroy(wheel);
+    free(timers);
+}
+
+@end
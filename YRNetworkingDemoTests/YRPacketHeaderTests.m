@@ -8,6 +8,7 @@
 
 #import <XCTest/XCTest.h>
 #import "YRPacketHeader.h"
+#import "YRChecksum.h"
 #import "YRDebugUtils.h"
 
 @interface YRPacketHeaderTests : XCTestCase
@@ -208,6 +209,27 @@
     }
 }
 
+- (void)testSYNPacketHeaderLeavesOutLocalConfiguration {
+    uint8_t headerBuffer[kYRPacketHeaderSYNLength] = {0};
+    YRConnectionConfiguration configuration = {
+        .maximumSegmentSize = 1400,
+        .maxCumulativeAck = 4,
+        .cumulativeAckTimeoutValue = 20,
+        .batchingTimeoutValue = 5,
+    };
+    
+    YRPacketHeaderSYNRef synHeader = (YRPacketHeaderSYNRef)headerBuffer;
+    
+    YRPacketSYNHeaderSetConfiguration(synHeader, configuration);
+    
+    YRConnectionConfiguration returnedConfiguration = YRPacketSYNHeaderGetConfiguration(synHeader);
+    
+    XCTAssertTrue(returnedConfiguration.maximumSegmentSize == 1400);
+    XCTAssertTrue(returnedConfiguration.maxCumulativeAck == 0);
+    XCTAssertTrue(returnedConfiguration.cumulativeAckTimeoutValue == 0);
+    XCTAssertTrue(returnedConfiguration.batchingTimeoutValue == 0);
+}
+
 - (void)testRSTPacketHeader {
     for (uint8_t errorCodeIterator = 0; errorCodeIterator < (uint8_t)(~0); errorCodeIterator++) {
         YRHeaderLengthType headerLength = kYRPacketHeaderRSTLength;
@@ -280,4 +302,39 @@
     }
 }
 
+- (void)testIncrementalUpdateKeepsChecksumValid {
+    uint8_t headerBuffer[YRMakeMultipleTo(kYRPacketPayloadHeaderLength, sizeof(YRChecksumType))] __attribute__ ((__aligned__(8)));
+    memset(headerBuffer, 0, sizeof(headerBuffer));
+    
+    YRPacketHeaderRef header = (YRPacketHeaderRef)headerBuffer;
+    YRPacketPayloadHeaderRef payloadHeader = (YRPacketPayloadHeaderRef)headerBuffer;
+    
+    YRPacketHeaderSetSequenceNumber(header, 100);
+    YRPacketHeaderSetHeaderLength(header, kYRPacketPayloadHeaderLength);
+    YRPacketHeaderSetPayloadLength(payloadHeader, 500);
+    YRPacketHeaderSetChecksum(header, ~YRChecksumAdd(0, headerBuffer, sizeof(headerBuffer)));
+    
+    for (uint32_t i = 0; i < 10000; i++) {
+        switch (i % 4) {
+            case 0:
+                YRPacketHeaderUpdateAckNumber(header, arc4random());
+                break;
+            case 1:
+                YRPacketHeaderUpdateSequenceNumber(header, arc4random());
+                break;
+            case 2:
+                YRPacketHeaderUpdatePacketDescription(header, YRPacketHeaderGetPacketDescription(header) ^ YRPacketDescriptionCHK);
+                break;
+            default:
+                YRPacketHeaderUpdatePayloadLength(payloadHeader, arc4random());
+                break;
+        }
+        
+        // Sum with valid checksum inside is negative zero.
+        XCTAssertTrue(YRChecksumAdd(0, headerBuffer, sizeof(headerBuffer)) == (YRChecksumType)(~0));
+    }
+    
+    XCTAssertTrue(YRPacketHeaderHasACK(header));
+}
+
 @end
@@ -7,6 +7,7 @@
 //
 
 #import <XCTest/XCTest.h>
+#import "YRPacket.h"
 
 @interface YRPacketTests : XCTestCase
 
@@ -24,4 +25,232 @@
     [super tearDown];
 }
 
+- (void)testSerializeAtWritesReferencedPayload {
+    uint8_t payload[] = {1, 2, 3, 4, 5, 6, 7};
+    YRPayloadLengthType packetLength = YRPacketLengthForPayload(sizeof(payload));
+    uint8_t packetBuffer[packetLength] __attribute__ ((__aligned__(8)));
+    
+    YRPacketRef packet = YRPacketCreateWithPayload(10, 20, payload, sizeof(payload), false, packetBuffer);
+    
+    uint8_t wireBuffer[YRPacketGetLength(packet)] __attribute__ ((__aligned__(8)));
+    
+    XCTAssertTrue(YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer)) == YRPacketGetLength(packet));
+    
+    uint8_t bufferForStream[kYRLightweightInputStreamSize];
+    YRLightweightInputStreamRef stream = YRLightweightInputStreamCreateAt(wireBuffer, sizeof(wireBuffer), bufferForStream);
+    
+    XCTAssertTrue(YRPacketCanDeserializeFromStream(stream));
+    
+    uint8_t receivedPacketBuffer[YRPacketDataStructureLengthForPacketSize(sizeof(wireBuffer))] __attribute__ ((__aligned__(8)));
+    YRPacketRef receivedPacket = YRPacketDeserializeAt(stream, receivedPacketBuffer);
+    
+    XCTAssertTrue(receivedPacket != NULL);
+    XCTAssertTrue(YRPacketIsLogicallyValid(receivedPacket));
+    XCTAssertTrue(YRPacketHeaderGetSequenceNumber(YRPacketGetHeader(receivedPacket)) == 10);
+    
+    YRPayloadLengthType receivedPayloadLength = 0;
+    void *receivedPayload = YRPacketGetPayload(receivedPacket, &receivedPayloadLength);
+    
+    XCTAssertTrue(receivedPayloadLength == sizeof(payload));
+    XCTAssertTrue(memcmp(receivedPayload, payload, sizeof(payload)) == 0);
+}
+
+- (void)testSerializeAtFailsWhenBufferIsTooSmall {
+    uint8_t packetBuffer[YRPacketNULLength()] __attribute__ ((__aligned__(8)));
+    YRPacketRef packet = YRPacketCreateNUL(1, 1, packetBuffer);
+    uint8_t wireBuffer[YRPacketGetLength(packet)];
+    
+    XCTAssertTrue(YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer) - 1) == 0);
+    XCTAssertTrue(YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer)) == sizeof(wireBuffer));
+}
+
+- (void)testSerializedAckNumberRefreshKeepsChecksumValid {
+    uint8_t payload[] = {9, 8, 7, 6, 5};
+    YRPayloadLengthType packetLength = YRPacketLengthForPayload(sizeof(payload));
+    uint8_t packetBuffer[packetLength] __attribute__ ((__aligned__(8)));
+    
+    YRPacketRef packet = YRPacketCreateWithPayload(10, 20, payload, sizeof(payload), false, packetBuffer);
+    
+    uint8_t wireBuffer[YRPacketGetLength(packet)] __attribute__ ((__aligned__(8)));
+    
+    YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer));
+    
+    XCTAssertTrue(YRPacketSerializedSetAckNumber(wireBuffer, sizeof(wireBuffer), 4242));
+    
+    uint8_t bufferForStream[kYRLightweightInputStreamSize];
+    YRLightweightInputStreamRef stream = YRLightweightInputStreamCreateAt(wireBuffer, sizeof(wireBuffer), bufferForStream);
+    
+    XCTAssertTrue(YRPacketCanDeserializeFromStream(stream));
+    
+    uint8_t receivedPacketBuffer[YRPacketDeserializedLengthForStream(stream)] __attribute__ ((__aligned__(8)));
+    YRPacketRef receivedPacket = YRPacketDeserializeAt(stream, receivedPacketBuffer);
+    
+    XCTAssertTrue(receivedPacket != NULL);
+    XCTAssertTrue(YRPacketIsLogicallyValid(receivedPacket));
+    XCTAssertTrue(YRPacketHeaderGetSequenceNumber(YRPacketGetHeader(receivedPacket)) == 10);
+    XCTAssertTrue(YRPacketHeaderGetAckNumber(YRPacketGetHeader(receivedPacket)) == 4242);
+}
+
+- (void)testSerializedAckNumberRefreshIgnoresPacketsWithoutACK {
+    uint8_t packetBuffer[YRPacketRSTLength()] __attribute__ ((__aligned__(8)));
+    YRPacketRef packet = YRPacketCreateRST(0, 1, 0, false, packetBuffer);
+    uint8_t wireBuffer[YRPacketGetLength(packet)];
+    
+    YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer));
+    
+    uint8_t wireBufferCopy[sizeof(wireBuffer)];
+    
+    memcpy(wireBufferCopy, wireBuffer, sizeof(wireBuffer));
+    
+    XCTAssertFalse(YRPacketSerializedSetAckNumber(wireBuffer, sizeof(wireBuffer), 4242));
+    XCTAssertTrue(memcmp(wireBuffer, wireBufferCopy, sizeof(wireBuffer)) == 0);
+}
+
+- (void)testSerializedCRC32CDetectsCorruption {
+    uint8_t payload[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    YRPayloadLengthType packetLength = YRPacketLengthForPayload(sizeof(payload));
+    uint8_t packetBuffer[packetLength] __attribute__ ((__aligned__(8)));
+    
+    YRPacketRef packet = YRPacketCreateWithPayload(10, 20, payload, sizeof(payload), false, packetBuffer);
+    
+    uint8_t wireBuffer[YRPacketGetLength(packet)] __attribute__ ((__aligned__(8)));
+    
+    YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer));
+    
+    XCTAssertFalse(YRPacketSerializedHasValidCRC32C(wireBuffer, sizeof(wireBuffer)));
+    
+    YRPacketSerializedSetCRC32C(wireBuffer, sizeof(wireBuffer));
+    
+    XCTAssertTrue(YRPacketSerializedHasValidCRC32C(wireBuffer, sizeof(wireBuffer)));
+    
+    // Deserialized packet doesn't carry ones' complement checksum anymore.
+    uint8_t bufferForStream[kYRLightweightInputStreamSize];
+    YRLightweightInputStreamRef stream = YRLightweightInputStreamCreateAt(wireBuffer, sizeof(wireBuffer), bufferForStream);
+    
+    XCTAssertTrue(YRPacketCanDeserializeFromStream(stream));
+    
+    uint8_t receivedPacketBuffer[YRPacketDeserializedLengthForStream(stream)] __attribute__ ((__aligned__(8)));
+    YRPacketRef receivedPacket = YRPacketDeserializeAt(stream, receivedPacketBuffer);
+    
+    XCTAssertTrue(YRPacketIsLogicallyValidIgnoringChecksum(receivedPacket));
+    
+    wireBuffer[sizeof(wireBuffer) - 1] ^= 0x10;
+    
+    XCTAssertFalse(YRPacketSerializedHasValidCRC32C(wireBuffer, sizeof(wireBuffer)));
+}
+
+- (void)testHeaderOnlyChecksumIgnoresPayload {
+    uint8_t payload[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    YRPayloadLengthType packetLength = YRPacketLengthForPayload(sizeof(payload));
+    uint8_t packetBuffer[packetLength] __attribute__ ((__aligned__(8)));
+    
+    YRPacketRef packet = YRPacketCreateWithPayloadHeaderChecksumOnly(10, 20, payload, sizeof(payload), true, packetBuffer);
+    YRPacketHeaderRef header = YRPacketGetHeader(packet);
+    
+    XCTAssertFalse(YRPacketHeaderHasCHK(header));
+    XCTAssertTrue(YRPacketIsLogicallyValid(packet));
+    
+    YRPayloadLengthType payloadLength = 0;
+    uint8_t *packetPayload = YRPacketGetPayload(packet, &payloadLength);
+    
+    XCTAssertTrue(payloadLength == sizeof(payload));
+    
+    packetPayload[0] ^= 0xFF;
+    
+    XCTAssertTrue(YRPacketIsLogicallyValid(packet));
+    
+    YRPacketHeaderSetSequenceNumber(header, 11);
+    
+    XCTAssertFalse(YRPacketIsLogicallyValid(packet));
+}
+
+- (void)testEACKRangesSurviveSerialization {
+    YRSequenceNumberType ranges[] = {10, 12, 15, 15, 65530, 3};
+    YRSequenceNumberType rangesCount = 3;
+    uint8_t packetBuffer[YRPacketEACKRangesLength(&rangesCount)] __attribute__ ((__aligned__(8)));
+    
+    YRPacketRef packet = YRPacketCreateEACKRanges(1, 9, ranges, &rangesCount, packetBuffer);
+    
+    XCTAssertTrue(rangesCount == 3);
+    
+    uint8_t wireBuffer[YRPacketGetLength(packet)] __attribute__ ((__aligned__(8)));
+    
+    YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer));
+    
+    uint8_t bufferForStream[kYRLightweightInputStreamSize];
+    YRLightweightInputStreamRef stream = YRLightweightInputStreamCreateAt(wireBuffer, sizeof(wireBuffer), bufferForStream);
+    
+    uint8_t receivedPacketBuffer[YRPacketDeserializedLengthForStream(stream)] __attribute__ ((__aligned__(8)));
+    YRPacketRef receivedPacket = YRPacketDeserializeAt(stream, receivedPacketBuffer);
+    
+    XCTAssertTrue(YRPacketIsLogicallyValid(receivedPacket));
+    
+    YRSequenceNumberType receivedRangesCount = 0;
+    YRSequenceNumberType *receivedRanges = YRPacketHeaderGetEACKRanges((YRPacketHeaderEACKRef)YRPacketGetHeader(receivedPacket),
+                                                                        &receivedRangesCount);
+    
+    XCTAssertTrue(receivedRangesCount == 3);
+    XCTAssertTrue(memcmp(receivedRanges, ranges, sizeof(ranges)) == 0);
+}
+
+- (void)testEACKRangesAreClampedToHeader {
+    YRSequenceNumberType sequencesCount = UINT16_MAX;
+    YRSequenceNumberType rangesCount = UINT16_MAX;
+    
+    YRPacketEACKLength(&sequencesCount);
+    YRPacketEACKRangesLength(&rangesCount);
+    
+    // Only whole ranges are sent.
+    XCTAssertTrue(rangesCount == sequencesCount / 2);
+}
+
+- (void)testLengthOfPacketWithLargePayload {
+    uint8_t payload[300] = {0};
+    uint8_t packetBuffer[YRPacketLengthForPayload(sizeof(payload))] __attribute__ ((__aligned__(8)));
+    
+    YRPacketRef packet = YRPacketCreateWithPayload(1, 1, payload, sizeof(payload), false, packetBuffer);
+    
+    // Payload length doesn't fit into header length type.
+    XCTAssertTrue(YRPacketGetLength(packet) == 16 + sizeof(payload));
+}
+
+- (void)testMaximumLengthDataStructureFitsPayloadLengthType {
+    XCTAssertTrue(YRPacketDataStructureLengthForPacketSize(YRPacketMaximumLength()) <= UINT16_MAX);
+    XCTAssertTrue(YRPacketDataStructureLengthForPacketSize(YRPacketMaximumLength() + 1) > UINT16_MAX);
+}
+
+- (void)testSYNWithLocalConfigurationIsValidOnPeer {
+    YRConnectionConfiguration configuration = {
+        .retransmissionTimeoutValue = 200,
+        .maximumSegmentSize = 1400,
+        .maxNumberOfOutstandingSegments = 32,
+        .maxCumulativeAck = 4,
+        .cumulativeAckTimeoutValue = 20,
+        .batchingTimeoutValue = 5,
+    };
+    uint8_t packetBuffer[YRPacketSYNLength()] __attribute__ ((__aligned__(8)));
+    
+    YRPacketRef packet = YRPacketCreateSYN(configuration, 1, 0, false, packetBuffer);
+    
+    uint8_t wireBuffer[YRPacketGetLength(packet)] __attribute__ ((__aligned__(8)));
+    
+    XCTAssertTrue(YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer)) == sizeof(wireBuffer));
+    
+    uint8_t bufferForStream[kYRLightweightInputStreamSize];
+    YRLightweightInputStreamRef stream = YRLightweightInputStreamCreateAt(wireBuffer, sizeof(wireBuffer), bufferForStream);
+    
+    uint8_t receivedPacketBuffer[YRPacketDeserializedLengthForStream(stream)] __attribute__ ((__aligned__(8)));
+    YRPacketRef receivedPacket = YRPacketDeserializeAt(stream, receivedPacketBuffer);
+    
+    // Checksum covers only what's on the wire.
+    XCTAssertTrue(receivedPacket != NULL);
+    XCTAssertTrue(YRPacketIsLogicallyValid(receivedPacket));
+    
+    YRConnectionConfiguration receivedConfiguration = YRPacketSYNHeaderGetConfiguration((YRPacketHeaderSYNRef)YRPacketGetHeader(receivedPacket));
+    
+    XCTAssertTrue(receivedConfiguration.maximumSegmentSize == 1400);
+    XCTAssertTrue(receivedConfiguration.maxNumberOfOutstandingSegments == 32);
+    XCTAssertTrue(receivedConfiguration.maxCumulativeAck == 0);
+}
+
 @end
@@ -0,0 +1,1101 @@
+//
+//  YRTempSessionTests.m
+//  YRNetworkingDemoTests
+//
+//  Created by Yuriy Romanchenko on 3/28/19.
+//  Copyright © 2019 Yuriy Romanchenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "YRTempSession.h"
+#import "YRTimerWheel.h"
+#import "YRPacket.h"
+#import "YRPacketHeader.h"
+#import "YRLightweightInputStream.h"
+
+// Datagrams sent by each session and messages it delivered, index is session's side.
+static NSMutableArray<NSData *> *sentDatagrams[2];
+static NSMutableArray<NSData *> *receivedMessages[2];
+// Pointers receive callout was called with, they're only valid during the callout.
+static NSMutableArray<NSValue *> *receivedPayloads[2];
+
+static void YRTestSendCallout0(YRSessionRef session, const void *payload, YRPayloadLengthType length) {
+    [sentDatagrams[0] addObject:[NSData dataWithBytes:payload length:length]];
+}
+
+static void YRTestSendCallout1(YRSessionRef session, const void *payload, YRPayloadLengthType length) {
+    [sentDatagrams[1] addObject:[NSData dataWithBytes:payload length:length]];
+}
+
+static void YRTestReceiveCallout0(YRSessionRef session, const void *payload, YRPayloadLengthType length) {
+    [receivedMessages[0] addObject:[NSData dataWithBytes:payload length:length]];
+    [receivedPayloads[0] addObject:[NSValue valueWithPointer:payload]];
+}
+
+static void YRTestReceiveCallout1(YRSessionRef session, const void *payload, YRPayloadLengthType length) {
+    [receivedMessages[1] addObject:[NSData dataWithBytes:payload length:length]];
+    [receivedPayloads[1] addObject:[NSValue valueWithPointer:payload]];
+}
+
+@interface YRTempSessionTests : XCTestCase
+@end
+
+@implementation YRTempSessionTests {
+    YRSessionRef _sessions[2];
+    YRTimerWheelRef _timerWheel;
+    uint64_t _now;
+    uint64_t _parsedPacketBuffer[64];
+}
+
+- (void)tearDown {
+    [self destroySessions];
+    
+    [super tearDown];
+}
+
+#pragma mark - Session Pair
+
+- (YRConnectionConfiguration)defaultConfiguration {
+    YRConnectionConfiguration configuration = {0};
+    
+    configuration.retransmissionTimeoutValue = 200;
+    configuration.nullSegmentTimeoutValue = 2000;
+    configuration.maximumSegmentSize = 1400;
+    configuration.maxNumberOfOutstandingSegments = 32;
+    configuration.maxRetransmissions = 5;
+    
+    return configuration;
+}
+
+/**
+ *  Creates two sessions sharing one timer wheel that's advanced manually, see -advance:.
+ *  Nothing is delivered between them unless -deliverFrom: or -pump is called.
+ */
+- (void)setUpSessionsWithConfiguration:(YRConnectionConfiguration)configuration0
+                         configuration:(YRConnectionConfiguration)configuration1 {
+    YRSessionCallbacks callbacks0 = {NULL, YRTestSendCallout0, YRTestReceiveCallout0};
+    YRSessionCallbacks callbacks1 = {NULL, YRTestSendCallout1, YRTestReceiveCallout1};
+    
+    for (int side = 0; side < 2; side++) {
+        sentDatagrams[side] = [NSMutableArray new];
+        receivedMessages[side] = [NSMutableArray new];
+        receivedPayloads[side] = [NSMutableArray new];
+    }
+    
+    _now = 1000;
+    _timerWheel = YRTimerWheelCreate(1, _now);
+    _sessions[0] = YRSessionCreateWithConfiguration(configuration0, callbacks0);
+    _sessions[1] = YRSessionCreateWithConfiguration(configuration1, callbacks1);
+    
+    YRSessionSetTimerWheel(_sessions[0], _timerWheel);
+    YRSessionSetTimerWheel(_sessions[1], _timerWheel);
+}
+
+- (void)destroySessions {
+    for (int side = 0; side < 2; side++) {
+        if (_sessions[side]) {
+            YRSessionDestroy(_sessions[side]);
+            _sessions[side] = NULL;
+        }
+    }
+    
+    if (_timerWheel) {
+        YRTimerWheelDestroy(_timerWheel);
+        _timerWheel = NULL;
+    }
+}
+
+- (void)connectSessions {
+    YRSessionWait(_sessions[1]);
+    YRSessionConnect(_sessions[0]);
+    
+    [self pump];
+    
+    XCTAssertTrue(YRSessionGetState(_sessions[0]) == kYRSessionStateConnected);
+    XCTAssertTrue(YRSessionGetState(_sessions[1]) == kYRSessionStateConnected);
+}
+
+- (void)deliverFrom:(int)side {
+    NSData *datagram = sentDatagrams[side].firstObject;
+    
+    [sentDatagrams[side] removeObjectAtIndex:0];
+    
+    YRSessionReceive(_sessions[!side], (void *)datagram.bytes, datagram.length);
+}
+
+- (void)dropFrom:(int)side {
+    [sentDatagrams[side] removeObjectAtIndex:0];
+}
+
+// Lossless link, everything sent so far and in response is delivered.
+- (void)pump {
+    while (sentDatagrams[0].count > 0 || sentDatagrams[1].count > 0) {
+        if (sentDatagrams[0].count > 0) {
+            [self deliverFrom:0];
+        }
+        
+        if (sentDatagrams[1].count > 0) {
+            [self deliverFrom:1];
+        }
+    }
+}
+
+- (void)advance:(uint32_t)milliseconds {
+    _now += milliseconds;
+    
+    YRTimerWheelAdvance(_timerWheel, _now);
+}
+
+// Pacer releases segments over time, so waits until side has sent given number of datagrams.
+- (void)waitUntilSide:(int)side hasSent:(NSUInteger)count {
+    for (int i = 0; i < 100 && sentDatagrams[side].count < count; i++) {
+        [self advance:1];
+    }
+    
+    XCTAssertTrue(sentDatagrams[side].count == count);
+}
+
+- (YRPacketHeaderRef)headerOfDatagramAtIndex:(NSUInteger)index from:(int)side {
+    NSData *datagram = sentDatagrams[side][index];
+    uint8_t streamBuffer[kYRLightweightInputStreamSize] __attribute__ ((__aligned__(8)));
+    YRLightweightInputStreamRef stream = YRLightweightInputStreamCreateAt(datagram.bytes, datagram.length, streamBuffer);
+    
+    XCTAssertTrue(YRPacketDeserializedLengthForStream(stream) <= sizeof(_parsedPacketBuffer));
+    
+    YRPacketRef packet = YRPacketDeserializeAt(stream, _parsedPacketBuffer);
+    
+    XCTAssertTrue(packet != NULL);
+    
+    return YRPacketGetHeader(packet);
+}
+
+// Hands packet that peer never sent to session, e.g. reordered or forged one.
+- (void)receivePacket:(YRPacketRef)packet on:(int)side {
+    uint8_t wireBuffer[YRPacketGetLength(packet)] __attribute__ ((__aligned__(8)));
+    YRPayloadLengthType length = YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer));
+    
+    XCTAssertTrue(length > 0);
+    
+    YRSessionReceive(_sessions[side], wireBuffer, length);
+}
+
+- (void)receiveACKWithSeqNumber:(YRSequenceNumberType)seqNumber
+                      ackNumber:(YRSequenceNumberType)ackNumber
+                             on:(int)side {
+    uint8_t packetBuffer[YRPacketACKLength()] __attribute__ ((__aligned__(8)));
+    
+    [self receivePacket:YRPacketCreateACK(seqNumber, ackNumber, packetBuffer) on:side];
+}
+
+- (void)receiveEACKWithSeqNumber:(YRSequenceNumberType)seqNumber
+                       ackNumber:(YRSequenceNumberType)ackNumber
+                           first:(YRSequenceNumberType)first
+                            last:(YRSequenceNumberType)last
+                              on:(int)side {
+    YRSequenceNumberType ranges[] = {first, last};
+    YRSequenceNumberType rangesCount = 1;
+    uint8_t packetBuffer[YRPacketEACKRangesLength(&rangesCount)] __attribute__ ((__aligned__(8)));
+    
+    [self receivePacket:YRPacketCreateEACKRanges(seqNumber, ackNumber, ranges, &rangesCount, packetBuffer) on:side];
+}
+
+#pragma mark - Creation
+
+- (void)testCreationFailsForUnusableMaximumSegmentSize {
+    YRSessionCallbacks callbacks = {NULL, NULL, NULL};
+    YRConnectionConfiguration configuration = {0};
+
+    configuration.maximumSegmentSize = YRPacketMaximumLength() + 1;
+
+    XCTAssertTrue(YRSessionCreateWithConfiguration(configuration, callbacks) == NULL);
+
+    configuration.maximumSegmentSize = YRPacketMaximumLength();
+
+    YRSessionRef session = YRSessionCreateWithConfiguration(configuration, callbacks);
+
+    XCTAssertTrue(session != NULL);
+
+    YRSessionDestroy(session);
+}
+
+#pragma mark - Close
+
+// RST that was never touched by CRC32C, i.e. the same as freshly built one.
+- (BOOL)isPlainRSTDatagramAtIndex:(NSUInteger)index from:(int)side {
+    NSData *datagram = sentDatagrams[side][index];
+    YRPacketHeaderRef header = [self headerOfDatagramAtIndex:index from:side];
+    
+    if (!YRPacketHeaderIsRST(header)) {
+        return NO;
+    }
+    
+    uint8_t packetBuffer[YRPacketRSTLength()] __attribute__ ((__aligned__(8)));
+    YRPacketRef packet = YRPacketCreateRST(0,
+                                           YRPacketHeaderGetSequenceNumber(header),
+                                           YRPacketHeaderGetAckNumber(header),
+                                           true,
+                                           packetBuffer);
+    uint8_t wireBuffer[YRPacketGetLength(packet)] __attribute__ ((__aligned__(8)));
+    YRPayloadLengthType length = YRPacketSerializeAt(packet, wireBuffer, sizeof(wireBuffer));
+    
+    return [datagram isEqualToData:[NSData dataWithBytes:wireBuffer length:length]];
+}
+
+- (void)testCloseRSTKeepsOnesComplementChecksumWithCRC32C {
+    YRConnectionConfiguration configuration = [self defaultConfiguration];
+    
+    configuration.options |= kYRConnectionOptionCRC32C;
+    
+    [self setUpSessionsWithConfiguration:configuration configuration:configuration];
+    [self connectSessions];
+    
+    YRSessionClose(_sessions[0]);
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    XCTAssertTrue([self isPlainRSTDatagramAtIndex:0 from:0]);
+    
+    // Retransmitted RST is sent from send queue the same way.
+    [self dropFrom:0];
+    
+    for (int i = 0; i < 2000 && sentDatagrams[0].count == 0; i++) {
+        [self advance:1];
+    }
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    XCTAssertTrue([self isPlainRSTDatagramAtIndex:0 from:0]);
+    
+    [self deliverFrom:0];
+    
+    XCTAssertTrue(YRSessionGetState(_sessions[1]) == kYRSessionStateDisconnecting);
+}
+
+#pragma mark - Round Trip Time
+
+// NUL segments would be counted as retransmissions.
+- (YRConnectionConfiguration)roundTripTimeConfiguration {
+    YRConnectionConfiguration configuration = [self defaultConfiguration];
+    
+    configuration.nullSegmentTimeoutValue = 0;
+    
+    return configuration;
+}
+
+// SYN ACK arrives roundTripTime after SYN was sent, that's the first sample of active side (0).
+- (void)connectSessionsWithRoundTripTime:(uint32_t)roundTripTime {
+    YRSessionWait(_sessions[1]);
+    YRSessionConnect(_sessions[0]);
+    
+    [self deliverFrom:0];
+    [self advance:roundTripTime];
+    [self deliverFrom:1];
+    [self pump];
+    
+    XCTAssertTrue(YRSessionGetState(_sessions[0]) == kYRSessionStateConnected);
+    XCTAssertTrue(YRSessionGetState(_sessions[1]) == kYRSessionStateConnected);
+}
+
+- (void)sendSegmentFromActiveSide {
+    uint8_t payload[100] = {0};
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    
+    [self waitUntilSide:0 hasSent:1];
+}
+
+// Retransmission timeout observed as time till lost segment is sent again.
+- (uint32_t)retransmissionTimeoutOfLostSegment {
+    uint32_t elapsed = 0;
+    
+    [self dropFrom:0];
+    
+    while (sentDatagrams[0].count == 0 && elapsed < 70000) {
+        [self advance:1];
+        elapsed++;
+    }
+    
+    return elapsed;
+}
+
+- (void)testRetransmissionTimeoutFollowsSmoothedRoundTripTimeAndVariance {
+    [self setUpSessionsWithConfiguration:[self roundTripTimeConfiguration] configuration:[self roundTripTimeConfiguration]];
+    [self connectSessionsWithRoundTripTime:100];
+    
+    // ACK takes 200 ms: SRTT = 100 + (200 - 100) / 8 = 112, RTTVAR = 50 + (100 - 50) / 4 = 62.
+    [self sendSegmentFromActiveSide];
+    [self advance:200];
+    [self deliverFrom:0];
+    [self deliverFrom:1];
+    
+    [self sendSegmentFromActiveSide];
+    
+    // RTO = SRTT + 4 * RTTVAR (in scaled integer form).
+    XCTAssertTrue([self retransmissionTimeoutOfLostSegment] == 362);
+}
+
+- (void)testFirstSampleSetsRetransmissionTimeout {
+    [self setUpSessionsWithConfiguration:[self roundTripTimeConfiguration] configuration:[self roundTripTimeConfiguration]];
+    [self connectSessionsWithRoundTripTime:100];
+    
+    [self sendSegmentFromActiveSide];
+    
+    // SRTT = 100, RTTVAR = 50, configured 200 ms is replaced.
+    XCTAssertTrue([self retransmissionTimeoutOfLostSegment] == 300);
+}
+
+- (void)testRetransmissionTimeoutIsClampedToMinimum {
+    [self setUpSessionsWithConfiguration:[self roundTripTimeConfiguration] configuration:[self roundTripTimeConfiguration]];
+    // Zero round trip time.
+    [self connectSessions];
+    
+    [self sendSegmentFromActiveSide];
+    
+    XCTAssertTrue([self retransmissionTimeoutOfLostSegment] == 20);
+}
+
+- (void)testRetransmissionTimeoutIsClampedToMaximum {
+    YRConnectionConfiguration configuration = [self roundTripTimeConfiguration];
+    
+    // SYN must not be retransmitted, its sample would be discarded.
+    configuration.retransmissionTimeoutValue = 60000;
+    
+    [self setUpSessionsWithConfiguration:configuration configuration:configuration];
+    // SRTT + 4 * RTTVAR is 90 s.
+    [self connectSessionsWithRoundTripTime:30000];
+    
+    [self sendSegmentFromActiveSide];
+    
+    XCTAssertTrue([self retransmissionTimeoutOfLostSegment] == 60000);
+}
+
+- (void)testRetransmissionTimeoutIsDoubledOnEveryTimeout {
+    [self setUpSessionsWithConfiguration:[self roundTripTimeConfiguration] configuration:[self roundTripTimeConfiguration]];
+    [self connectSessionsWithRoundTripTime:100];
+    
+    [self sendSegmentFromActiveSide];
+    
+    XCTAssertTrue([self retransmissionTimeoutOfLostSegment] == 300);
+    XCTAssertTrue([self retransmissionTimeoutOfLostSegment] == 600);
+    XCTAssertTrue([self retransmissionTimeoutOfLostSegment] == 1200);
+}
+
+- (void)testACKOfRetransmittedSegmentIsNotSampled {
+    [self setUpSessionsWithConfiguration:[self roundTripTimeConfiguration] configuration:[self roundTripTimeConfiguration]];
+    [self connectSessionsWithRoundTripTime:100];
+    
+    [self sendSegmentFromActiveSide];
+    
+    XCTAssertTrue([self retransmissionTimeoutOfLostSegment] == 300);
+    
+    // Retransmission is acknowledged quickly, 10 ms sample would bring timeout down to 328.
+    [self advance:10];
+    [self deliverFrom:0];
+    [self deliverFrom:1];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 0);
+    
+    [self sendSegmentFromActiveSide];
+    
+    // Karn's rule: backed off timeout stays till a new valid sample.
+    XCTAssertTrue([self retransmissionTimeoutOfLostSegment] == 600);
+}
+
+#pragma mark - Pacing
+
+/**
+ *  Sends as many segments as window allows at once and advances time 1 ms per tick till all of them leave.
+ *  Returns number of datagrams sent on every tick, the first one is the moment segments were handed to session.
+ */
+- (NSArray<NSNumber *> *)sendsPerTickForFullWindow {
+    NSMutableArray<NSNumber *> *sendsPerTick = [NSMutableArray new];
+    uint8_t payload[100] = {0};
+    NSUInteger segmentsCount = 0;
+    NSUInteger sentCount = 0;
+    
+    while (YRSessionCanSend(_sessions[0])) {
+        XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+        segmentsCount++;
+    }
+    
+    while (sentCount < segmentsCount && sendsPerTick.count < 1000) {
+        if (sendsPerTick.count > 0) {
+            [self advance:1];
+        }
+        
+        [sendsPerTick addObject:@(sentDatagrams[0].count - sentCount)];
+        sentCount = sentDatagrams[0].count;
+    }
+    
+    XCTAssertTrue(sentCount == segmentsCount);
+    
+    return sendsPerTick;
+}
+
+- (void)testFullWindowIsSpreadOverRoundTripTime {
+    [self setUpSessionsWithConfiguration:[self roundTripTimeConfiguration] configuration:[self roundTripTimeConfiguration]];
+    
+    // Only peer's window of 32 segments limits sending.
+    YRSessionSetCongestionControlAlgorithm(_sessions[0], NULL);
+    
+    [self connectSessionsWithRoundTripTime:100];
+    
+    NSArray<NSNumber *> *sendsPerTick = [self sendsPerTickForFullWindow];
+    
+    // Burst of 2 leaves right away, the rest waits for credit.
+    XCTAssertTrue(sendsPerTick[0].unsignedIntegerValue == 2);
+    
+    for (NSUInteger tick = 1; tick < sendsPerTick.count; tick++) {
+        XCTAssertTrue(sendsPerTick[tick].unsignedIntegerValue <= 1);
+    }
+    
+    // 1.25 * window / RTT is 409 credit per ms, 30 segments take 30 * 1024 / 409 ms.
+    XCTAssertTrue(sendsPerTick.count - 1 == 76);
+}
+
+- (void)testPacingRateFollowsWindowAndRoundTripTime {
+    uint32_t roundTripTimes[] = {100, 200};
+    NSUInteger durations[2] = {0};
+    
+    for (int i = 0; i < 2; i++) {
+        [self destroySessions];
+        [self setUpSessionsWithConfiguration:[self roundTripTimeConfiguration] configuration:[self roundTripTimeConfiguration]];
+        [self connectSessionsWithRoundTripTime:roundTripTimes[i]];
+        
+        NSArray<NSNumber *> *sendsPerTick = [self sendsPerTickForFullWindow];
+        
+        durations[i] = sendsPerTick.count - 1;
+    }
+    
+    // Initial congestion window of 4 in slow start: 2 * 4 * 1024 / RTT credit per ms,
+    // 2 segments after burst take 13 ms each at 100 ms RTT.
+    XCTAssertTrue(durations[0] == 26);
+    // Twice longer RTT halves the rate.
+    XCTAssertTrue(durations[1] == 52);
+}
+
+#pragma mark - Cumulative ACK
+
+- (YRConnectionConfiguration)cumulativeAckConfiguration {
+    YRConnectionConfiguration configuration = [self defaultConfiguration];
+    
+    configuration.maxCumulativeAck = 4;
+    configuration.cumulativeAckTimeoutValue = 20;
+    
+    return configuration;
+}
+
+- (void)testACKIsDelayedForCumulativeAckTimeout {
+    uint8_t payload[100] = {0};
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self cumulativeAckConfiguration]];
+    [self connectSessions];
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    
+    [self waitUntilSide:0 hasSent:1];
+    
+    YRSequenceNumberType seqNumber = YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:0 from:0]);
+    
+    [self deliverFrom:0];
+    
+    XCTAssertTrue(receivedMessages[1].count == 1);
+    XCTAssertTrue(sentDatagrams[1].count == 0);
+    
+    [self advance:19];
+    
+    XCTAssertTrue(sentDatagrams[1].count == 0);
+    
+    [self advance:1];
+    
+    XCTAssertTrue(sentDatagrams[1].count == 1);
+    
+    YRPacketHeaderRef ackHeader = [self headerOfDatagramAtIndex:0 from:1];
+    
+    XCTAssertTrue(YRPacketHeaderHasACK(ackHeader));
+    XCTAssertTrue(YRPacketHeaderGetAckNumber(ackHeader) == seqNumber);
+}
+
+- (void)testACKIsSentOnceMaxCumulativeAckSegmentsArrive {
+    uint8_t payload[100] = {0};
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self cumulativeAckConfiguration]];
+    [self connectSessions];
+    
+    for (int i = 0; i < 4; i++) {
+        XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    }
+    
+    [self waitUntilSide:0 hasSent:4];
+    
+    YRSequenceNumberType lastSeqNumber = YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:3 from:0]);
+    
+    for (int i = 0; i < 3; i++) {
+        [self deliverFrom:0];
+    }
+    
+    XCTAssertTrue(sentDatagrams[1].count == 0);
+    
+    [self deliverFrom:0];
+    
+    // No timeout passed, threshold alone triggers single ACK for all four.
+    XCTAssertTrue(sentDatagrams[1].count == 1);
+    XCTAssertTrue(YRPacketHeaderGetAckNumber([self headerOfDatagramAtIndex:0 from:1]) == lastSeqNumber);
+}
+
+- (void)testPiggybackedACKCancelsCumulativeAckTimer {
+    uint8_t payload[100] = {0};
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self cumulativeAckConfiguration]];
+    [self connectSessions];
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    
+    [self waitUntilSide:0 hasSent:1];
+    
+    YRSequenceNumberType seqNumber = YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:0 from:0]);
+    
+    [self deliverFrom:0];
+    
+    XCTAssertTrue(sentDatagrams[1].count == 0);
+    XCTAssertTrue(YRSessionSend(_sessions[1], payload, 50));
+    
+    [self waitUntilSide:1 hasSent:1];
+    
+    XCTAssertTrue(YRPacketHeaderGetAckNumber([self headerOfDatagramAtIndex:0 from:1]) == seqNumber);
+    
+    // Data is acknowledged, so nothing is retransmitted while we wait past cumulative ACK timeout.
+    [self deliverFrom:1];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    
+    [self deliverFrom:0];
+    [self advance:50];
+    
+    XCTAssertTrue(sentDatagrams[1].count == 0);
+}
+
+#pragma mark - Fast Retransmit
+
+/**
+ *  Sends 4 segments, the first of them is lost and the rest are delivered.
+ *  Returns sequence number of lost segment, receiver's 3 EACKs stay undelivered.
+ */
+- (YRSequenceNumberType)loseFirstOfFourSegments {
+    uint8_t payload[100] = {0};
+    
+    for (int i = 0; i < 4; i++) {
+        XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    }
+    
+    [self waitUntilSide:0 hasSent:4];
+    
+    YRSequenceNumberType lostSeqNumber = YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:0 from:0]);
+    
+    [self dropFrom:0];
+    
+    for (int i = 0; i < 3; i++) {
+        [self deliverFrom:0];
+    }
+    
+    XCTAssertTrue(sentDatagrams[1].count == 3);
+    
+    for (int i = 0; i < 3; i++) {
+        XCTAssertTrue(YRPacketHeaderHasEACK([self headerOfDatagramAtIndex:i from:1]));
+    }
+    
+    return lostSeqNumber;
+}
+
+- (YRConnectionConfiguration)smallWindowConfiguration {
+    YRConnectionConfiguration configuration = [self defaultConfiguration];
+    
+    configuration.maxNumberOfOutstandingSegments = 4;
+    
+    return configuration;
+}
+
+- (void)testSegmentIsRetransmittedOnceThreeSegmentsAboveItAreEACKed {
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self smallWindowConfiguration]];
+    [self connectSessions];
+    
+    YRSequenceNumberType lostSeqNumber = [self loseFirstOfFourSegments];
+    
+    [self deliverFrom:1];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 0);
+    
+    [self deliverFrom:1];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 0);
+    
+    // No retransmission timeout passed.
+    [self deliverFrom:1];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    XCTAssertTrue(YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:0 from:0]) == lostSeqNumber);
+    
+    [self deliverFrom:0];
+    
+    XCTAssertTrue(receivedMessages[1].count == 4);
+}
+
+- (void)testRepeatedAndOldEACKsDontRetransmitAgain {
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self smallWindowConfiguration]];
+    [self connectSessions];
+    
+    YRSequenceNumberType lostSeqNumber = [self loseFirstOfFourSegments];
+    
+    [self deliverFrom:1];
+    [self deliverFrom:1];
+    
+    NSData *thirdEACK = sentDatagrams[1].firstObject;
+    
+    [self deliverFrom:1];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    
+    // Same EACK again, segment was already fast retransmitted.
+    YRSessionReceive(_sessions[0], (void *)thirdEACK.bytes, thirdEACK.length);
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    
+    [self deliverFrom:0];
+    
+    XCTAssertTrue(sentDatagrams[1].count == 1);
+    XCTAssertTrue(YRPacketHeaderGetAckNumber([self headerOfDatagramAtIndex:0 from:1]) == (YRSequenceNumberType)(lostSeqNumber + 3));
+    
+    [self deliverFrom:1];
+    
+    // Everything it reports is acknowledged already.
+    YRSessionReceive(_sessions[0], (void *)thirdEACK.bytes, thirdEACK.length);
+    
+    XCTAssertTrue(sentDatagrams[0].count == 0);
+}
+
+- (void)testSegmentReusingFastRetransmittedOnesBufferIsFastRetransmittedToo {
+    uint8_t payload[100] = {0};
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self smallWindowConfiguration]];
+    [self connectSessions];
+    
+    YRSequenceNumberType firstLostSeqNumber = [self loseFirstOfFourSegments];
+    
+    for (int i = 0; i < 3; i++) {
+        [self deliverFrom:1];
+    }
+    
+    [self pump];
+    
+    // Loss halved congestion window, it grows back while segments are acknowledged.
+    int sentCount = 0;
+    
+    for (int i = 0; i < 1000 && sentCount < 44; i++) {
+        sentCount += YRSessionSend(_sessions[0], payload, sizeof(payload)) ? 1 : 0;
+        
+        [self pump];
+        [self advance:1];
+    }
+    
+    XCTAssertTrue(sentCount == 44);
+    
+    for (int i = 0; i < 10; i++) {
+        [self pump];
+        [self advance:1];
+    }
+    
+    YRSequenceNumberType lostSeqNumber = [self loseFirstOfFourSegments];
+    
+    // 48 segments later lost segment takes the same send queue buffer as the first one.
+    XCTAssertTrue((YRSequenceNumberType)(lostSeqNumber - firstLostSeqNumber) == 48);
+    
+    for (int i = 0; i < 3; i++) {
+        [self deliverFrom:1];
+    }
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    XCTAssertTrue(YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:0 from:0]) == lostSeqNumber);
+}
+
+#pragma mark - Acknowledgment
+
+- (void)testStaleAndNeverSentACKsDontReleaseOutstandingSegments {
+    uint8_t payload[100] = {0};
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self defaultConfiguration]];
+    [self connectSessions];
+    
+    for (int i = 0; i < 2; i++) {
+        XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    }
+    
+    [self waitUntilSide:0 hasSent:2];
+    
+    YRSequenceNumberType seqNumber = YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:0 from:0]);
+    
+    [self deliverFrom:0];
+    [self deliverFrom:0];
+    
+    XCTAssertTrue(sentDatagrams[1].count == 2);
+    
+    // ACK-only segments don't occupy sequence numbers, so every one of them has the same.
+    YRPacketHeaderRef firstACKHeader = [self headerOfDatagramAtIndex:0 from:1];
+    YRSequenceNumberType ackSeqNumber = YRPacketHeaderGetSequenceNumber(firstACKHeader);
+    
+    XCTAssertTrue(YRPacketHeaderGetAckNumber(firstACKHeader) == seqNumber);
+    
+    [self dropFrom:1];
+    [self deliverFrom:1];
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    
+    [self waitUntilSide:0 hasSent:1];
+    [self dropFrom:0];
+    
+    // Reordered ACK that's older than queue base and ACK for segment that was never sent.
+    [self receiveACKWithSeqNumber:ackSeqNumber ackNumber:seqNumber on:0];
+    [self receiveACKWithSeqNumber:ackSeqNumber ackNumber:seqNumber + 10 on:0];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 0);
+    
+    // Lost segment is still outstanding, so it's retransmitted on timeout.
+    for (int i = 0; i < 2000 && sentDatagrams[0].count == 0; i++) {
+        [self advance:1];
+    }
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    XCTAssertTrue(YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:0 from:0]) == (YRSequenceNumberType)(seqNumber + 2));
+    
+    [self pump];
+    
+    XCTAssertTrue(receivedMessages[1].count == 3);
+}
+
+- (void)testEACKRangesOutsideOfWindowAreSkipped {
+    uint8_t payload[100] = {0};
+    YRConnectionConfiguration configuration = [self defaultConfiguration];
+    
+    configuration.options |= kYRConnectionOptionEACKRanges;
+    
+    [self setUpSessionsWithConfiguration:configuration configuration:configuration];
+    [self connectSessions];
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    
+    [self waitUntilSide:0 hasSent:1];
+    [self deliverFrom:0];
+    
+    YRPacketHeaderRef ackHeader = [self headerOfDatagramAtIndex:0 from:1];
+    YRSequenceNumberType ackSeqNumber = YRPacketHeaderGetSequenceNumber(ackHeader);
+    YRSequenceNumberType ackNumber = YRPacketHeaderGetAckNumber(ackHeader);
+    
+    [self deliverFrom:1];
+    
+    for (int i = 0; i < 4; i++) {
+        XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    }
+    
+    [self waitUntilSide:0 hasSent:4];
+    
+    YRSequenceNumberType seqNumber = YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:0 from:0]);
+    
+    for (int i = 0; i < 4; i++) {
+        [self dropFrom:0];
+    }
+    
+    // No more segments than window (32) are ever outstanding, and nothing was sent that far ahead.
+    [self receiveEACKWithSeqNumber:ackSeqNumber ackNumber:ackNumber first:seqNumber + 1 last:seqNumber + 1 + 32 on:0];
+    [self receiveEACKWithSeqNumber:ackSeqNumber ackNumber:ackNumber first:seqNumber + 100 last:seqNumber + 102 on:0];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 0);
+    
+    [self receiveEACKWithSeqNumber:ackSeqNumber ackNumber:ackNumber first:seqNumber + 1 last:seqNumber + 3 on:0];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    XCTAssertTrue(YRPacketHeaderGetSequenceNumber([self headerOfDatagramAtIndex:0 from:0]) == seqNumber);
+}
+
+- (void)testSegmentsAreDeliveredInOrderOnceGapIsFilled {
+    uint8_t payload[100] = {0};
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self defaultConfiguration]];
+    [self connectSessions];
+    
+    for (uint8_t i = 0; i < 4; i++) {
+        payload[0] = i;
+        
+        XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    }
+    
+    [self waitUntilSide:0 hasSent:4];
+    [self dropFrom:0];
+    
+    for (int i = 0; i < 3; i++) {
+        [self deliverFrom:0];
+    }
+    
+    // Out of sequence segments wait in receive queue.
+    XCTAssertTrue(receivedMessages[1].count == 0);
+    
+    [self pump];
+    
+    XCTAssertTrue(receivedMessages[1].count == 4);
+    
+    for (uint8_t i = 0; i < 4; i++) {
+        XCTAssertTrue(((const uint8_t *)receivedMessages[1][i].bytes)[0] == i);
+    }
+}
+
+#pragma mark - Submissions
+
+- (void)testSubmitRejectsPayloadsSessionCanNeverSend {
+    static uint8_t payload[1400];
+    // Maximum segment size less payload header.
+    YRPayloadLengthType maximumPayloadLength = 1400 - 16;
+    bool shouldWakeOwner = false;
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self defaultConfiguration]];
+    
+    // Slots are preallocated once session connects.
+    XCTAssertFalse(YRSessionSubmit(_sessions[0], payload, 100, &shouldWakeOwner));
+    
+    [self connectSessions];
+    
+    XCTAssertFalse(YRSessionSubmit(_sessions[0], payload, 0, &shouldWakeOwner));
+    XCTAssertFalse(YRSessionSubmit(_sessions[0], payload, maximumPayloadLength + 1, &shouldWakeOwner));
+    XCTAssertTrue(YRSessionSubmit(_sessions[0], payload, maximumPayloadLength, &shouldWakeOwner));
+    XCTAssertTrue(shouldWakeOwner);
+    XCTAssertTrue(YRSessionSubmit(_sessions[0], payload, 100, &shouldWakeOwner));
+    XCTAssertFalse(shouldWakeOwner);
+    
+    XCTAssertTrue(YRSessionProcessSubmissions(_sessions[0]) == 2);
+    XCTAssertTrue(YRSessionGetDroppedSubmissionsCount(_sessions[0]) == 0);
+    
+    [self waitUntilSide:0 hasSent:2];
+    [self pump];
+    
+    XCTAssertTrue(receivedMessages[1].count == 2);
+    XCTAssertTrue(receivedMessages[1][0].length == maximumPayloadLength);
+}
+
+- (void)testSubmissionsWaitingForWindowLeaveOnceACKsArrive {
+    uint8_t payload[100] = {0};
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self defaultConfiguration]];
+    [self connectSessions];
+    
+    for (uint8_t i = 0; i < 20; i++) {
+        payload[0] = i;
+        
+        XCTAssertTrue(YRSessionSubmit(_sessions[0], payload, sizeof(payload), NULL));
+    }
+    
+    // Congestion window holds the rest in ring.
+    XCTAssertTrue(YRSessionProcessSubmissions(_sessions[0]) < 20);
+    
+    // Nothing calls YRSessionProcessSubmissions from now on.
+    for (int i = 0; i < 100 && receivedMessages[1].count < 20; i++) {
+        [self pump];
+        [self advance:10];
+    }
+    
+    XCTAssertTrue(receivedMessages[1].count == 20);
+    
+    for (uint8_t i = 0; i < 20; i++) {
+        XCTAssertTrue(((const uint8_t *)receivedMessages[1][i].bytes)[0] == i);
+    }
+    
+    XCTAssertTrue(YRSessionGetDroppedSubmissionsCount(_sessions[0]) == 0);
+}
+
+#pragma mark - Delivery
+
+- (BOOL)isPayloadAtIndex:(NSUInteger)index on:(int)side insideDatagram:(NSData *)datagram {
+    const uint8_t *payload = receivedPayloads[side][index].pointerValue;
+    const uint8_t *bytes = datagram.bytes;
+    
+    return payload >= bytes && payload < bytes + datagram.length;
+}
+
+- (void)testInSequencePayloadIsDeliveredFromDatagram {
+    uint8_t payload[100] = {0};
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self defaultConfiguration]];
+    [self connectSessions];
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    
+    [self waitUntilSide:0 hasSent:1];
+    
+    NSData *datagram = sentDatagrams[0][0];
+    
+    [self deliverFrom:0];
+    
+    // Receive callout borrows payload from datagram instead of a copy.
+    XCTAssertTrue(receivedPayloads[1].count == 1);
+    XCTAssertTrue([self isPayloadAtIndex:0 on:1 insideDatagram:datagram]);
+}
+
+- (void)testOnlyOutOfSequencePayloadsAreCopied {
+    uint8_t payload[100] = {0};
+    
+    [self setUpSessionsWithConfiguration:[self defaultConfiguration] configuration:[self defaultConfiguration]];
+    [self connectSessions];
+    
+    for (uint8_t i = 0; i < 3; i++) {
+        payload[0] = i;
+        
+        XCTAssertTrue(YRSessionSend(_sessions[0], payload, sizeof(payload)));
+    }
+    
+    [self waitUntilSide:0 hasSent:3];
+    
+    // Datagrams are kept alive, so payload pointers can be compared with them.
+    NSArray<NSData *> *datagrams = [sentDatagrams[0] copy];
+    
+    [self deliverFrom:0];
+    
+    // The third one arrives before the second and waits in receive queue.
+    [sentDatagrams[0] exchangeObjectAtIndex:0 withObjectAtIndex:1];
+    [self deliverFrom:0];
+    
+    XCTAssertTrue(receivedPayloads[1].count == 1);
+    
+    [self deliverFrom:0];
+    
+    XCTAssertTrue(receivedPayloads[1].count == 3);
+    
+    for (uint8_t i = 0; i < 3; i++) {
+        XCTAssertTrue(((const uint8_t *)receivedMessages[1][i].bytes)[0] == i);
+    }
+    
+    // Segment that filled the gap is borrowed too, only the parked one was copied out of its datagram.
+    XCTAssertTrue([self isPayloadAtIndex:0 on:1 insideDatagram:datagrams[0]]);
+    XCTAssertTrue([self isPayloadAtIndex:1 on:1 insideDatagram:datagrams[1]]);
+    XCTAssertFalse([self isPayloadAtIndex:2 on:1 insideDatagram:datagrams[2]]);
+}
+
+#pragma mark - Batching
+
+- (YRConnectionConfiguration)batchingConfigurationWithTimeout:(uint16_t)timeout {
+    YRConnectionConfiguration configuration = [self defaultConfiguration];
+    
+    configuration.options |= kYRConnectionOptionBatching;
+    configuration.batchingTimeoutValue = timeout;
+    
+    return configuration;
+}
+
+- (void)testBatchedMessagesLeaveInOneSegmentAndAreDeliveredSeparately {
+    uint8_t first[] = {1, 2, 3};
+    uint8_t second[] = {4, 5, 6, 7, 8};
+    
+    [self setUpSessionsWithConfiguration:[self batchingConfigurationWithTimeout:0]
+                           configuration:[self batchingConfigurationWithTimeout:0]];
+    [self connectSessions];
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], first, sizeof(first)));
+    XCTAssertTrue(YRSessionSend(_sessions[0], second, sizeof(second)));
+    
+    // No timeout, batch waits for flush.
+    [self advance:50];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 0);
+    
+    YRSessionFlush(_sessions[0]);
+    
+    [self waitUntilSide:0 hasSent:1];
+    
+    // Payload header is 8 bytes aligned, every message is prefixed with its length.
+    XCTAssertTrue(sentDatagrams[0][0].length == 16 + 2 + sizeof(first) + 2 + sizeof(second));
+    
+    [self deliverFrom:0];
+    
+    XCTAssertTrue(receivedMessages[1].count == 2);
+    XCTAssertTrue([receivedMessages[1][0] isEqualToData:[NSData dataWithBytes:first length:sizeof(first)]]);
+    XCTAssertTrue([receivedMessages[1][1] isEqualToData:[NSData dataWithBytes:second length:sizeof(second)]]);
+}
+
+- (void)testBatchLeavesOnTimeoutCountedFromOldestMessage {
+    uint8_t first[] = {1, 2, 3};
+    uint8_t second[] = {4, 5, 6, 7, 8};
+    
+    [self setUpSessionsWithConfiguration:[self batchingConfigurationWithTimeout:10]
+                           configuration:[self batchingConfigurationWithTimeout:10]];
+    [self connectSessions];
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], first, sizeof(first)));
+    
+    [self advance:5];
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], second, sizeof(second)));
+    
+    [self advance:4];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 0);
+    
+    [self advance:1];
+    
+    XCTAssertTrue(sentDatagrams[0].count == 1);
+    XCTAssertTrue(sentDatagrams[0][0].length == 16 + 2 + sizeof(first) + 2 + sizeof(second));
+}
+
+- (void)testBatchRejectsMessageThatDoesNotFitIntoSegment {
+    static uint8_t payload[1400];
+    // Maximum segment size less payload header and message length prefix.
+    YRPayloadLengthType maximumMessageLength = 1400 - 16 - 2;
+    
+    [self setUpSessionsWithConfiguration:[self batchingConfigurationWithTimeout:0]
+                           configuration:[self batchingConfigurationWithTimeout:0]];
+    [self connectSessions];
+    
+    XCTAssertFalse(YRSessionSend(_sessions[0], payload, maximumMessageLength + 1));
+    XCTAssertTrue(YRSessionSend(_sessions[0], payload, maximumMessageLength));
+    
+    // Full batch leaves right away.
+    [self waitUntilSide:0 hasSent:1];
+    
+    XCTAssertTrue(sentDatagrams[0][0].length == 1400);
+    
+    [self pump];
+    
+    XCTAssertTrue(receivedMessages[1].count == 1);
+    XCTAssertTrue(receivedMessages[1][0].length == maximumMessageLength);
+}
+
+- (void)testCloseWaitsForWindowToSendPendingBatch {
+    uint8_t first[] = {1, 2, 3};
+    uint8_t second[] = {4, 5, 6, 7, 8};
+    YRConnectionConfiguration smallWindowConfiguration = [self batchingConfigurationWithTimeout:0];
+    
+    smallWindowConfiguration.maxNumberOfOutstandingSegments = 2;
+    
+    [self setUpSessionsWithConfiguration:[self batchingConfigurationWithTimeout:0]
+                           configuration:smallWindowConfiguration];
+    [self connectSessions];
+    
+    for (int i = 0; i < 2; i++) {
+        XCTAssertTrue(YRSessionSend(_sessions[0], first, sizeof(first)));
+        
+        YRSessionFlush(_sessions[0]);
+    }
+    
+    [self waitUntilSide:0 hasSent:2];
+    
+    XCTAssertTrue(YRSessionSend(_sessions[0], second, sizeof(second)));
+    
+    YRSessionClose(_sessions[0]);
+    
+    XCTAssertTrue(YRSessionGetState(_sessions[0]) == kYRSessionStateConnected);
+    XCTAssertFalse(YRSessionSend(_sessions[0], first, sizeof(first)));
+    
+    for (int i = 0; i < 1000 && YRSessionGetState(_sessions[1]) == kYRSessionStateConnected; i++) {
+        [self pump];
+        [self advance:1];
+    }
+    
+    XCTAssertTrue(receivedMessages[1].count == 3);
+    XCTAssertTrue([receivedMessages[1][2] isEqualToData:[NSData dataWithBytes:second length:sizeof(second)]]);
+    XCTAssertTrue(YRSessionGetState(_sessions[1]) != kYRSessionStateConnected);
+}
+
+@end